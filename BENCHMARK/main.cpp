@@ -0,0 +1,429 @@
+// Benchmarks for Sequence, bi_ring and avl_tree (plus their companions) next to the
+// standard containers, for catching performance regressions.
+//
+// Every case prints one CSV row (or a JSON object with --json):
+//
+//     container,operation,n,ops,ops_per_sec,p50_ns,p99_ns
+//
+// n is the number of elements the container holds, ops the number of timed operations.
+// Latencies are per operation; cheap operations are timed in batches and the percentiles
+// are taken over the batch averages, so they hide outliers inside one batch.
+//
+// usage: main.exe [--sizes 1e3,1e4,1e5,1e6,1e7] [--filter text] [--json]
+//   --sizes   element counts to run (default 1e3,1e4,1e5,1e6)
+//   --filter  run only the cases whose "container.operation" contains text
+//   --json    one JSON object per line instead of CSV
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../LAB_104_task1/sequence.hpp"
+#include "../LAB_104_task1/split.hpp"
+#include "../LAB_104_task1/flat_sequence.hpp"
+#include "../LAB_104_task2/bi_ring.hpp"
+#include "../LAB_104_task3/avl_tree.hpp"
+#include "../LAB_104_task3/btree_map.hpp"
+#include "../LAB_104_task3/frozen_map.hpp"
+#include "../LAB_104_task3/interned_avl_tree.hpp"
+
+typedef std::chrono::steady_clock bench_clock;
+
+// results are folded into this so the measured work cannot be optimized away
+static volatile std::size_t sink;
+
+// xorshift64*, fixed seed so every run measures the same operations
+struct rng {
+    std::uint64_t state;
+    explicit rng(std::uint64_t seed = 0x9E3779B97F4A7C15ull) : state(seed) {}
+    std::uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+    int below(std::size_t n) { return static_cast<int>(next() % n); }
+};
+
+// latency samples of one case
+class recorder {
+    public:
+        std::vector<double> samples; // ns per operation, one entry per timed batch
+        std::size_t ops = 0;
+        double total_ns = 0;
+
+        // time one call of f, which performs `count` operations
+        template <typename F>
+        void time(std::size_t count, F&& f) {
+            bench_clock::time_point start = bench_clock::now();
+            f();
+            double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+            samples.push_back(ns / static_cast<double>(count));
+            ops += count;
+            total_ns += ns;
+        }
+
+        // time `count` operations in batches of `batch`; op(i) performs operation i
+        template <typename Op>
+        void time_each(std::size_t count, std::size_t batch, Op&& op) {
+            for (std::size_t done = 0; done < count; done += batch) {
+                std::size_t end = std::min(count, done + batch);
+                time(end - done, [&] {
+                    for (std::size_t i = done; i < end; ++i) op(i);
+                });
+            }
+        }
+};
+
+// runs the cases that pass the filter and prints their rows
+class reporter {
+    std::string filter;
+    bool json;
+
+    static double percentile(std::vector<double>& v, double p) {
+        if (v.empty()) return 0;
+        std::size_t k = static_cast<std::size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    }
+
+    public:
+        reporter(const std::string& f, bool j) : filter(f), json(j) {
+            if (!json) std::cout << "container,operation,n,ops,ops_per_sec,p50_ns,p99_ns" << std::endl;
+        }
+
+        void run(const std::string& container, const std::string& operation, std::size_t n,
+                 const std::function<void(recorder&)>& body) {
+            if (!filter.empty() && (container + "." + operation).find(filter) == std::string::npos) return;
+            recorder r;
+            body(r);
+            double per_sec = r.total_ns > 0 ? static_cast<double>(r.ops) * 1e9 / r.total_ns : 0;
+            double p50 = percentile(r.samples, 0.50);
+            double p99 = percentile(r.samples, 0.99);
+            char line[512];
+            if (json) {
+                std::snprintf(line, sizeof(line),
+                              "{\"container\":\"%s\",\"operation\":\"%s\",\"n\":%zu,\"ops\":%zu,"
+                              "\"ops_per_sec\":%.0f,\"p50_ns\":%.1f,\"p99_ns\":%.1f}",
+                              container.c_str(), operation.c_str(), n, r.ops, per_sec, p50, p99);
+            } else {
+                std::snprintf(line, sizeof(line), "%s,%s,%zu,%zu,%.0f,%.1f,%.1f",
+                              container.c_str(), operation.c_str(), n, r.ops, per_sec, p50, p99);
+            }
+            std::cout << line << std::endl;
+        }
+};
+
+// operations that cost O(n) each (positional access in a list, whole splits and joins)
+// are repeated only as often as keeps one case around a second at every size
+static std::size_t linear_ops(std::size_t n, std::size_t at_most) {
+    std::size_t ops = 20000000 / (n ? n : 1);
+    return std::max<std::size_t>(3, std::min(ops, at_most));
+}
+
+//Sequence, flat_sequence and std::list
+static void bench_sequences(reporter& out, std::size_t n) {
+    const std::size_t batch = 256;
+
+    out.run("Sequence", "push_back", n, [&](recorder& r) {
+        Sequence<int, int> seq;
+        r.time_each(n, batch, [&](std::size_t i) { seq.push_back(static_cast<int>(i), 0); });
+    });
+    out.run("flat_sequence", "push_back", n, [&](recorder& r) {
+        flat_sequence<int, int> seq;
+        r.time_each(n, batch, [&](std::size_t i) { seq.push_back(static_cast<int>(i), 0); });
+    });
+    out.run("std::list", "push_back", n, [&](recorder& r) {
+        std::list<std::pair<int, int>> list;
+        r.time_each(n, batch, [&](std::size_t i) { list.emplace_back(static_cast<int>(i), 0); });
+    });
+
+    out.run("Sequence", "push_front", n, [&](recorder& r) {
+        Sequence<int, int> seq;
+        r.time_each(n, batch, [&](std::size_t i) { seq.push_front(static_cast<int>(i), 0); });
+    });
+    out.run("std::list", "push_front", n, [&](recorder& r) {
+        std::list<std::pair<int, int>> list;
+        r.time_each(n, batch, [&](std::size_t i) { list.emplace_front(static_cast<int>(i), 0); });
+    });
+
+    out.run("Sequence", "pop_front", n, [&](recorder& r) {
+        Sequence<int, int> seq;
+        for (std::size_t i = 0; i < n; ++i) seq.push_back(static_cast<int>(i), 0);
+        r.time_each(n, batch, [&](std::size_t) { seq.pop_front(); });
+    });
+    out.run("std::list", "pop_front", n, [&](recorder& r) {
+        std::list<std::pair<int, int>> list(n, std::make_pair(0, 0));
+        r.time_each(n, batch, [&](std::size_t) { list.pop_front(); });
+    });
+
+    // random positions walk the list; ascending positions hit the remembered position
+    std::size_t random_ops = linear_ops(n, n);
+    out.run("Sequence", "get_key_at_random", n, [&](recorder& r) {
+        Sequence<int, int> seq;
+        for (std::size_t i = 0; i < n; ++i) seq.push_back(static_cast<int>(i), 0);
+        rng g;
+        r.time_each(random_ops, 1, [&](std::size_t) { sink += seq.get_key_at(g.below(n)); });
+    });
+    out.run("flat_sequence", "get_key_at_random", n, [&](recorder& r) {
+        flat_sequence<int, int> seq;
+        for (std::size_t i = 0; i < n; ++i) seq.push_back(static_cast<int>(i), 0);
+        rng g;
+        r.time_each(n, batch, [&](std::size_t) { sink += seq.get_key_at(g.below(n)); });
+    });
+    out.run("std::list", "next_random", n, [&](recorder& r) {
+        std::list<std::pair<int, int>> list;
+        for (std::size_t i = 0; i < n; ++i) list.emplace_back(static_cast<int>(i), 0);
+        rng g;
+        r.time_each(random_ops, 1, [&](std::size_t) { sink += std::next(list.begin(), g.below(n))->first; });
+    });
+    out.run("Sequence", "get_key_at_ascending", n, [&](recorder& r) {
+        Sequence<int, int> seq;
+        for (std::size_t i = 0; i < n; ++i) seq.push_back(static_cast<int>(i), 0);
+        r.time_each(n, batch, [&](std::size_t i) { sink += seq.get_key_at(static_cast<int>(i)); });
+    });
+
+    // one operation is a whole split of an n-element sequence into blocks of 3 and 2
+    std::size_t split_ops = linear_ops(n, 50);
+    out.run("Sequence", "split_pos", n, [&](recorder& r) {
+        for (std::size_t rep = 0; rep < split_ops; ++rep) {
+            Sequence<int, int> seq, seq1, seq2;
+            for (std::size_t i = 0; i < n; ++i) seq.push_back(static_cast<int>(i % 100), 0);
+            r.time(1, [&] { split_pos(seq, 0, 3, 2, static_cast<int>(n / 5), seq1, seq2); });
+            sink += seq1.size() + seq2.size();
+        }
+    });
+    out.run("Sequence", "split_key", n, [&](recorder& r) {
+        for (std::size_t rep = 0; rep < split_ops; ++rep) {
+            Sequence<int, int> seq, seq1, seq2;
+            for (std::size_t i = 0; i < n; ++i) seq.push_back(static_cast<int>(i % 100), 0);
+            r.time(1, [&] { split_key(seq, 50, 1, 3, 2, static_cast<int>(n / 5), seq1, seq2); });
+            sink += seq1.size() + seq2.size();
+        }
+    });
+    // the same split read from a record stream, which builds the output nodes instead of
+    // relinking the ones of a source sequence
+    out.run("Sequence", "split_key_range", n, [&](recorder& r) {
+        std::vector<std::pair<int, int>> records;
+        for (std::size_t i = 0; i < n; ++i) records.emplace_back(static_cast<int>(i % 100), 0);
+        for (std::size_t rep = 0; rep < split_ops; ++rep) {
+            Sequence<int, int> seq1, seq2;
+            r.time(1, [&] { split_key_range(records.begin(), records.end(), 50, 1, 3, 2, static_cast<int>(n / 5), seq1, seq2); });
+            sink += seq1.size() + seq2.size();
+        }
+    });
+    out.run("flat_sequence", "split_pos", n, [&](recorder& r) {
+        for (std::size_t rep = 0; rep < split_ops; ++rep) {
+            flat_sequence<int, int> seq, seq1, seq2;
+            for (std::size_t i = 0; i < n; ++i) seq.push_back(static_cast<int>(i % 100), 0);
+            r.time(1, [&] { split_pos(seq, 0, 3, 2, static_cast<int>(n / 5), seq1, seq2); });
+            sink += seq1.size() + seq2.size();
+        }
+    });
+}
+
+//bi_ring and std::list
+static void bench_rings(reporter& out, std::size_t n) {
+    const std::size_t batch = 256;
+
+    out.run("bi_ring", "push_back", n, [&](recorder& r) {
+        bi_ring<int, int> ring;
+        r.time_each(n, batch, [&](std::size_t i) { ring.push_back(static_cast<int>(i), 0); });
+    });
+    out.run("bi_ring", "pop_front", n, [&](recorder& r) {
+        bi_ring<int, int> ring;
+        for (std::size_t i = 0; i < n; ++i) ring.push_back(static_cast<int>(i), 0);
+        r.time_each(n, batch, [&](std::size_t) { ring.pop_front(); });
+    });
+
+    // both rings hold n/2 elements, every second key of the first one also is in the second
+    std::size_t whole_ops = linear_ops(n, 50);
+    bi_ring<int, int> first, second;
+    for (std::size_t i = 0; i < n / 2; ++i) {
+        first.push_back(static_cast<int>(i), 1);
+        second.push_back(static_cast<int>(i * 2), 1);
+    }
+    out.run("bi_ring", "join", n, [&](recorder& r) {
+        r.time_each(whole_ops, 1, [&](std::size_t) { sink += join(first, second).is_empty() ? 0 : 1; });
+    });
+    out.run("bi_ring", "join_parallel", n, [&](recorder& r) { // every hardware thread
+        r.time_each(whole_ops, 1, [&](std::size_t) { sink += join_parallel(first, second).is_empty() ? 0 : 1; });
+    });
+    out.run("std::map", "join", n, [&](recorder& r) { // the same merge done with a std::map
+        r.time_each(whole_ops, 1, [&](std::size_t) {
+            std::map<int, int> merged;
+            for (const bi_ring<int, int>* ring : {&first, &second}) {
+                if (ring->is_empty()) continue;
+                auto it = ring->begin();
+                do {
+                    merged[it.key()] += it.info();
+                } while (++it != ring->begin());
+            }
+            sink += merged.size();
+        });
+    });
+    out.run("bi_ring", "shuffle", n, [&](recorder& r) { // output of n elements
+        unsigned int reps = static_cast<unsigned int>(n / 5);
+        r.time_each(whole_ops, 1, [&](std::size_t) { sink += shuffle(first, 3, second, 2, reps).is_empty() ? 0 : 1; });
+    });
+    out.run("bi_ring", "shuffle_parallel", n, [&](recorder& r) {
+        unsigned int reps = static_cast<unsigned int>(n / 5);
+        r.time_each(whole_ops, 1, [&](std::size_t) {
+            sink += shuffle_parallel(first, 3, second, 2, reps).is_empty() ? 0 : 1;
+        });
+    });
+}
+
+//avl_tree, btree_map, frozen_map and std::map
+static void bench_trees(reporter& out, std::size_t n) {
+    const std::size_t batch = 64;
+    std::vector<int> keys(n);
+    rng g;
+    for (std::size_t i = 0; i < n; ++i) keys[i] = static_cast<int>(g.next() >> 33);
+
+    avl_tree<int, int> avl;
+    out.run("avl_tree", "insert", n, [&](recorder& r) {
+        r.time_each(n, batch, [&](std::size_t i) { avl.insert(keys[i], static_cast<int>(i)); });
+    });
+    btree_map<int, int> btree;
+    out.run("btree_map", "insert", n, [&](recorder& r) {
+        r.time_each(n, batch, [&](std::size_t i) { btree.insert(keys[i], static_cast<int>(i)); });
+    });
+    std::map<int, int> map;
+    out.run("std::map", "insert", n, [&](recorder& r) {
+        r.time_each(n, batch, [&](std::size_t i) { map[keys[i]] = static_cast<int>(i); });
+    });
+    if (avl.empty()) { // insert was filtered out, the lookups below still need the data
+        for (std::size_t i = 0; i < n; ++i) {
+            avl.insert(keys[i], static_cast<int>(i));
+            btree.insert(keys[i], static_cast<int>(i));
+            map[keys[i]] = static_cast<int>(i);
+        }
+    }
+
+    // half of the searched keys are present
+    std::vector<int> probes(n);
+    for (std::size_t i = 0; i < n; ++i) probes[i] = i % 2 ? keys[g.below(n)] : static_cast<int>(g.next() >> 33);
+    out.run("avl_tree", "search", n, [&](recorder& r) {
+        int info;
+        r.time_each(n, batch, [&](std::size_t i) { sink += avl.search(probes[i], info) ? 1 : 0; });
+    });
+    out.run("avl_tree", "search_batch", n, [&](recorder& r) {
+        std::vector<const int*> found(batch);
+        for (std::size_t done = 0; done < n; done += batch) {
+            std::size_t count = std::min(batch, n - done);
+            r.time(count, [&] { sink += avl.search_batch(probes.data() + done, count, found.data()); });
+        }
+    });
+    out.run("btree_map", "search", n, [&](recorder& r) {
+        int info;
+        r.time_each(n, batch, [&](std::size_t i) { sink += btree.search(probes[i], info) ? 1 : 0; });
+    });
+    out.run("frozen_map", "search", n, [&](recorder& r) {
+        frozen_map<int, int> frozen(btree);
+        int info;
+        r.time_each(n, batch, [&](std::size_t i) { sink += frozen.search(probes[i], info) ? 1 : 0; });
+    });
+    out.run("std::map", "search", n, [&](recorder& r) {
+        r.time_each(n, batch, [&](std::size_t i) { sink += map.count(probes[i]); });
+    });
+
+    std::size_t whole_ops = linear_ops(n, 20);
+    out.run("avl_tree", "maxinfo_selector", n, [&](recorder& r) {
+        r.time_each(whole_ops, 1, [&](std::size_t) { sink += maxinfo_selector(avl, 100).size(); });
+    });
+    out.run("std::map", "maxinfo_selector", n, [&](recorder& r) { // copy and partial sort
+        r.time_each(whole_ops, 1, [&](std::size_t) {
+            std::vector<std::pair<int, int>> v(map.begin(), map.end());
+            std::size_t k = std::min<std::size_t>(100, v.size());
+            std::partial_sort(v.begin(), v.begin() + k, v.end(), [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+                return a.second > b.second || (a.second == b.second && a.first < b.first);
+            });
+            sink += k;
+        });
+    });
+
+    out.run("avl_tree", "remove", n, [&](recorder& r) {
+        r.time_each(n, batch, [&](std::size_t i) { avl.remove(keys[i]); });
+    });
+    out.run("btree_map", "remove", n, [&](recorder& r) {
+        r.time_each(n, batch, [&](std::size_t i) { btree.remove(keys[i]); });
+    });
+    out.run("std::map", "remove", n, [&](recorder& r) {
+        r.time_each(n, batch, [&](std::size_t i) { map.erase(keys[i]); });
+    });
+
+    // n words drawn from a vocabulary of n / 10 distinct ones; one operation is one word
+    std::string text;
+    std::size_t vocabulary = std::max<std::size_t>(1, n / 10);
+    for (std::size_t i = 0; i < n; ++i) {
+        text += "word";
+        text += std::to_string(g.below(vocabulary));
+        text += i % 12 == 11 ? '\n' : ' ';
+    }
+    out.run("avl_tree", "count_words", n, [&](recorder& r) {
+        r.time(n, [&] { sink += count_words(text.data(), text.size()).size(); });
+    });
+    out.run("interned_avl_tree", "count_words", n, [&](recorder& r) {
+        r.time(n, [&] { sink += count_words<interned_avl_tree<int>>(text.data(), text.size()).size(); });
+    });
+    out.run("btree_map", "count_words", n, [&](recorder& r) {
+        r.time(n, [&] { sink += count_words<btree_map<std::string, int>>(text.data(), text.size()).size(); });
+    });
+    out.run("std::map", "count_words", n, [&](recorder& r) {
+        r.time(n, [&] {
+            std::map<std::string, int> counts;
+            std::istringstream in(text);
+            std::string word;
+            while (in >> word) counts[word]++;
+            sink += counts.size();
+        });
+    });
+}
+
+static std::vector<std::size_t> parse_sizes(const std::string& list) {
+    std::vector<std::size_t> sizes;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        double value = std::stod(item); // accepts 1e6 as well as 1000000
+        if (value >= 1) sizes.push_back(static_cast<std::size_t>(value));
+    }
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes = {1000, 10000, 100000, 1000000};
+    std::string filter;
+    bool json = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--sizes") && i + 1 < argc) {
+            sizes = parse_sizes(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!std::strcmp(argv[i], "--json")) {
+            json = true;
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--sizes 1e3,1e4,1e5,1e6,1e7] [--filter text] [--json]" << std::endl;
+            return 1;
+        }
+    }
+
+    reporter out(filter, json);
+    for (std::size_t n : sizes) {
+        bench_sequences(out, n);
+        bench_rings(out, n);
+        bench_trees(out, n);
+    }
+    return 0;
+}
@@ -0,0 +1,770 @@
+#pragma once
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "key_scan.hpp"
+/**
+ * @file flat_sequence.hpp
+ * @brief Contiguous (structure of arrays) alternative to Sequence with the same interface.
+ *
+ * Template parameters:
+ *   - Key:   Type used for keys. operator== must be defined for the key searches.
+ *   - Info:  Type used for stored information associated with each key.
+ *   - Alloc: Allocator for the element arrays (rebound to Key and to Info). Defaults to
+ *            std::allocator.
+ *
+ * Notes:
+ *   - Keys and infos live in two separate arrays, so key scans (find_key_occurrence,
+ *     update_info, split_key) walk contiguous memory instead of chasing node pointers;
+ *     for arithmetic keys they are vectorized (see key_scan.hpp).
+ *   - Both arrays are gap buffers: the free capacity forms one gap that is moved to the
+ *     place of each insertion or removal. Edits at the same place (a burst of push_back,
+ *     of push_front, or inserts around one position) cost O(1) amortized; moving the gap
+ *     costs O(distance moved).
+ *   - Code written against Sequence can switch containers with a typedef; split_pos and
+ *     split_key are provided for flat_sequence below.
+ */
+
+/**
+ * @class flat_sequence
+ * @brief A gap-buffered array of (Key, Info) pairs with the Sequence interface.
+ *
+ * Complexity summary (n = number of elements, d = distance the gap moves):
+ *   - push_front / push_back / pop_front / pop_back: O(1) amortized + O(d)
+ *   - insert_at / remove_at: O(d)
+ *   - size, get_key_at / get_info_at, replace_at: O(1)
+ *   - find_key_occurrence / update_info: O(n), over contiguous keys
+ *   - reverse, copy constructor / assignment: O(n)
+ */
+template <typename Key, typename Info, typename Alloc = std::allocator<std::pair<const Key, Info>>>
+class flat_sequence {
+private:
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Key> key_allocator;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Info> info_allocator;
+    typedef std::allocator_traits<key_allocator> key_traits;
+    typedef std::allocator_traits<info_allocator> info_traits;
+
+    Key* keys;
+    Info* infos;
+    unsigned int cap;        // slots in each array
+    unsigned int gap_begin;  // the gap is [gap_begin, gap_end); elements fill the rest
+    unsigned int gap_end;
+    key_allocator key_alloc;
+    info_allocator info_alloc;
+
+    unsigned int slot(unsigned int position) const;
+    void move_gap(unsigned int position);
+    void grow(unsigned int min_cap);
+    void release();
+    template <typename K, typename I>
+    void emplace_at(unsigned int position, K&& k, I&& i);
+    void erase_at(unsigned int position);
+    void split_at(unsigned int start, int len1, int len2, int rounds, flat_sequence& seq1, flat_sequence& seq2);
+    static const Key* find_nth(const Key* first, const Key* last, const Key& k, int& remaining);
+
+    template <typename K, typename I, typename A>
+    friend void split_pos(flat_sequence<K, I, A>& seq, int start_pos, int len1, int len2, int count,
+                          flat_sequence<K, I, A>& seq1, flat_sequence<K, I, A>& seq2);
+    template <typename K, typename I, typename A>
+    friend void split_key(flat_sequence<K, I, A>& seq, const K& start_key, int start_occ, int len1, int len2, int count,
+                          flat_sequence<K, I, A>& seq1, flat_sequence<K, I, A>& seq2);
+
+public:
+    typedef Alloc allocator_type;
+
+    flat_sequence();
+    explicit flat_sequence(const Alloc& a);
+    flat_sequence(const flat_sequence& other);
+    flat_sequence(flat_sequence&& other) noexcept;
+    ~flat_sequence();
+    void push_front(const Key& k, const Info& i);
+    void push_front(Key&& k, Info&& i);
+    template <typename K, typename I>
+    void emplace_front(K&& k, I&& i);
+    bool pop_front();
+    void push_back(const Key& k, const Info& i);
+    void push_back(Key&& k, Info&& i);
+    template <typename K, typename I>
+    void emplace_back(K&& k, I&& i);
+    bool pop_back();
+    bool is_empty() const;
+    void clear();
+    void print() const;
+    flat_sequence& operator=(const flat_sequence& other);
+    flat_sequence& operator=(flat_sequence&& other);
+    bool insert_at(const Key& k, const Info& i, int position); // returns true if successful
+    bool remove_at(int position); // returns true if successful
+    unsigned int size() const;
+    Key get_key_at(int position) const;
+    Info get_info_at(int position) const;
+    void reverse();
+    void update_info(const Key& k, const Info& new_info, int occurrence=1);
+    void subsequence(int start_pos, int length, flat_sequence& subseq) const;
+    void replace_at(int position, const Key& new_key, const Info& new_info);
+    int find_key_occurrence(const Key& k, int occurrence) const;
+    unsigned int capacity() const;
+    void reserve(unsigned int n);
+    allocator_type get_allocator() const;
+};
+
+/**
+ * @brief Default constructor. Creates an empty flat_sequence without allocating.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+flat_sequence<Key, Info, Alloc>::flat_sequence()
+    : keys(nullptr), infos(nullptr), cap(0), gap_begin(0), gap_end(0), key_alloc(), info_alloc() {}
+
+/**
+ * @brief Create an empty flat_sequence whose arrays are obtained from `a`.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+flat_sequence<Key, Info, Alloc>::flat_sequence(const Alloc& a)
+    : keys(nullptr), infos(nullptr), cap(0), gap_begin(0), gap_end(0), key_alloc(a), info_alloc(a) {}
+
+/**
+ * @brief Copy constructor. Copies all elements of `other` into arrays sized to fit.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+flat_sequence<Key, Info, Alloc>::flat_sequence(const flat_sequence& other)
+    : keys(nullptr), infos(nullptr), cap(0), gap_begin(0), gap_end(0),
+      key_alloc(key_traits::select_on_container_copy_construction(other.key_alloc)),
+      info_alloc(info_traits::select_on_container_copy_construction(other.info_alloc)) {
+    reserve(other.size());
+    for (unsigned int p = 0; p < other.size(); ++p) {
+        unsigned int s = other.slot(p);
+        push_back(other.keys[s], other.infos[s]);
+    }
+}
+
+/**
+ * @brief Move constructor. Takes over the arrays of `other`, which is left empty.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+flat_sequence<Key, Info, Alloc>::flat_sequence(flat_sequence&& other) noexcept
+    : keys(other.keys), infos(other.infos), cap(other.cap), gap_begin(other.gap_begin), gap_end(other.gap_end),
+      key_alloc(other.key_alloc), info_alloc(other.info_alloc) {
+    other.keys = nullptr;
+    other.infos = nullptr;
+    other.cap = other.gap_begin = other.gap_end = 0;
+}
+
+/**
+ * @brief Destructor. Destroys all elements and frees both arrays.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+flat_sequence<Key, Info, Alloc>::~flat_sequence() {
+    release();
+}
+
+/**
+ * @brief Map a zero-based position to its array slot, skipping the gap.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+unsigned int flat_sequence<Key, Info, Alloc>::slot(unsigned int position) const {
+    return position < gap_begin ? position : position + (gap_end - gap_begin);
+}
+
+/**
+ * @brief Move the gap so that it starts at `position`.
+ *
+ * Elements between the old and the new gap are moved across it one at a time; the gap
+ * bounds are updated after each element, so an exception leaves a valid sequence.
+ *
+ * Complexity: O(distance moved)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::move_gap(unsigned int position) {
+    if (gap_begin == gap_end) { // no gap: nothing to move, only relabel
+        gap_begin = gap_end = position;
+        return;
+    }
+    while (gap_begin > position) { // shift the element before the gap to its end
+        unsigned int from = gap_begin - 1, to = gap_end - 1;
+        key_traits::construct(key_alloc, keys + to, std::move_if_noexcept(keys[from]));
+        try {
+            info_traits::construct(info_alloc, infos + to, std::move_if_noexcept(infos[from]));
+        } catch (...) {
+            key_traits::destroy(key_alloc, keys + to);
+            throw;
+        }
+        key_traits::destroy(key_alloc, keys + from);
+        info_traits::destroy(info_alloc, infos + from);
+        --gap_begin;
+        --gap_end;
+    }
+    while (gap_begin < position) { // shift the element after the gap to its start
+        unsigned int from = gap_end, to = gap_begin;
+        key_traits::construct(key_alloc, keys + to, std::move_if_noexcept(keys[from]));
+        try {
+            info_traits::construct(info_alloc, infos + to, std::move_if_noexcept(infos[from]));
+        } catch (...) {
+            key_traits::destroy(key_alloc, keys + to);
+            throw;
+        }
+        key_traits::destroy(key_alloc, keys + from);
+        info_traits::destroy(info_alloc, infos + from);
+        ++gap_begin;
+        ++gap_end;
+    }
+}
+
+/**
+ * @brief Reallocate both arrays with room for at least `min_cap` elements.
+ *
+ * The capacity at least doubles. The gap keeps its position and absorbs the new room.
+ * Strong guarantee: if moving an element throws, the old arrays are kept.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::grow(unsigned int min_cap) {
+    unsigned int new_cap = cap < 8 ? 16 : cap * 2;
+    if (new_cap < min_cap) new_cap = min_cap;
+    unsigned int tail_len = cap - gap_end;
+    unsigned int new_gap_end = new_cap - tail_len;
+
+    Key* new_keys = key_traits::allocate(key_alloc, new_cap);
+    Info* new_infos = nullptr;
+    unsigned int k_done = 0, i_done = 0; // elements constructed so far, in slot order
+    auto new_slot = [&](unsigned int n) { return n < gap_begin ? n : n - gap_begin + new_gap_end; };
+    auto old_slot = [&](unsigned int n) { return n < gap_begin ? n : n - gap_begin + gap_end; };
+    unsigned int n_elems = gap_begin + tail_len;
+    try {
+        new_infos = info_traits::allocate(info_alloc, new_cap);
+        for (; k_done < n_elems; ++k_done) {
+            key_traits::construct(key_alloc, new_keys + new_slot(k_done), std::move_if_noexcept(keys[old_slot(k_done)]));
+        }
+        for (; i_done < n_elems; ++i_done) {
+            info_traits::construct(info_alloc, new_infos + new_slot(i_done), std::move_if_noexcept(infos[old_slot(i_done)]));
+        }
+    } catch (...) {
+        for (unsigned int n = 0; n < k_done; ++n) key_traits::destroy(key_alloc, new_keys + new_slot(n));
+        for (unsigned int n = 0; n < i_done; ++n) info_traits::destroy(info_alloc, new_infos + new_slot(n));
+        if (new_infos) info_traits::deallocate(info_alloc, new_infos, new_cap);
+        key_traits::deallocate(key_alloc, new_keys, new_cap);
+        throw;
+    }
+    release();
+    keys = new_keys;
+    infos = new_infos;
+    cap = new_cap;
+    gap_begin = n_elems - tail_len;
+    gap_end = new_gap_end;
+}
+
+/**
+ * @brief Destroy every element and free both arrays.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::release() {
+    clear();
+    if (keys) key_traits::deallocate(key_alloc, keys, cap);
+    if (infos) info_traits::deallocate(info_alloc, infos, cap);
+    keys = nullptr;
+    infos = nullptr;
+    cap = gap_begin = gap_end = 0;
+}
+
+/**
+ * @brief Construct a new element so that it ends up at `position` (0 <= position <= size()).
+ *
+ * Complexity: O(1) amortized + O(distance the gap moves)
+ */
+template <typename Key, typename Info, typename Alloc>
+template <typename K, typename I>
+void flat_sequence<Key, Info, Alloc>::emplace_at(unsigned int position, K&& k, I&& i) {
+    if (gap_begin == gap_end) grow(cap + 1);
+    move_gap(position);
+    key_traits::construct(key_alloc, keys + gap_begin, std::forward<K>(k));
+    try {
+        info_traits::construct(info_alloc, infos + gap_begin, std::forward<I>(i));
+    } catch (...) {
+        key_traits::destroy(key_alloc, keys + gap_begin);
+        throw;
+    }
+    ++gap_begin;
+}
+
+/**
+ * @brief Destroy the element at `position` (0 <= position < size()).
+ *
+ * Complexity: O(distance the gap moves)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::erase_at(unsigned int position) {
+    move_gap(position);
+    key_traits::destroy(key_alloc, keys + gap_end);
+    info_traits::destroy(info_alloc, infos + gap_end);
+    ++gap_end;
+}
+
+/**
+ * @brief Insert a new element at the front of the sequence.
+ *
+ * Complexity: O(1) amortized when the gap is already at the front
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::push_front(const Key& k, const Info& i) {
+    emplace_front(k, i);
+}
+
+/**
+ * @brief Insert a new element at the front of the sequence, moving the key and info in.
+ *
+ * Complexity: O(1) amortized when the gap is already at the front
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::push_front(Key&& k, Info&& i) {
+    emplace_front(std::move(k), std::move(i));
+}
+
+/**
+ * @brief Construct a new element in place at the front of the sequence.
+ *
+ * Complexity: O(1) amortized when the gap is already at the front
+ */
+template <typename Key, typename Info, typename Alloc>
+template <typename K, typename I>
+void flat_sequence<Key, Info, Alloc>::emplace_front(K&& k, I&& i) {
+    emplace_at(0, std::forward<K>(k), std::forward<I>(i));
+}
+
+/**
+ * @brief Remove the first element of the sequence.
+ * @return true if an element was removed, false if the sequence was already empty.
+ *
+ * Complexity: O(1) when the gap is at the front
+ */
+template <typename Key, typename Info, typename Alloc>
+bool flat_sequence<Key, Info, Alloc>::pop_front() {
+    if (is_empty()) return false;
+    erase_at(0);
+    return true;
+}
+
+/**
+ * @brief Append a new element at the end of the sequence.
+ *
+ * Complexity: O(1) amortized when the gap is already at the end
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::push_back(const Key& k, const Info& i) {
+    emplace_back(k, i);
+}
+
+/**
+ * @brief Append a new element at the end of the sequence, moving the key and info in.
+ *
+ * Complexity: O(1) amortized when the gap is already at the end
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::push_back(Key&& k, Info&& i) {
+    emplace_back(std::move(k), std::move(i));
+}
+
+/**
+ * @brief Construct a new element in place at the end of the sequence.
+ *
+ * Complexity: O(1) amortized when the gap is already at the end
+ */
+template <typename Key, typename Info, typename Alloc>
+template <typename K, typename I>
+void flat_sequence<Key, Info, Alloc>::emplace_back(K&& k, I&& i) {
+    emplace_at(size(), std::forward<K>(k), std::forward<I>(i));
+}
+
+/**
+ * @brief Remove the last element of the sequence.
+ * @return true if an element was removed, false if the sequence was empty.
+ *
+ * Unlike Sequence::pop_back no traversal is needed.
+ *
+ * Complexity: O(1) when the gap is at the end
+ */
+template <typename Key, typename Info, typename Alloc>
+bool flat_sequence<Key, Info, Alloc>::pop_back() {
+    if (is_empty()) return false;
+    erase_at(size() - 1);
+    return true;
+}
+
+/**
+ * @brief Check whether the sequence is empty.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+bool flat_sequence<Key, Info, Alloc>::is_empty() const {
+    return size() == 0;
+}
+
+/**
+ * @brief Remove all elements. The arrays are kept for reuse; the destructor frees them.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::clear() {
+    for (unsigned int p = 0; p < size(); ++p) {
+        unsigned int s = slot(p);
+        key_traits::destroy(key_alloc, keys + s);
+        info_traits::destroy(info_alloc, infos + s);
+    }
+    gap_begin = 0;
+    gap_end = cap;
+}
+
+/**
+ * @brief Print the contents to std::cout as "(key, info) " pairs followed by a newline.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::print() const {
+    for (unsigned int p = 0; p < size(); ++p) {
+        unsigned int s = slot(p);
+        std::cout << "(" << keys[s] << ", " << infos[s] << ") ";
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * @brief Assignment operator. Replaces contents with a copy of `other`.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+flat_sequence<Key, Info, Alloc>& flat_sequence<Key, Info, Alloc>::operator=(const flat_sequence& other) {
+    if (this == &other) return *this;
+    clear();
+    reserve(other.size());
+    for (unsigned int p = 0; p < other.size(); ++p) {
+        unsigned int s = other.slot(p);
+        push_back(other.keys[s], other.infos[s]);
+    }
+    return *this;
+}
+
+/**
+ * @brief Move assignment. Takes over the arrays of `other`, which is left empty.
+ *
+ * The arrays are adopted when the allocator propagates on move assignment or both
+ * allocators are equal; otherwise the elements are moved one by one.
+ *
+ * Complexity: O(n) to release the current contents, O(1) for the transfer itself
+ */
+template <typename Key, typename Info, typename Alloc>
+flat_sequence<Key, Info, Alloc>& flat_sequence<Key, Info, Alloc>::operator=(flat_sequence&& other) {
+    if (this == &other) return *this;
+    release();
+    bool propagate = key_traits::propagate_on_container_move_assignment::value;
+    if (propagate || key_alloc == other.key_alloc) {
+        if (propagate) {
+            key_alloc = other.key_alloc;
+            info_alloc = other.info_alloc;
+        }
+        keys = other.keys;
+        infos = other.infos;
+        cap = other.cap;
+        gap_begin = other.gap_begin;
+        gap_end = other.gap_end;
+        other.keys = nullptr;
+        other.infos = nullptr;
+        other.cap = other.gap_begin = other.gap_end = 0;
+    } else {
+        reserve(other.size());
+        for (unsigned int p = 0; p < other.size(); ++p) {
+            unsigned int s = other.slot(p);
+            push_back(std::move(other.keys[s]), std::move(other.infos[s]));
+        }
+        other.release();
+    }
+    return *this;
+}
+
+/**
+ * @brief Insert a new element at the specified zero-based position.
+ * @return true if insertion succeeded, false if position < 0 or position > size().
+ *
+ * Complexity: O(1) amortized + O(distance the gap moves)
+ */
+template <typename Key, typename Info, typename Alloc>
+bool flat_sequence<Key, Info, Alloc>::insert_at(const Key& k, const Info& i, int position) {
+    if (position < 0 || static_cast<unsigned int>(position) > size()) return false;
+    emplace_at(position, k, i);
+    return true;
+}
+
+/**
+ * @brief Remove the element at the specified zero-based position.
+ * @return true if removal succeeded, false if position is out of bounds.
+ *
+ * Complexity: O(distance the gap moves)
+ */
+template <typename Key, typename Info, typename Alloc>
+bool flat_sequence<Key, Info, Alloc>::remove_at(int position) {
+    if (position < 0 || static_cast<unsigned int>(position) >= size()) return false;
+    erase_at(position);
+    return true;
+}
+
+/**
+ * @brief Number of elements in the sequence.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+unsigned int flat_sequence<Key, Info, Alloc>::size() const {
+    return cap - (gap_end - gap_begin);
+}
+
+/**
+ * @brief Retrieve the key stored at the given zero-based position.
+ * @throws std::out_of_range if position < 0 or position >= size().
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+Key flat_sequence<Key, Info, Alloc>::get_key_at(int position) const {
+    if (position < 0 || static_cast<unsigned int>(position) >= size()) throw std::out_of_range("Position out of range");
+    return keys[slot(position)];
+}
+
+/**
+ * @brief Retrieve the info stored at the given zero-based position.
+ * @throws std::out_of_range if position < 0 or position >= size().
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+Info flat_sequence<Key, Info, Alloc>::get_info_at(int position) const {
+    if (position < 0 || static_cast<unsigned int>(position) >= size()) throw std::out_of_range("Position out of range");
+    return infos[slot(position)];
+}
+
+/**
+ * @brief Reverse the order of elements in place.
+ *
+ * The gap is moved to the end first, so both arrays are reversed as single blocks.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::reverse() {
+    move_gap(size());
+    std::reverse(keys, keys + gap_begin);
+    std::reverse(infos, infos + gap_begin);
+}
+
+/**
+ * @brief Scan [first, last) for the `remaining`-th key equal to `k`.
+ * @return Pointer to the match, or `last` with `remaining` decreased by the matches seen.
+ *
+ * The scan runs over contiguous keys; it is the single hot loop of all key searches.
+ * key_scan (key_scan.hpp) compares whole SIMD vectors of arithmetic keys at once.
+ *
+ * Complexity: O(last - first)
+ */
+template <typename Key, typename Info, typename Alloc>
+const Key* flat_sequence<Key, Info, Alloc>::find_nth(const Key* first, const Key* last, const Key& k, int& remaining) {
+    return key_scan<Key>::find_nth(first, last, k, remaining);
+}
+
+/**
+ * @brief Update the info of the nth occurrence of a given key.
+ * @param occurrence 1-based ordinal occurrence of the key to update (default: 1).
+ * @throws std::invalid_argument if occurrence <= 0.
+ *
+ * If fewer than `occurrence` matches exist, no change is made.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::update_info(const Key& k, const Info& new_info, int occurrence) {
+    int position = find_key_occurrence(k, occurrence);
+    if (position >= 0) infos[slot(position)] = new_info;
+}
+
+/**
+ * @brief Copy `length` elements starting at `start_pos` to the end of `subseq`.
+ * @throws std::out_of_range if start_pos < 0, length < 0, or the range exceeds the bounds.
+ *
+ * Complexity: O(length)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::subsequence(int start_pos, int length, flat_sequence& subseq) const {
+    if (start_pos < 0 || length < 0) {
+        throw std::out_of_range("Invalid start position or length");
+    }
+    if (static_cast<unsigned int>(start_pos) > size()) {
+        throw std::out_of_range("Start position out of range");
+    }
+    if (static_cast<unsigned int>(length) > size() - start_pos) {
+        throw std::out_of_range("Length exceeds list bounds");
+    }
+    subseq.reserve(subseq.size() + length);
+    for (int p = start_pos; p < start_pos + length; ++p) {
+        unsigned int s = slot(p);
+        subseq.push_back(keys[s], infos[s]);
+    }
+}
+
+/**
+ * @brief Replace the key and info at the specified zero-based position.
+ * @throws std::out_of_range if position < 0 or position >= size().
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::replace_at(int position, const Key& new_key, const Info& new_info) {
+    if (position < 0 || static_cast<unsigned int>(position) >= size()) throw std::out_of_range("Position out of range");
+    unsigned int s = slot(position);
+    keys[s] = new_key;
+    infos[s] = new_info;
+}
+
+/**
+ * @brief Find the position of the nth occurrence of a given key.
+ * @param occurrence 1-based ordinal occurrence to find.
+ * @return Zero-based index of the found occurrence, or -1 if not found.
+ * @throws std::invalid_argument if occurrence <= 0.
+ *
+ * Scans the block before the gap, then the block after it.
+ *
+ * Complexity: O(n)
+ */
+template <typename Key, typename Info, typename Alloc>
+int flat_sequence<Key, Info, Alloc>::find_key_occurrence(const Key& k, int occurrence) const {
+    if (occurrence <= 0) throw std::invalid_argument("Occurrence must be positive");
+    const Key* front_end = keys + gap_begin;
+    const Key* hit = find_nth(keys, front_end, k, occurrence);
+    if (hit != front_end) return hit - keys;
+    const Key* back = keys + gap_end;
+    const Key* back_end = keys + cap;
+    hit = find_nth(back, back_end, k, occurrence);
+    if (hit != back_end) return gap_begin + (hit - back);
+    return -1; // Not found
+}
+
+/**
+ * @brief Number of elements the arrays can hold before they are reallocated.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+unsigned int flat_sequence<Key, Info, Alloc>::capacity() const {
+    return cap;
+}
+
+/**
+ * @brief Make room for at least `n` elements.
+ *
+ * Complexity: O(n) if the arrays are reallocated, O(1) otherwise
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::reserve(unsigned int n) {
+    if (n > cap) grow(n);
+}
+
+/**
+ * @brief Return a copy of the allocator used by this sequence.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc>
+typename flat_sequence<Key, Info, Alloc>::allocator_type flat_sequence<Key, Info, Alloc>::get_allocator() const {
+    return allocator_type(key_alloc);
+}
+
+/**
+ * @brief Move alternating blocks of elements starting at `start` to seq1 and seq2.
+ *
+ * The gap is moved to `start` once; the moved elements then sit right after it and are
+ * taken off one at a time by advancing the gap end. Stops early when the sequence is
+ * exhausted.
+ *
+ * Complexity: O(distance the gap moves + moved elements)
+ */
+template <typename Key, typename Info, typename Alloc>
+void flat_sequence<Key, Info, Alloc>::split_at(unsigned int start, int len1, int len2, int rounds,
+                                              flat_sequence& seq1, flat_sequence& seq2) {
+    move_gap(start);
+    auto transfer = [&](flat_sequence& dst) {
+        dst.emplace_back(std::move_if_noexcept(keys[gap_end]), std::move_if_noexcept(infos[gap_end]));
+        key_traits::destroy(key_alloc, keys + gap_end);
+        info_traits::destroy(info_alloc, infos + gap_end);
+        ++gap_end;
+    };
+    while (gap_end < cap && rounds > 0) {
+        for (int i = 0; i < len1 && gap_end < cap; i++) {
+            transfer(seq1);
+        }
+        for (int j = 0; j < len2 && gap_end < cap; j++) {
+            transfer(seq2);
+        }
+        rounds--;
+    }
+}
+
+/**
+ * @brief split_pos for flat_sequence; same contract as split_pos in split.hpp.
+ *
+ * @throws std::invalid_argument on the same conditions as the Sequence version.
+ *
+ * Complexity: O(distance the gap moves + moved elements)
+ */
+template <typename Key, typename Info, typename Alloc>
+void split_pos(flat_sequence<Key, Info, Alloc>& seq, int start_pos, int len1, int len2, int count,
+               flat_sequence<Key, Info, Alloc>& seq1, flat_sequence<Key, Info, Alloc>& seq2) {
+    if (start_pos < 0 || start_pos > static_cast<int>(seq.size()) || len1 < 0 || len2 < 0 || count < 0 ||
+        count > static_cast<int>(seq.size())) {
+        throw std::invalid_argument("Invalid argument");
+    }
+    if (&seq1 == &seq || &seq2 == &seq) {
+        throw std::invalid_argument("Output sequence aliases the source");
+    }
+    seq.split_at(start_pos, len1, len2, count, seq1, seq2);
+}
+
+/**
+ * @brief split_key for flat_sequence; same contract as split_key in split.hpp.
+ *
+ * @throws std::invalid_argument on the same conditions as the Sequence version.
+ *
+ * Complexity: O(start position + distance the gap moves + moved elements)
+ */
+template <typename Key, typename Info, typename Alloc>
+void split_key(flat_sequence<Key, Info, Alloc>& seq, const Key& start_key, int start_occ, int len1, int len2, int count,
+               flat_sequence<Key, Info, Alloc>& seq1, flat_sequence<Key, Info, Alloc>& seq2) {
+    if (start_occ < 0 || len1 < 0 || len2 < 0 || count < 0 || count > static_cast<int>(seq.size())) {
+        throw std::invalid_argument("Invalid argument");
+    }
+    if (&seq1 == &seq || &seq2 == &seq) {
+        throw std::invalid_argument("Output sequence aliases the source");
+    }
+    int start = 0;
+    if (start_occ > 0 && !seq.is_empty()) {
+        start = seq.find_key_occurrence(start_key, start_occ);
+        if (start < 0) {
+            throw std::invalid_argument("Key occurrence not found");
+        }
+    }
+    seq.split_at(start, len1, len2, count, seq1, seq2);
+}
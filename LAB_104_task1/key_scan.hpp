@@ -0,0 +1,383 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define KEY_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KEY_SCAN_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define KEY_SCAN_NEON 1
+#endif
+
+/**
+ * @file key_scan.hpp
+ * @brief Search for the n-th occurrence of a key in a contiguous block of keys.
+ *
+ * key_scan<Key>::find_nth is the inner loop of flat_sequence's key searches. The generic
+ * version compares keys one by one with operator==. For arithmetic keys of 1, 2, 4 or 8
+ * bytes it is specialized at compile time to compare a whole vector of keys at once and
+ * count the matches from the compare mask, using the best instruction set the compiler
+ * targets (AVX2, then SSE2, then NEON on AArch64). Without any of them, or for other
+ * key types, the scalar version is used.
+ *
+ * Floating point keys are compared with floating point equality, exactly like ==:
+ * NaN matches nothing and -0.0 matches 0.0.
+ */
+
+/**
+ * @brief Scalar search; the fallback for every key type.
+ *
+ * Complexity: O(last - first)
+ */
+template <typename Key>
+struct scalar_key_scan {
+    /**
+     * @brief Find the `remaining`-th key equal to `k` in [first, last).
+     * @return Pointer to the match (with `remaining` set to 0), or `last` with `remaining`
+     *         decreased by the number of matches seen.
+     */
+    static const Key* find_nth(const Key* first, const Key* last, const Key& k, int& remaining) {
+        for (; first != last; ++first) {
+            if (*first == k && --remaining == 0) return first;
+        }
+        return last;
+    }
+};
+
+namespace key_scan_detail {
+
+inline int popcount(std::uint64_t m) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(m);
+#else
+    int n = 0;
+    for (; m; m &= m - 1) n++;
+    return n;
+#endif
+}
+
+inline int lowest_bit(std::uint64_t m) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(m);
+#else
+    int n = 0;
+    for (; !(m & 1); m >>= 1) n++;
+    return n;
+#endif
+}
+
+template <typename T, typename U>
+U bits_of(const T& value) {
+    U u;
+    std::memcpy(&u, &value, sizeof(U));
+    return u;
+}
+
+// Compare-and-mask backend for keys of `Size` bytes (`Float`: floating point compare).
+// A backend holds the broadcast key and reports, for `lanes` keys starting at p, a mask
+// with bit `stride * i` set when key i matches (other bits are zero).
+template <std::size_t Size, bool Float>
+struct simd_block {
+    static const bool available = false;
+};
+
+#if defined(KEY_SCAN_AVX2)
+
+template <>
+struct simd_block<1, false> {
+    static const bool available = true;
+    static const int lanes = 32, stride = 1;
+    __m256i needle;
+    template <typename T> explicit simd_block(const T& k) : needle(_mm256_set1_epi8(bits_of<T, char>(k))) {}
+    std::uint64_t match(const void* p) const {
+        __m256i v = _mm256_loadu_si256(static_cast<const __m256i*>(p));
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+    }
+};
+
+template <>
+struct simd_block<2, false> {
+    static const bool available = true;
+    static const int lanes = 16, stride = 2;
+    __m256i needle;
+    template <typename T> explicit simd_block(const T& k) : needle(_mm256_set1_epi16(bits_of<T, short>(k))) {}
+    std::uint64_t match(const void* p) const {
+        __m256i v = _mm256_loadu_si256(static_cast<const __m256i*>(p));
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, needle))) & 0x55555555u;
+    }
+};
+
+template <>
+struct simd_block<4, false> {
+    static const bool available = true;
+    static const int lanes = 8, stride = 1;
+    __m256i needle;
+    template <typename T> explicit simd_block(const T& k) : needle(_mm256_set1_epi32(bits_of<T, int>(k))) {}
+    std::uint64_t match(const void* p) const {
+        __m256i v = _mm256_loadu_si256(static_cast<const __m256i*>(p));
+        return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, needle)));
+    }
+};
+
+template <>
+struct simd_block<8, false> {
+    static const bool available = true;
+    static const int lanes = 4, stride = 1;
+    __m256i needle;
+    template <typename T> explicit simd_block(const T& k) : needle(_mm256_set1_epi64x(bits_of<T, long long>(k))) {}
+    std::uint64_t match(const void* p) const {
+        __m256i v = _mm256_loadu_si256(static_cast<const __m256i*>(p));
+        return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, needle)));
+    }
+};
+
+template <>
+struct simd_block<4, true> {
+    static const bool available = true;
+    static const int lanes = 8, stride = 1;
+    __m256 needle;
+    explicit simd_block(float k) : needle(_mm256_set1_ps(k)) {}
+    std::uint64_t match(const void* p) const {
+        __m256 v = _mm256_loadu_ps(static_cast<const float*>(p));
+        return _mm256_movemask_ps(_mm256_cmp_ps(v, needle, _CMP_EQ_OQ));
+    }
+};
+
+template <>
+struct simd_block<8, true> {
+    static const bool available = true;
+    static const int lanes = 4, stride = 1;
+    __m256d needle;
+    explicit simd_block(double k) : needle(_mm256_set1_pd(k)) {}
+    std::uint64_t match(const void* p) const {
+        __m256d v = _mm256_loadu_pd(static_cast<const double*>(p));
+        return _mm256_movemask_pd(_mm256_cmp_pd(v, needle, _CMP_EQ_OQ));
+    }
+};
+
+#elif defined(KEY_SCAN_SSE2)
+
+template <>
+struct simd_block<1, false> {
+    static const bool available = true;
+    static const int lanes = 16, stride = 1;
+    __m128i needle;
+    template <typename T> explicit simd_block(const T& k) : needle(_mm_set1_epi8(bits_of<T, char>(k))) {}
+    std::uint64_t match(const void* p) const {
+        __m128i v = _mm_loadu_si128(static_cast<const __m128i*>(p));
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+    }
+};
+
+template <>
+struct simd_block<2, false> {
+    static const bool available = true;
+    static const int lanes = 8, stride = 2;
+    __m128i needle;
+    template <typename T> explicit simd_block(const T& k) : needle(_mm_set1_epi16(bits_of<T, short>(k))) {}
+    std::uint64_t match(const void* p) const {
+        __m128i v = _mm_loadu_si128(static_cast<const __m128i*>(p));
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(v, needle))) & 0x5555u;
+    }
+};
+
+template <>
+struct simd_block<4, false> {
+    static const bool available = true;
+    static const int lanes = 4, stride = 1;
+    __m128i needle;
+    template <typename T> explicit simd_block(const T& k) : needle(_mm_set1_epi32(bits_of<T, int>(k))) {}
+    std::uint64_t match(const void* p) const {
+        __m128i v = _mm_loadu_si128(static_cast<const __m128i*>(p));
+        return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, needle)));
+    }
+};
+
+// SSE2 has no 64-bit compare: both 32-bit halves of a lane must match
+template <>
+struct simd_block<8, false> {
+    static const bool available = true;
+    static const int lanes = 2, stride = 1;
+    __m128i needle;
+    template <typename T> explicit simd_block(const T& k) : needle(_mm_set1_epi64x(bits_of<T, long long>(k))) {}
+    std::uint64_t match(const void* p) const {
+        __m128i v = _mm_loadu_si128(static_cast<const __m128i*>(p));
+        __m128i halves = _mm_cmpeq_epi32(v, needle);
+        __m128i both = _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_movemask_pd(_mm_castsi128_pd(both));
+    }
+};
+
+template <>
+struct simd_block<4, true> {
+    static const bool available = true;
+    static const int lanes = 4, stride = 1;
+    __m128 needle;
+    explicit simd_block(float k) : needle(_mm_set1_ps(k)) {}
+    std::uint64_t match(const void* p) const {
+        return _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(static_cast<const float*>(p)), needle));
+    }
+};
+
+template <>
+struct simd_block<8, true> {
+    static const bool available = true;
+    static const int lanes = 2, stride = 1;
+    __m128d needle;
+    explicit simd_block(double k) : needle(_mm_set1_pd(k)) {}
+    std::uint64_t match(const void* p) const {
+        return _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(static_cast<const double*>(p)), needle));
+    }
+};
+
+#elif defined(KEY_SCAN_NEON)
+
+// NEON has no movemask: narrowing the byte compare result by 4 bits gives a 64-bit mask
+// with 4 bits per byte; one bit per key is kept
+inline std::uint64_t neon_mask(uint8x16_t eq) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+}
+
+template <>
+struct simd_block<1, false> {
+    static const bool available = true;
+    static const int lanes = 16, stride = 4;
+    uint8x16_t needle;
+    template <typename T> explicit simd_block(const T& k) : needle(vdupq_n_u8(bits_of<T, std::uint8_t>(k))) {}
+    std::uint64_t match(const void* p) const {
+        return neon_mask(vceqq_u8(vld1q_u8(static_cast<const std::uint8_t*>(p)), needle)) & 0x1111111111111111ull;
+    }
+};
+
+template <>
+struct simd_block<2, false> {
+    static const bool available = true;
+    static const int lanes = 8, stride = 8;
+    uint16x8_t needle;
+    template <typename T> explicit simd_block(const T& k) : needle(vdupq_n_u16(bits_of<T, std::uint16_t>(k))) {}
+    std::uint64_t match(const void* p) const {
+        uint16x8_t eq = vceqq_u16(vld1q_u16(static_cast<const std::uint16_t*>(p)), needle);
+        return neon_mask(vreinterpretq_u8_u16(eq)) & 0x0101010101010101ull;
+    }
+};
+
+template <>
+struct simd_block<4, false> {
+    static const bool available = true;
+    static const int lanes = 4, stride = 16;
+    uint32x4_t needle;
+    template <typename T> explicit simd_block(const T& k) : needle(vdupq_n_u32(bits_of<T, std::uint32_t>(k))) {}
+    std::uint64_t match(const void* p) const {
+        uint32x4_t eq = vceqq_u32(vld1q_u32(static_cast<const std::uint32_t*>(p)), needle);
+        return neon_mask(vreinterpretq_u8_u32(eq)) & 0x0001000100010001ull;
+    }
+};
+
+template <>
+struct simd_block<8, false> {
+    static const bool available = true;
+    static const int lanes = 2, stride = 32;
+    uint64x2_t needle;
+    template <typename T> explicit simd_block(const T& k) : needle(vdupq_n_u64(bits_of<T, std::uint64_t>(k))) {}
+    std::uint64_t match(const void* p) const {
+        uint64x2_t eq = vceqq_u64(vld1q_u64(static_cast<const std::uint64_t*>(p)), needle);
+        return neon_mask(vreinterpretq_u8_u64(eq)) & 0x0000000100000001ull;
+    }
+};
+
+template <>
+struct simd_block<4, true> {
+    static const bool available = true;
+    static const int lanes = 4, stride = 16;
+    float32x4_t needle;
+    explicit simd_block(float k) : needle(vdupq_n_f32(k)) {}
+    std::uint64_t match(const void* p) const {
+        uint32x4_t eq = vceqq_f32(vld1q_f32(static_cast<const float*>(p)), needle);
+        return neon_mask(vreinterpretq_u8_u32(eq)) & 0x0001000100010001ull;
+    }
+};
+
+template <>
+struct simd_block<8, true> {
+    static const bool available = true;
+    static const int lanes = 2, stride = 32;
+    float64x2_t needle;
+    explicit simd_block(double k) : needle(vdupq_n_f64(k)) {}
+    std::uint64_t match(const void* p) const {
+        uint64x2_t eq = vceqq_f64(vld1q_f64(static_cast<const double*>(p)), needle);
+        return neon_mask(vreinterpretq_u8_u64(eq)) & 0x0000000100000001ull;
+    }
+};
+
+#endif
+
+// the vector backend for Key, if any (long double and other 16-byte types have none)
+template <typename Key>
+struct block_for {
+    static const bool is_float = std::is_floating_point<Key>::value;
+    static const bool fits = is_float ? (std::is_same<Key, float>::value || std::is_same<Key, double>::value)
+                                      : (sizeof(Key) == 1 || sizeof(Key) == 2 || sizeof(Key) == 4 || sizeof(Key) == 8);
+    typedef simd_block<fits ? sizeof(Key) : 0, is_float> type;
+    static const bool available = std::is_arithmetic<Key>::value && fits && type::available;
+};
+
+} // namespace key_scan_detail
+
+/**
+ * @brief Key scan used by the containers: scalar for most keys, see below for arithmetic ones.
+ */
+template <typename Key, typename Enable = void>
+struct key_scan : scalar_key_scan<Key> {};
+
+/**
+ * @brief Vectorized key scan for arithmetic keys with a SIMD backend.
+ *
+ * Whole vectors of keys are compared at once, four vectors per step. A vector whose match
+ * count is below `remaining` is skipped after one popcount, otherwise the wanted match is
+ * picked from the mask. The tail shorter than one vector is scanned with the scalar loop.
+ *
+ * Complexity: O(last - first), with lanes keys compared per instruction
+ */
+template <typename Key>
+struct key_scan<Key, typename std::enable_if<key_scan_detail::block_for<Key>::available>::type> {
+    static const Key* find_nth(const Key* first, const Key* last, const Key& k, int& remaining) {
+        if (remaining <= 0) return last;
+        const block needle(k);
+        const Key* hit;
+        // four vectors per step; a step without any match costs one test
+        for (; last - first >= 4 * block::lanes; first += 4 * block::lanes) {
+            std::uint64_t m[4];
+            for (int v = 0; v < 4; v++) m[v] = needle.match(first + v * block::lanes);
+            if (!(m[0] | m[1] | m[2] | m[3])) continue;
+            for (int v = 0; v < 4; v++) {
+                if (take(m[v], first + v * block::lanes, remaining, hit)) return hit;
+            }
+        }
+        for (; last - first >= block::lanes; first += block::lanes) {
+            if (take(needle.match(first), first, remaining, hit)) return hit;
+        }
+        return scalar_key_scan<Key>::find_nth(first, last, k, remaining);
+    }
+
+private:
+    typedef typename key_scan_detail::block_for<Key>::type block;
+
+    // consume the matches of one vector at p; true (and hit set) when the wanted one is among them
+    static bool take(std::uint64_t m, const Key* p, int& remaining, const Key*& hit) {
+        if (!m) return false;
+        int found = key_scan_detail::popcount(m);
+        if (found < remaining) {
+            remaining -= found;
+            return false;
+        }
+        while (--remaining > 0) m &= m - 1;
+        hit = p + key_scan_detail::lowest_bit(m) / block::stride;
+        return true;
+    }
+};
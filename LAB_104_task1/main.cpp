@@ -1,8 +1,13 @@
 #include <iostream>
 #include <cassert>
 #include <stdexcept>
+#include <limits>
+#include <vector>
+#include <algorithm>
 #include "sequence.hpp"
 #include "split.hpp"
+#include "flat_sequence.hpp"
+#include "../common/cow.hpp"
 
 // Test 1: Default constructor and is_empty
 void test_default_constructor_and_is_empty() {
@@ -415,6 +420,580 @@ void test_split_key_exceptions() {
     std::cout << "PASSED\n\n";
 }
 
+// Test 16: tail pointer and cached size stay consistent across mutations
+void test_tail_and_size_consistency() {
+    std::cout << "Test 16: tail pointer and cached size consistency\n";
+    Sequence<int, std::string> seq;
+
+    // insert_at the end moves the tail
+    seq.insert_at(1, "one", 0);
+    seq.insert_at(2, "two", 1);
+    seq.push_back(3, "three");
+    assert(seq.size() == 3);
+    assert(seq.get_key_at(2) == 3);
+
+    // removing the last node moves the tail back
+    assert(seq.remove_at(2) == true);
+    seq.push_back(4, "four");
+    assert(seq.size() == 3);
+    assert(seq.get_key_at(2) == 4);
+
+    // pop_back moves the tail back
+    assert(seq.pop_back() == true);
+    seq.push_back(5, "five");
+    assert(seq.get_key_at(2) == 5);
+
+    // reverse swaps head and tail
+    seq.reverse();
+    seq.push_back(6, "six");
+    assert(seq.size() == 4);
+    assert(seq.get_key_at(0) == 5);
+    assert(seq.get_key_at(3) == 6);
+
+    // emptying through pop_front resets the tail
+    while (seq.pop_front()) {}
+    assert(seq.is_empty() == true);
+    assert(seq.size() == 0);
+    seq.push_back(7, "seven");
+    assert(seq.size() == 1);
+    assert(seq.get_key_at(0) == 7);
+
+    // copying a larger sequence keeps order and size
+    for (int i = 0; i < 1000; i++) {
+        seq.push_back(i, "v");
+    }
+    Sequence<int, std::string> copy(seq);
+    assert(copy.size() == 1001);
+    assert(copy.get_key_at(1000) == 999);
+    copy.push_back(-1, "end");
+    assert(copy.get_key_at(1001) == -1);
+    std::cout << "PASSED\n\n";
+}
+
+// Test 17: split engine relinks nodes and keeps every tail/size consistent
+void test_split_relinking_consistency() {
+    std::cout << "Test 17: split relinking consistency\n";
+    Sequence<int, std::string> seq;
+    for (int i = 1; i <= 10; i++) {
+        seq.push_back(i, "value_" + std::to_string(i));
+    }
+    Sequence<int, std::string> seq1;
+    Sequence<int, std::string> seq2;
+    seq1.push_back(100, "existing");
+
+    // takes 3,4 | 5 | 6,7 | 8 and leaves 1,2,9,10
+    split_pos(seq, 2, 2, 1, 2, seq1, seq2);
+    assert(seq.size() == 4);
+    assert(seq1.size() == 5);
+    assert(seq2.size() == 2);
+    assert(seq1.get_key_at(0) == 100);
+    assert(seq1.get_key_at(1) == 3);
+    assert(seq1.get_key_at(4) == 7);
+    assert(seq2.get_key_at(1) == 8);
+    assert(seq.get_key_at(2) == 9);
+
+    // tails are still valid after relinking
+    seq.push_back(11, "eleven");
+    seq1.push_back(12, "twelve");
+    seq2.push_back(13, "thirteen");
+    assert(seq.get_key_at(4) == 11);
+    assert(seq1.get_key_at(5) == 12);
+    assert(seq2.get_key_at(2) == 13);
+
+    // split reaching the end of the source moves the tail back
+    Sequence<int, std::string> out1;
+    Sequence<int, std::string> out2;
+    split_key(seq, 9, 1, 5, 5, 1, out1, out2);
+    assert(seq.size() == 2);
+    assert(out1.size() == 3);
+    assert(out2.size() == 0);
+    seq.push_back(14, "fourteen");
+    assert(seq.get_key_at(2) == 14);
+
+    // output aliasing the source is rejected
+    try {
+        split_pos(seq, 0, 1, 1, 1, seq, out2);
+        assert(false); // Should not reach here
+    } catch (const std::invalid_argument& e) {
+        assert(true);
+    }
+    std::cout << "PASSED\n\n";
+}
+
+// Test 18: Sequence backed by the shared node pool
+void test_pool_allocator() {
+    std::cout << "Test 18: pool allocator\n";
+    typedef pool_allocator<std::pair<const int, std::string>> pool;
+    typedef Sequence<int, std::string, pool> PooledSeq;
+
+    PooledSeq seq;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 500; i++) {
+            seq.push_back(i, "value_" + std::to_string(i));
+        }
+        for (int i = 0; i < 250; i++) {
+            assert(seq.pop_front() == true);
+        }
+        assert(seq.size() == 250);
+        assert(seq.get_key_at(0) == 250);
+        seq.clear(); // releases the pool in bulk
+        assert(seq.is_empty() == true);
+    }
+
+    for (int i = 1; i <= 6; i++) {
+        seq.push_back(i, "value_" + std::to_string(i));
+    }
+    PooledSeq copy(seq); // gets its own pool
+    assert(copy.size() == 6);
+    assert(copy.get_allocator() != seq.get_allocator());
+
+    // outputs sharing the source's pool adopt the nodes
+    PooledSeq seq1(seq.get_allocator());
+    PooledSeq seq2(seq.get_allocator());
+    split_pos(seq, 0, 2, 1, 2, seq1, seq2);
+    assert(seq.size() == 0);
+    assert(seq1.size() == 4);
+    assert(seq2.get_key_at(1) == 6);
+
+    // outputs with pools of their own receive copies
+    PooledSeq other1;
+    PooledSeq other2;
+    split_key(copy, 3, 1, 1, 1, 2, other1, other2);
+    assert(copy.size() == 2);
+    assert(other1.get_key_at(0) == 3);
+    assert(other1.get_key_at(1) == 5);
+    assert(other2.get_info_at(1) == "value_6");
+    std::cout << "PASSED\n\n";
+}
+
+// Helper for Test 19: counts copies made of a payload
+struct CopyCounter {
+    static int copies;
+    std::string value;
+    CopyCounter(const std::string& v) : value(v) {}
+    CopyCounter(const CopyCounter& other) : value(other.value) { ++copies; }
+    CopyCounter(CopyCounter&& other) noexcept : value(std::move(other.value)) {}
+    CopyCounter& operator=(const CopyCounter& other) { value = other.value; ++copies; return *this; }
+    CopyCounter& operator=(CopyCounter&& other) noexcept { value = std::move(other.value); return *this; }
+};
+int CopyCounter::copies = 0;
+
+// Test 19: move semantics and emplace
+void test_move_and_emplace() {
+    std::cout << "Test 19: move semantics and emplace\n";
+    Sequence<int, CopyCounter> seq;
+    CopyCounter::copies = 0;
+    seq.push_back(1, CopyCounter("one"));
+    seq.push_front(0, CopyCounter("zero"));
+    seq.emplace_back(2, "two");   // Info built in place from const char*
+    seq.emplace_front(-1, "minus one");
+    assert(CopyCounter::copies == 0);
+    assert(seq.size() == 4);
+
+    Sequence<int, CopyCounter> moved(std::move(seq));
+    assert(CopyCounter::copies == 0);
+    assert(seq.is_empty() == true);
+    assert(seq.size() == 0);
+    assert(moved.size() == 4);
+    assert(moved.get_key_at(3) == 2);
+
+    Sequence<int, CopyCounter> assigned;
+    assigned.push_back(7, CopyCounter("seven"));
+    assigned = std::move(moved);
+    assert(CopyCounter::copies == 0);
+    assert(moved.is_empty() == true);
+    assert(assigned.size() == 4);
+    assigned.push_back(3, CopyCounter("three")); // tail taken over correctly
+    assert(assigned.get_key_at(4) == 3);
+
+    // the moved-from sequence is still usable
+    moved.push_back(5, CopyCounter("five"));
+    assert(moved.size() == 1);
+    std::cout << "PASSED\n\n";
+}
+
+// Helper for Test 20: does the flat_sequence hold the same elements as the Sequence?
+template <typename Flat>
+bool same_elements(const Sequence<int, std::string>& seq, const Flat& flat) {
+    if (seq.size() != flat.size()) return false;
+    for (int i = 0; i < (int)seq.size(); i++) {
+        if (seq.get_key_at(i) != flat.get_key_at(i) || seq.get_info_at(i) != flat.get_info_at(i)) return false;
+    }
+    return true;
+}
+
+// Test 20: flat_sequence behaves like Sequence
+void test_flat_sequence_matches_sequence() {
+    std::cout << "Test 20: flat_sequence matches Sequence\n";
+    Sequence<int, std::string> seq;
+    flat_sequence<int, std::string> flat;
+    unsigned int state = 12345;
+    auto next = [&state](unsigned int bound) { state = state * 1103515245u + 12345u; return (state >> 8) % bound; };
+
+    for (int step = 0; step < 3000; step++) {
+        int key = next(20);
+        std::string info = std::to_string(step);
+        switch (next(9)) {
+        case 0: seq.push_front(key, info); flat.push_front(key, info); break;
+        case 1: case 2: seq.push_back(key, info); flat.push_back(key, info); break;
+        case 3: assert(seq.pop_front() == flat.pop_front()); break;
+        case 4: assert(seq.pop_back() == flat.pop_back()); break;
+        case 5: {
+            int pos = next(seq.size() + 2);
+            assert(seq.insert_at(key, info, pos) == flat.insert_at(key, info, pos));
+            break;
+        }
+        case 6: {
+            int pos = next(seq.size() + 1);
+            assert(seq.remove_at(pos) == flat.remove_at(pos));
+            break;
+        }
+        case 7: {
+            int occ = next(3) + 1;
+            assert(seq.find_key_occurrence(key, occ) == flat.find_key_occurrence(key, occ));
+            seq.update_info(key, info, occ);
+            flat.update_info(key, info, occ);
+            break;
+        }
+        default:
+            if (!seq.is_empty()) {
+                int pos = next(seq.size());
+                seq.replace_at(pos, key, info);
+                flat.replace_at(pos, key, info);
+            }
+            if (step % 500 == 0) {
+                seq.reverse();
+                flat.reverse();
+            }
+        }
+        assert(same_elements(seq, flat));
+    }
+    assert(flat.capacity() >= flat.size());
+
+    // copies, subsequence and exceptions
+    flat_sequence<int, std::string> copy(flat), assigned;
+    assigned = copy;
+    assert(same_elements(seq, copy) && same_elements(seq, assigned));
+    Sequence<int, std::string> sub;
+    flat_sequence<int, std::string> flat_sub;
+    seq.subsequence(1, 5, sub);
+    flat.subsequence(1, 5, flat_sub);
+    assert(same_elements(sub, flat_sub));
+    bool thrown = false;
+    try { flat.subsequence(0, flat.size() + 1, flat_sub); } catch (const std::out_of_range&) { thrown = true; }
+    assert(thrown);
+    thrown = false;
+    try { flat.get_key_at(flat.size()); } catch (const std::out_of_range&) { thrown = true; }
+    assert(thrown);
+
+    // split_pos and split_key produce the same pieces
+    Sequence<int, std::string> s1, s2;
+    flat_sequence<int, std::string> f1, f2;
+    split_pos(seq, 2, 3, 1, 4, s1, s2);
+    split_pos(flat, 2, 3, 1, 4, f1, f2);
+    assert(same_elements(seq, flat) && same_elements(s1, f1) && same_elements(s2, f2));
+    int key = seq.get_key_at(seq.size() / 2);
+    split_key(seq, key, 2, 2, 2, 3, s1, s2);
+    split_key(flat, key, 2, 2, 2, 3, f1, f2);
+    assert(same_elements(seq, flat) && same_elements(s1, f1) && same_elements(s2, f2));
+    thrown = false;
+    try { split_key(flat, -7, 1, 1, 1, 1, f1, f2); } catch (const std::invalid_argument&) { thrown = true; }
+    assert(thrown);
+
+    // moves leave the source empty and usable
+    flat_sequence<int, std::string> moved(std::move(flat));
+    assert(flat.is_empty() && same_elements(seq, moved));
+    flat = std::move(moved);
+    assert(moved.is_empty() && same_elements(seq, flat));
+    flat.clear();
+    assert(flat.is_empty() && flat.capacity() > 0);
+    flat.push_back(1, "one");
+    assert(flat.get_info_at(0) == "one");
+    std::cout << "PASSED\n\n";
+}
+
+// Helper for Test 21: checks key_scan against the scalar loop for every occurrence of
+// every key, on all block alignments, and through a flat_sequence with the gap inside
+template <typename Key>
+bool key_scan_agrees(const std::vector<Key>& keys, const std::vector<Key>& probes) {
+    for (std::size_t start = 0; start < 5 && start <= keys.size(); start++) {
+        const Key* first = keys.data() + start;
+        const Key* last = keys.data() + keys.size();
+        for (const Key& k : probes) {
+            for (int occ = 1; occ <= 40; occ++) {
+                int expect_left = occ, got_left = occ;
+                const Key* expected = scalar_key_scan<Key>::find_nth(first, last, k, expect_left);
+                const Key* got = key_scan<Key>::find_nth(first, last, k, got_left);
+                if (expected != got || expect_left != got_left) return false;
+            }
+        }
+    }
+    flat_sequence<Key, int> flat;
+    for (std::size_t i = 0; i < keys.size(); i++) flat.push_back(keys[i], (int)i);
+    if (!keys.empty()) {
+        flat.insert_at(keys[0], -1, keys.size() / 3); // moves the gap into the middle
+    }
+    for (const Key& k : probes) {
+        int count = 0;
+        for (int i = 0; i < (int)flat.size(); i++) {
+            if (flat.get_key_at(i) == k && flat.find_key_occurrence(k, ++count) != i) return false;
+        }
+        if (flat.find_key_occurrence(k, count + 1) != -1) return false;
+    }
+    return true;
+}
+
+// Test 21: vectorized key scan finds the same n-th occurrence as the scalar loop
+void test_key_scan() {
+    std::cout << "Test 21: SIMD key scan\n";
+    unsigned int state = 777;
+    auto next = [&state](unsigned int bound) { state = state * 1103515245u + 12345u; return (state >> 8) % bound; };
+
+    std::vector<char> c;
+    std::vector<short> s;
+    std::vector<int> n;
+    std::vector<long long> ll;
+    std::vector<double> d;
+    for (int i = 0; i < 301; i++) {
+        c.push_back('a' + next(4));
+        s.push_back(-1 - (short)next(5));
+        n.push_back(next(6) * 100000);
+        ll.push_back((long long)next(3) << 33 | next(2)); // halves matching alone must not count
+        d.push_back(next(4) * 0.5);
+    }
+    d[7] = -0.0; // equal to 0.0, like ==
+    d.push_back(std::numeric_limits<double>::quiet_NaN());
+    assert(key_scan_agrees(c, {'a', 'b', 'c', 'd', 'z'}));
+    assert(key_scan_agrees(s, {(short)-1, (short)-3, (short)-5, (short)7}));
+    assert(key_scan_agrees(n, {0, 100000, 500000, 7}));
+    assert(key_scan_agrees(ll, {0LL, 1LL, 1LL << 33, (1LL << 34) | 1, 1LL << 32}));
+    assert(key_scan_agrees(d, {0.0, 0.5, 1.5, std::numeric_limits<double>::quiet_NaN()}));
+    assert(key_scan_agrees(std::vector<int>(), {1}));
+    assert(key_scan_agrees(std::vector<int>(3, 9), {9}));
+
+    // non-arithmetic keys keep the scalar path
+    flat_sequence<std::string, int> words;
+    words.push_back("b", 1);
+    words.push_back("a", 2);
+    words.push_back("b", 3);
+    assert(words.find_key_occurrence("b", 2) == 2);
+    std::cout << "PASSED\n\n";
+}
+
+// Test 22: cursors and the remembered position
+void test_cursors_and_position_cache() {
+    std::cout << "Test 22: cursors and position cache\n";
+    Sequence<int, std::string> seq;
+    auto c = seq.insert_after(seq.before_begin(), 1, "one");
+    c = seq.insert_after(c, 3, "three");
+    seq.insert_after(seq.begin(), 2, "two");
+    seq.insert_after(seq.before_begin(), 0, "zero");
+    c = seq.insert_after(c, 4, "four"); // after the tail
+    seq.push_back(5, "five");            // tail moved by insert_after
+    assert(seq.size() == 6);
+    for (int i = 0; i < 6; i++) assert(seq.get_key_at(i) == i);
+
+    // in-place access
+    for (auto it = seq.begin(); it != seq.end(); ++it) it.info() += "!";
+    seq.cursor_at(2).key() = 20;
+    assert(seq.get_info_at(2) == "two!");
+    assert(seq.get_key_at(2) == 20);
+    const Sequence<int, std::string>& view = seq;
+    int visited = 0;
+    for (auto it = view.begin(); it != view.end(); it++) visited++;
+    assert(visited == 6);
+    assert(++view.before_begin() == view.begin());
+
+    // erase_after, including the head and the tail
+    auto after = seq.erase_after(seq.cursor_at(1)); // removes 20
+    assert(after.key() == 3);
+    seq.erase_after(seq.before_begin());            // removes 0
+    after = seq.erase_after(seq.cursor_at(2));      // removes 5, the tail
+    assert(after == seq.end());
+    seq.push_back(6, "six");
+    assert(seq.size() == 4);
+    assert(seq.get_key_at(0) == 1 && seq.get_key_at(1) == 3 && seq.get_key_at(2) == 4 && seq.get_key_at(3) == 6);
+    bool thrown = false;
+    try { seq.erase_after(seq.cursor_at(3)); } catch (const std::out_of_range&) { thrown = true; }
+    assert(thrown);
+    thrown = false;
+    try { seq.insert_after(seq.end(), 0, "x"); } catch (const std::out_of_range&) { thrown = true; }
+    assert(thrown);
+
+    // the remembered position follows every kind of edit
+    Sequence<int, std::string> big;
+    for (int i = 0; i < 2000; i++) big.push_back(i, "v");
+    long long sum = 0;
+    for (int i = 0; i < 2000; i++) sum += big.get_key_at(i); // walks on, O(n) in total
+    assert(sum == 1999LL * 2000 / 2);
+    assert(big.get_key_at(1000) == 1000);
+    big.push_front(-1, "v");
+    assert(big.get_key_at(1000) == 999);
+    big.remove_at(0);
+    assert(big.get_key_at(1000) == 1000);
+    big.insert_at(-5, "v", 1001);
+    assert(big.get_key_at(1001) == -5 && big.get_key_at(1002) == 1001);
+    big.remove_at(1001);
+    assert(big.get_key_at(1001) == 1001);
+    big.reverse();
+    assert(big.get_key_at(1) == 1998);
+    Sequence<int, std::string> s1, s2;
+    big.get_key_at(1500);
+    split_pos(big, 0, 10, 10, 1, s1, s2);
+    assert(big.get_key_at(1480) == 1999 - 1500);
+    big.pop_back();
+    assert(big.get_key_at(big.size() - 1) == 1);
+    Sequence<int, std::string> sub;
+    big.subsequence(big.size(), 0, sub);
+    big.subsequence(1, 2, sub);
+    assert(sub.size() == 2 && sub.get_key_at(1) == big.get_key_at(2));
+    big.clear();
+    thrown = false;
+    try { big.get_key_at(0); } catch (const std::out_of_range&) { thrown = true; }
+    assert(thrown);
+    std::cout << "PASSED\n\n";
+}
+
+// Test 23: stats policy counters
+void test_stats_policy() {
+    std::cout << "Test 23: stats policy\n";
+    typedef std::allocator<std::pair<const int, std::string>> alloc_type;
+    Sequence<int, std::string, alloc_type, atomic_stats> seq;
+    for (int i = 0; i < 10; i++) seq.push_back(i, "v");
+    container_stats s = seq.stats();
+    assert(s.allocations == 10 && s.frees == 0 && s.node_hops == 0);
+
+    seq.get_key_at(4);                    // 4 hops from the head
+    seq.get_key_at(6);                    // walks on from position 4
+    assert(seq.stats().node_hops == 6);
+    assert(seq.find_key_occurrence(3, 1) == 3);
+    assert(seq.stats().node_hops == 9);
+    seq.update_info(42, "missing");       // full walk
+    assert(seq.stats().node_hops == 19);
+    seq.pop_back();                       // walks to the ninth node
+    s = seq.stats();
+    assert(s.node_hops == 27 && s.frees == 1);
+    seq.remove_at(0);
+    seq.clear();
+    s = seq.stats();
+    assert(s.allocations == 10 && s.frees == 10);
+    assert(s.rotations == 0 && s.version_bumps == 0);
+
+    Sequence<int, std::string, alloc_type, atomic_stats> copy;
+    copy.push_back(1, "a");
+    Sequence<int, std::string, alloc_type, atomic_stats> other(copy); // counters start at zero
+    assert(other.stats().allocations == 1 && copy.stats().allocations == 1);
+    copy.reset_stats();
+    assert(copy.stats().allocations == 0);
+
+    // the default policy keeps nothing
+    Sequence<int, std::string> plain;
+    plain.push_back(1, "a");
+    plain.get_key_at(0);
+    assert(plain.stats().allocations == 0 && plain.stats().node_hops == 0);
+    std::cout << "PASSED\n\n";
+}
+
+// Test 24: copy-on-write handles
+void test_cow_sequence() {
+    std::cout << "Test 24: copy-on-write Sequence\n";
+    cow<Sequence<int, std::string>> a;
+    for (int i = 0; i < 5; i++) a.mutate().push_back(i, "v");
+    cow<Sequence<int, std::string>> b = a;
+    cow<Sequence<int, std::string>> c;
+    c = b;
+    assert(a.shared() && &a.get() == &c.get());
+    assert(b->size() == 5 && (*c).get_key_at(4) == 4);
+
+    b.mutate().push_front(-1, "new");   // b gets its own copy
+    assert(a->size() == 5 && b->size() == 6 && c->size() == 5);
+    assert(b->get_key_at(0) == -1 && a->get_key_at(0) == 0);
+    assert(!b.shared() && a.shared());
+    Sequence<int, std::string>* own = &b.mutate();
+    b.mutate().pop_back();              // no further copy
+    assert(&b.mutate() == own && b->size() == 5);
+
+    cow<Sequence<int, std::string>> moved = std::move(a); // moves copy the handle
+    assert(a->size() == 5 && moved->size() == 5);
+    std::cout << "PASSED\n\n";
+}
+
+// Test 25: streaming split_key
+template <typename Key, typename Info>
+std::vector<std::pair<Key, Info>> records_of(const Sequence<Key, Info>& seq) {
+    std::vector<std::pair<Key, Info>> out;
+    for (auto c = seq.begin(); c != seq.end(); ++c) out.emplace_back(c.key(), c.info());
+    return out;
+}
+
+void test_split_key_stream() {
+    std::cout << "Test 25: streaming split_key\n";
+    // against split_key on many small inputs, including the cases it rejects
+    unsigned seed = 5;
+    auto next = [&seed](unsigned range) { seed = seed * 1103515245u + 12345u; return static_cast<int>((seed >> 16) % range); };
+    for (int round = 0; round < 400; round++) {
+        std::vector<std::pair<int, int>> input;
+        int n = next(20);
+        for (int i = 0; i < n; i++) input.emplace_back(next(4), i);
+        int start_occ = next(4), len1 = next(4), len2 = next(4), count = next(8);
+
+        Sequence<int, int> seq, seq1, seq2, out1, out2, rest;
+        for (const auto& r : input) seq.push_back(r.first, r.second);
+        seq1.push_back(-1, -1); // appended to, as with split_key
+        out1.push_back(-1, -1);
+        bool threw = false;
+        try {
+            split_key(seq, 2, start_occ, len1, len2, count, seq1, seq2);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        auto stream = make_key_split_stream<int, int>(2, start_occ, len1, len2, count, append_to(out1), append_to(out2),
+                                                      append_to(rest), 1 + next(3));
+        stream.feed(input.begin(), input.end());
+        bool stream_threw = false;
+        try {
+            stream.finish();
+        } catch (const std::invalid_argument&) {
+            stream_threw = true;
+        }
+        assert(threw == stream_threw);
+        if (!threw) {
+            assert(records_of(out1) == records_of(seq1));
+            assert(records_of(out2) == records_of(seq2));
+            assert(records_of(rest) == records_of(seq)); // what split_key left in place
+        }
+    }
+
+    // split_key_range and push(): bounded buffers over a long stream
+    Sequence<int, std::string> src, a, b, ra, rb;
+    std::vector<std::pair<int, std::string>> input;
+    for (int i = 0; i < 5000; i++) input.emplace_back(i % 7, std::to_string(i));
+    for (const auto& r : input) src.push_back(r.first, r.second);
+    split_key(src, 3, 2, 3, 2, 900, a, b);
+    split_key_range(input.begin(), input.end(), 3, 2, 3, 2, 900, ra, rb);
+    assert(records_of(ra) == records_of(a) && records_of(rb) == records_of(b));
+
+    std::size_t largest = 0, delivered = 0;
+    auto counting = [&](std::vector<std::pair<int, std::string>>& batch) {
+        largest = std::max(largest, batch.size());
+        delivered += batch.size();
+    };
+    auto s = make_key_split_stream<int, std::string>(3, 1, 4, 1, 1000, counting, discard_records(), discard_records(), 64);
+    for (int i = 0; i < 100000; i++) s.push(i % 7, std::string("x"));
+    assert(s.done() && delivered == 4000 - 4000 % 64); // the last partial batch is still buffered
+    s.finish();
+    assert(delivered == 4000 && largest == 64 && s.size() == 100000);
+
+    bool thrown = false;
+    try {
+        auto bad = make_key_split_stream<int, int>(0, -1, 1, 1, 1, discard_records(), discard_records());
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+    std::cout << "PASSED\n\n";
+}
+
 int main() {
     std::cout << "Running unit tests for Sequence and Split...\n\n";
     // - - - - -
@@ -435,7 +1014,18 @@ int main() {
     test_split_key_basic();
     test_split_pos_exceptions();
     test_split_key_exceptions();
+    // - - - - -
+    test_tail_and_size_consistency();
+    test_split_relinking_consistency();
+    test_pool_allocator();
+    test_move_and_emplace();
+    test_flat_sequence_matches_sequence();
+    test_key_scan();
+    test_cursors_and_position_cache();
+    test_stats_policy();
+    test_cow_sequence();
+    test_split_key_stream();
     
-    std::cout << "All 15 tests passed successfully!\n";
+    std::cout << "All 25 tests passed successfully!\n";
     return 0;
 }
\ No newline at end of file
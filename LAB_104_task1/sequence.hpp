@@ -1,5 +1,11 @@
 #pragma once
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "../common/container_stats.hpp"
+#include "../common/node_pool.hpp"
 /**
  * @file sequence.hpp
  * @brief Singly linked list container template mapping keys to associated info values.
@@ -8,6 +14,12 @@
  *   - Key:   Type used for node keys. Comparison operators (==, >, <) used by some operations
  *            must be defined for this type.
  *   - Info:  Type used for stored information associated with each key.
+ *   - Alloc: Allocator used for the nodes (rebound to the internal node type). Defaults to
+ *            std::allocator; pool_allocator from common/node_pool.hpp serves nodes from a
+ *            slab/free-list pool and lets clear() and the destructor release them in bulk.
+ *   - Stats: Counter policy from common/container_stats.hpp. no_stats (the default) costs
+ *            nothing; atomic_stats counts node allocations, frees and the next-pointer hops
+ *            of positional access and key searches, read back with stats().
  *
  * Notes:
  *   - This is a simple singly linked list implementation providing common list operations
@@ -25,15 +37,22 @@
  * Complexity summary (n = number of nodes):
  *   - push_front: O(1)
  *   - pop_front:  O(1)
- *   - push_back:  O(n)
+ *   - push_back:  O(1) (a tail pointer is maintained)
  *   - pop_back:   O(n)
  *   - insert_at:  O(n)
  *   - remove_at:  O(n)
- *   - size:       O(n)
+ *   - size:       O(1) (an element counter is maintained)
  *   - get_key_at / get_info_at: O(n)
  *   - reverse:    O(n)
  *   - update_info (search by key): O(n)
  *   - copy constructor / assignment: O(n)
+ *   - cursor insert_after / erase_after / key / info: O(1)
+ *
+ * Positional access remembers the last position it reached, so get_key_at, get_info_at,
+ * replace_at, insert_at and remove_at with non-decreasing positions walk on from there
+ * and a loop over positions 0..n-1 is O(n) in total instead of O(n^2). Methods that shift
+ * or unlink earlier nodes forget the position. Because const accessors update it, one
+ * Sequence must not be read from several threads at once without synchronization.
  */
 
 /**
@@ -46,7 +65,8 @@
  *   - next: Pointer to the next node in the list (nullptr for tail).
  */
 
-template <typename Key, typename Info>
+template <typename Key, typename Info, typename Alloc = std::allocator<std::pair<const Key, Info>>,
+          typename Stats = no_stats>
 class Sequence {
 private:
     struct Node {
@@ -54,22 +74,123 @@ private:
         Info info;
         Node* next;
         
-        Node(Key k, Info i) : key(k), info(i), next(nullptr) {}
+        template <typename K, typename I>
+        Node(K&& k, I&& i) : key(std::forward<K>(k)), info(std::forward<I>(i)), next(nullptr) {}
     };
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
     Node* head;
+    Node* tail;          // last node, nullptr when the list is empty
+    unsigned int count;  // number of nodes, kept in sync by every mutating method
+    node_allocator alloc;
+    mutable Node* last_node;  // node at position last_pos, nullptr when nothing is remembered
+    mutable int last_pos;
+    mutable Stats counters;
+
+    template <typename K, typename I>
+    Node* create_node(K&& k, I&& i);
+    void destroy_node(Node* n);
+    void release_nodes();
+    void append_node(Node* n);
+    Node* node_at(int position) const;
+    void forget_position() const;
+    void split_after(Node* prev, int len1, int len2, int rounds, Sequence& seq1, Sequence& seq2);
+
+    template <typename K, typename I, typename A, typename S>
+    friend void split_pos(Sequence<K, I, A, S>& seq, int start_pos, int len1, int len2, int count,
+                          Sequence<K, I, A, S>& seq1, Sequence<K, I, A, S>& seq2);
+    template <typename K, typename I, typename A, typename S>
+    friend void split_key(Sequence<K, I, A, S>& seq, const K& start_key, int start_occ, int len1, int len2, int count,
+                          Sequence<K, I, A, S>& seq1, Sequence<K, I, A, S>& seq2);
 
 public:
+    typedef Alloc allocator_type;
+
+    class const_cursor;
+
+    /**
+     * @class cursor
+     * @brief Forward cursor over the elements, with in-place access to key and info.
+     *
+     * A cursor stays valid until the element it refers to is removed. before_begin() is a
+     * position in front of the first element, usable only with insert_after and
+     * erase_after (and ++, which moves to the first element).
+     */
+    class cursor {
+        friend class Sequence;
+        friend class const_cursor;
+        Sequence* seq;
+        Node* node; // nullptr: before_begin() when before is set, end() otherwise
+        bool before;
+        cursor(Sequence* s, Node* n, bool b) : seq(s), node(n), before(b) {}
+    public:
+        cursor() : seq(nullptr), node(nullptr), before(false) {}
+        Key& key() const { return node->key; }
+        Info& info() const { return node->info; }
+        cursor& operator++() {
+            node = before ? seq->head : node->next;
+            before = false;
+            return *this;
+        }
+        cursor operator++(int) {
+            cursor temp = *this;
+            ++*this;
+            return temp;
+        }
+        bool operator==(const cursor& other) const { return node == other.node && before == other.before; }
+        bool operator!=(const cursor& other) const { return !(*this == other); }
+    };
+
+    /**
+     * @class const_cursor
+     * @brief Read-only counterpart of cursor.
+     */
+    class const_cursor {
+        friend class Sequence;
+        const Sequence* seq;
+        const Node* node;
+        bool before;
+        const_cursor(const Sequence* s, const Node* n, bool b) : seq(s), node(n), before(b) {}
+    public:
+        const_cursor() : seq(nullptr), node(nullptr), before(false) {}
+        const_cursor(const cursor& other) : seq(other.seq), node(other.node), before(other.before) {}
+        const Key& key() const { return node->key; }
+        const Info& info() const { return node->info; }
+        const_cursor& operator++() {
+            node = before ? seq->head : node->next;
+            before = false;
+            return *this;
+        }
+        const_cursor operator++(int) {
+            const_cursor temp = *this;
+            ++*this;
+            return temp;
+        }
+        bool operator==(const const_cursor& other) const { return node == other.node && before == other.before; }
+        bool operator!=(const const_cursor& other) const { return !(*this == other); }
+    };
+
     Sequence();
+    explicit Sequence(const Alloc& a);
     Sequence(const Sequence& other);
+    Sequence(Sequence&& other) noexcept;
     ~Sequence();
     void push_front(const Key& k, const Info& i);
+    void push_front(Key&& k, Info&& i);
+    template <typename K, typename I>
+    void emplace_front(K&& k, I&& i);
     bool pop_front();
     void push_back(const Key& k, const Info& i);
+    void push_back(Key&& k, Info&& i);
+    template <typename K, typename I>
+    void emplace_back(K&& k, I&& i);
     bool pop_back();
     bool is_empty() const;
     void clear();
     void print() const;
     Sequence& operator=(const Sequence& other);
+    Sequence& operator=(Sequence&& other);
     bool insert_at(const Key& k, const Info& i, int position); // returns true if successful
     bool remove_at(int position); // returns true if successful
     unsigned int size() const;
@@ -77,9 +198,25 @@ public:
     Info get_info_at(int position) const;
     void reverse();
     void update_info(const Key& k, const Info& new_info, int occurrence=1);
-    void subsequence(int start_pos, int length, Sequence<Key, Info>& subseq) const;
+    void subsequence(int start_pos, int length, Sequence& subseq) const;
     void replace_at(int position, const Key& new_key, const Info& new_info); 
     int find_key_occurrence(const Key& k, int occurrence) const;
+    allocator_type get_allocator() const;
+    container_stats stats() const;
+    void reset_stats();
+
+    cursor before_begin();
+    const_cursor before_begin() const;
+    cursor begin();
+    const_cursor begin() const;
+    cursor end();
+    const_cursor end() const;
+    cursor cursor_at(int position);
+    const_cursor cursor_at(int position) const;
+    cursor insert_after(cursor pos, const Key& k, const Info& i);
+    template <typename K, typename I>
+    cursor emplace_after(cursor pos, K&& k, I&& i);
+    cursor erase_after(cursor pos);
 };
 
 /**
@@ -87,18 +224,32 @@ public:
  *
  * Complexity: O(1)
  */
-template <typename Key, typename Info>
-Sequence<Key, Info>::Sequence() : head(nullptr) {}
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Sequence<Key, Info, Alloc, Stats>::Sequence()
+    : head(nullptr), tail(nullptr), count(0), alloc(), last_node(nullptr), last_pos(-1) {}
+
+/**
+ * @brief Create an empty Sequence whose nodes are obtained from `a`.
+ * @param a Allocator (or a copy of another container's allocator to share its pool).
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Sequence<Key, Info, Alloc, Stats>::Sequence(const Alloc& a)
+    : head(nullptr), tail(nullptr), count(0), alloc(a), last_node(nullptr), last_pos(-1) {}
 
 /**
  * @brief Copy constructor. Performs a deep copy of `other`.
  *
- * Copies all (Key, Info) pairs from `other` in the same order.
+ * Copies all (Key, Info) pairs from `other` in the same order. The allocator is obtained
+ * through select_on_container_copy_construction (a pool_allocator yields a fresh pool).
  *
  * Complexity: O(n) where n is other.size().
  */
-template <typename Key, typename Info>
-Sequence<Key, Info>::Sequence(const Sequence& other) : head(nullptr) {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Sequence<Key, Info, Alloc, Stats>::Sequence(const Sequence& other)
+    : head(nullptr), tail(nullptr), count(0),
+      alloc(node_traits::select_on_container_copy_construction(other.alloc)), last_node(nullptr), last_pos(-1) {
     Node* current = other.head;
     while (current) {
         push_back(current->key, current->info);
@@ -106,22 +257,96 @@ Sequence<Key, Info>::Sequence(const Sequence& other) : head(nullptr) {
     }
 }
 
+/**
+ * @brief Move constructor. Takes over the nodes of `other` without copying them.
+ *
+ * `other` is left empty and usable; it keeps (a copy of) its allocator.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Sequence<Key, Info, Alloc, Stats>::Sequence(Sequence&& other) noexcept
+    : head(other.head), tail(other.tail), count(other.count), alloc(other.alloc), last_node(nullptr), last_pos(-1) {
+    other.head = nullptr;
+    other.tail = nullptr;
+    other.count = 0;
+    other.forget_position();
+}
+
 /**
  * @brief Destructor. Releases all allocated nodes.
  *
- * Traverses the list and deletes each node. After destruction the list is empty.
+ * Traverses the list and destroys each node. After destruction the list is empty.
  *
- * Complexity: O(n)
+ * Complexity: O(n), O(chunks) for trivially destructible Key/Info in an exclusive pool
  */
-template <typename Key, typename Info>
-Sequence<Key, Info>::~Sequence() {
-    Node* current = head;
-    while(current) {
-        Node* nextNode = current->next;
-        delete current;
-        current = nextNode;
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Sequence<Key, Info, Alloc, Stats>::~Sequence() {
+    release_nodes();
+}
+
+/**
+ * @brief Allocate and construct a node through the node allocator.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename K, typename I>
+typename Sequence<Key, Info, Alloc, Stats>::Node* Sequence<Key, Info, Alloc, Stats>::create_node(K&& k, I&& i) {
+    Node* n = node_traits::allocate(alloc, 1);
+    try {
+        node_traits::construct(alloc, n, std::forward<K>(k), std::forward<I>(i));
+    } catch (...) {
+        node_traits::deallocate(alloc, n, 1);
+        throw;
+    }
+    counters.allocation();
+    return n;
+}
+
+/**
+ * @brief Destroy a node and return its memory to the node allocator.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::destroy_node(Node* n) {
+    node_traits::destroy(alloc, n);
+    node_traits::deallocate(alloc, n, 1);
+    counters.frees(1);
+}
+
+/**
+ * @brief Free every node and reset the list to empty.
+ *
+ * When the nodes come from a pool owned only by this sequence, the node destructors are
+ * run (skipped entirely for trivially destructible nodes) and the pool chunks are handed
+ * back in bulk instead of freeing node by node.
+ *
+ * Complexity: O(n), O(chunks) for trivially destructible Key/Info in an exclusive pool
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::release_nodes() {
+    if (pool_can_release(alloc)) {
+        if (!std::is_trivially_destructible<Node>::value) {
+            for (Node* current = head; current; current = current->next) {
+                node_traits::destroy(alloc, current);
+            }
+        }
+        pool_release(alloc);
+        counters.frees(count);
+    } else {
+        Node* current = head;
+        while(current) {
+            Node* nextNode = current->next;
+            destroy_node(current);
+            current = nextNode;
+        }
     }
     head = nullptr;
+    tail = nullptr;
+    count = 0;
+    forget_position();
 }
 
 /**
@@ -133,11 +358,37 @@ Sequence<Key, Info>::~Sequence() {
  *
  * Complexity: O(1)
  */
-template <typename Key, typename Info>
-void Sequence<Key, Info>::push_front(const Key& k, const Info& i) {
-    Node* newNode = new Node(k, i);
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::push_front(const Key& k, const Info& i) {
+    emplace_front(k, i);
+}
+
+/**
+ * @brief Insert a new element at the front of the list, moving the key and info in.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::push_front(Key&& k, Info&& i) {
+    emplace_front(std::move(k), std::move(i));
+}
+
+/**
+ * @brief Construct a new element in place at the front of the list.
+ * @param k Argument forwarded to the Key constructor.
+ * @param i Argument forwarded to the Info constructor.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename K, typename I>
+void Sequence<Key, Info, Alloc, Stats>::emplace_front(K&& k, I&& i) {
+    Node* newNode = create_node(std::forward<K>(k), std::forward<I>(i));
     newNode->next = head;
     head = newNode;
+    if (!tail) tail = newNode;
+    ++count;
+    forget_position();
 }
 
 /**
@@ -146,12 +397,15 @@ void Sequence<Key, Info>::push_front(const Key& k, const Info& i) {
  *
  * Complexity: O(1)
  */
-template <typename Key, typename Info>
-bool Sequence<Key, Info>::pop_front() {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+bool Sequence<Key, Info, Alloc, Stats>::pop_front() {
     if (is_empty()) return false;
     Node* temp = head;
     head = head->next;
-    delete temp;
+    if (!head) tail = nullptr;
+    destroy_node(temp);
+    --count;
+    forget_position();
     return true;
 }
 
@@ -160,22 +414,44 @@ bool Sequence<Key, Info>::pop_front() {
  * @param k Key for the new element.
  * @param i Associated info for the new element.
  *
- * If the list is empty the new element becomes the head. Requires traversal to find the tail.
+ * If the list is empty the new element becomes the head. The new node is linked after
+ * the maintained tail pointer, so no traversal is needed.
  *
- * Complexity: O(n)
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::push_back(const Key& k, const Info& i) {
+    emplace_back(k, i);
+}
+
+/**
+ * @brief Append a new element at the end of the list, moving the key and info in.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::push_back(Key&& k, Info&& i) {
+    emplace_back(std::move(k), std::move(i));
+}
+
+/**
+ * @brief Construct a new element in place at the end of the list.
+ * @param k Argument forwarded to the Key constructor.
+ * @param i Argument forwarded to the Info constructor.
+ *
+ * Complexity: O(1)
  */
-template <typename Key, typename Info>
-void Sequence<Key, Info>::push_back(const Key& k, const Info& i) {
-    Node* newNode = new Node(k, i);
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename K, typename I>
+void Sequence<Key, Info, Alloc, Stats>::emplace_back(K&& k, I&& i) {
+    Node* newNode = create_node(std::forward<K>(k), std::forward<I>(i));
     if (is_empty()) {
         head = newNode;
-        return;
-    }
-    Node* current = head;
-    while (current->next) {
-        current = current->next;
+    } else {
+        tail->next = newNode;
     }
-    current->next = newNode;
+    tail = newNode;
+    ++count;
 }
 
 /**
@@ -187,20 +463,26 @@ void Sequence<Key, Info>::push_back(const Key& k, const Info& i) {
  *
  * Complexity: O(n)
  */
-template <typename Key, typename Info>
-bool Sequence<Key, Info>::pop_back() {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+bool Sequence<Key, Info, Alloc, Stats>::pop_back() {
     if (is_empty()) return false;
+    forget_position();
     if (head->next == nullptr) {
-        delete head;
+        destroy_node(head);
         head = nullptr;
+        tail = nullptr;
+        count = 0;
         return true;
     }
     Node* current = head;
     while (current->next && current->next->next) {
         current = current->next;
     }
-    delete current->next;
+    counters.hops(count - 2);
+    destroy_node(current->next);
     current->next = nullptr;
+    tail = current;
+    --count;
     return true;
 }
 
@@ -210,24 +492,22 @@ bool Sequence<Key, Info>::pop_back() {
  *
  * Complexity: O(1)
  */
-template <typename Key, typename Info>
-bool Sequence<Key, Info>::is_empty() const {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+bool Sequence<Key, Info, Alloc, Stats>::is_empty() const {
     return head == nullptr;
 }
 
 /**
  * @brief Remove all elements from the list.
  *
- * All nodes are deleted and the list becomes empty.
+ * All nodes are destroyed and the list becomes empty. With an exclusively owned
+ * pool_allocator the pool memory is released in bulk.
  *
- * Complexity: O(n)
+ * Complexity: O(n), O(chunks) for trivially destructible Key/Info in an exclusive pool
  */
-template <typename Key, typename Info>
-void Sequence<Key, Info>::clear() {
-    while (!is_empty()) {
-        pop_front();
-    }
-    head = nullptr;
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::clear() {
+    release_nodes();
 }
 
 /**
@@ -238,8 +518,8 @@ void Sequence<Key, Info>::clear() {
  *
  * Complexity: O(n)
  */
-template <typename Key, typename Info>
-void Sequence<Key, Info>::print() const {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::print() const {
     Node* current = head;
     while (current) {
         std::cout << "(" << current->key << ", " << current->info << ") ";
@@ -257,8 +537,8 @@ void Sequence<Key, Info>::print() const {
  *
  * Complexity: O(n)
  */
-template <typename Key, typename Info>
-Sequence<Key, Info>& Sequence<Key, Info>::operator=(const Sequence& other) {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Sequence<Key, Info, Alloc, Stats>& Sequence<Key, Info, Alloc, Stats>::operator=(const Sequence& other) {
     if (this == &other) return *this;
     clear();
     Node* current = other.head;
@@ -269,6 +549,39 @@ Sequence<Key, Info>& Sequence<Key, Info>::operator=(const Sequence& other) {
     return *this;
 }
 
+/**
+ * @brief Move assignment. Takes over the nodes of `other`.
+ * @param other Sequence to move from; left empty.
+ * @return Reference to this Sequence.
+ *
+ * Nodes are adopted when the allocator propagates on move assignment or both allocators
+ * are equal; otherwise the elements are moved one by one into nodes of our allocator.
+ *
+ * Complexity: O(n) to release the current contents, O(1) for the transfer itself
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Sequence<Key, Info, Alloc, Stats>& Sequence<Key, Info, Alloc, Stats>::operator=(Sequence&& other) {
+    if (this == &other) return *this;
+    release_nodes();
+    bool propagate = node_traits::propagate_on_container_move_assignment::value;
+    if (propagate || alloc == other.alloc) {
+        if (propagate) alloc = other.alloc;
+        head = other.head;
+        tail = other.tail;
+        count = other.count;
+        other.head = nullptr;
+        other.tail = nullptr;
+        other.count = 0;
+        other.forget_position();
+    } else {
+        for (Node* current = other.head; current; current = current->next) {
+            push_back(std::move(current->key), std::move(current->info));
+        }
+        other.clear();
+    }
+    return *this;
+}
+
 /**
  * @brief Insert a new element at the specified zero-based position.
  * @param k Key for the new element.
@@ -281,31 +594,23 @@ Sequence<Key, Info>& Sequence<Key, Info>::operator=(const Sequence& other) {
  * If the list has fewer elements than position, the function returns false and no node
  * is inserted.
  *
- * Complexity: O(n)
+ * Complexity: O(n), O(1) amortized for non-decreasing positions (see the position cache)
  */
-template <typename Key, typename Info>
-bool Sequence<Key, Info>::insert_at(const Key& k, const Info& i, int position)
+template <typename Key, typename Info, typename Alloc, typename Stats>
+bool Sequence<Key, Info, Alloc, Stats>::insert_at(const Key& k, const Info& i, int position)
 {
     if (position < 0) return false;
     if (position == 0) {
         push_front(k, i);
         return true;
     }
-    Node* newNode = new Node(k, i);
-    Node* current = head;
-    for (int idx = 0; idx < position - 1; ++idx) {
-        if (!current) { // position is out of bounds
-            delete newNode;
-            return false;
-        }
-        current = current->next;
-    }
-    if (!current) { // position is out of bounds
-        delete newNode;
-        return false;
-    }
+    Node* current = node_at(position - 1);
+    if (!current) return false; // position is out of bounds
+    Node* newNode = create_node(k, i);
     newNode->next = current->next;
     current->next = newNode;
+    if (tail == current) tail = newNode;
+    ++count;
     return true;
 }
 
@@ -316,24 +621,22 @@ bool Sequence<Key, Info>::insert_at(const Key& k, const Info& i, int position)
  *
  * position == 0 removes the head element.
  *
- * Complexity: O(n)
+ * Complexity: O(n), O(1) amortized for non-decreasing positions (see the position cache)
  */
-template <typename Key, typename Info>
-bool Sequence<Key, Info>::remove_at(int position) {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+bool Sequence<Key, Info, Alloc, Stats>::remove_at(int position) {
     if (position < 0 || is_empty()) return false;
     if (position == 0) {
         pop_front();
         return true;
     }
-    Node* current = head;
-    for (int idx = 0; idx < position - 1; ++idx) {
-        if (!current->next) return false;
-        current = current->next;
-    }
-    if (!current->next) return false;
+    Node* current = node_at(position - 1);
+    if (!current || !current->next) return false;
     Node* temp = current->next;
     current->next = temp->next;
-    delete temp;
+    if (tail == temp) tail = current;
+    destroy_node(temp);
+    --count;
     return true;
 }
 
@@ -341,18 +644,12 @@ bool Sequence<Key, Info>::remove_at(int position) {
  * @brief Compute the number of elements in the list.
  * @return The number of nodes currently stored in the sequence.
  *
- * This implementation traverses the entire list.
+ * The counter is maintained by every mutating method, so no traversal is needed.
  *
- * Complexity: O(n)
+ * Complexity: O(1)
  */
-template <typename Key, typename Info>
-unsigned int Sequence<Key, Info>::size() const {
-    int count = 0;
-    Node* current = head;
-    while (current) {
-        ++count;
-        current = current->next;
-    }
+template <typename Key, typename Info, typename Alloc, typename Stats>
+unsigned int Sequence<Key, Info, Alloc, Stats>::size() const {
     return count;
 }
 
@@ -362,16 +659,11 @@ unsigned int Sequence<Key, Info>::size() const {
  * @return A copy of the key at that position.
  * @throws std::out_of_range if position < 0 or position >= size().
  *
- * Complexity: O(n)
+ * Complexity: O(n), O(1) amortized for non-decreasing positions (see the position cache)
  */
-template <typename Key, typename Info>
-Key Sequence<Key, Info>::get_key_at(int position) const {
-    if (position < 0) throw std::out_of_range("Position out of range");
-    Node* current = head;
-    for (int idx = 0; idx < position; ++idx) {
-        if (!current) throw std::out_of_range("Position out of range");
-        current = current->next;
-    }
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Key Sequence<Key, Info, Alloc, Stats>::get_key_at(int position) const {
+    Node* current = node_at(position);
     if (!current) throw std::out_of_range("Position out of range");
     return current->key;
 }
@@ -382,16 +674,11 @@ Key Sequence<Key, Info>::get_key_at(int position) const {
  * @return A copy of the info at that position.
  * @throws std::out_of_range if position < 0 or position >= size().
  *
- * Complexity: O(n)
+ * Complexity: O(n), O(1) amortized for non-decreasing positions (see the position cache)
  */
-template <typename Key, typename Info>
-Info Sequence<Key, Info>::get_info_at(int position) const {
-    if (position < 0) throw std::out_of_range("Position out of range");
-    Node* current = head;
-    for (int idx = 0; idx < position; ++idx) {
-        if (!current) throw std::out_of_range("Position out of range");
-        current = current->next;
-    }
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Info Sequence<Key, Info, Alloc, Stats>::get_info_at(int position) const {
+    Node* current = node_at(position);
     if (!current) throw std::out_of_range("Position out of range");
     return current->info;
 }
@@ -403,11 +690,12 @@ Info Sequence<Key, Info>::get_info_at(int position) const {
  *
  * Complexity: O(n), Additional memory: O(1)
  */
-template <typename Key, typename Info>
-void Sequence<Key, Info>::reverse() {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::reverse() {
     Node* prev = nullptr;
     Node* current = head;
     Node* next = nullptr;
+    tail = head;
     while (current) {
         next = current->next;
         current->next = prev;
@@ -415,6 +703,7 @@ void Sequence<Key, Info>::reverse() {
         current = next;
     }
     head = prev;
+    forget_position();
 }
 
 /**
@@ -430,21 +719,25 @@ void Sequence<Key, Info>::reverse() {
  *
  * Complexity: O(n)
  */
-template <typename Key, typename Info>
-void Sequence<Key, Info>::update_info(const Key& k, const Info& new_info, int occurrence) {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::update_info(const Key& k, const Info& new_info, int occurrence) {
     if (occurrence <= 0) throw std::invalid_argument("Occurrence must be positive");
     Node* current = head;
     int count = 0;
+    unsigned int hops = 0;
     while (current) {
         if (current->key == k) {
             count++;
             if (count == occurrence) {
                 current->info = new_info;
+                counters.hops(hops);
                 return;
             }
         }
         current = current->next;
+        ++hops;
     }
+    counters.hops(hops);
 }
 
 /**
@@ -459,18 +752,15 @@ void Sequence<Key, Info>::update_info(const Key& k, const Info& new_info, int oc
  *
  * Complexity: O(n)
  */
-template <typename Key, typename Info>
-void Sequence<Key, Info>::subsequence(int start_pos, int length, Sequence<Key, Info>& subseq) const {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::subsequence(int start_pos, int length, Sequence& subseq) const {
     if (start_pos < 0 || length < 0) {
         throw std::out_of_range("Invalid start position or length");
     }
-    Node* current = head;
-    for (int idx = 0; idx < start_pos; ++idx) {
-        if (!current) {
-            throw std::out_of_range("Start position out of range");
-        }
-        current = current->next;
+    if (static_cast<unsigned int>(start_pos) > count) {
+        throw std::out_of_range("Start position out of range");
     }
+    Node* current = node_at(start_pos); // nullptr when start_pos == size()
     for (int len = 0; len < length; ++len) {
         if (!current) {
             throw std::out_of_range("Length exceeds list bounds");
@@ -487,16 +777,11 @@ void Sequence<Key, Info>::subsequence(int start_pos, int length, Sequence<Key, I
  * @param new_info New info to assign.
  * @throws std::out_of_range if position < 0 or position >= size().
  *
- * Complexity: O(n)
+ * Complexity: O(n), O(1) amortized for non-decreasing positions (see the position cache)
  */
-template <typename Key, typename Info>
-void Sequence<Key, Info>::replace_at(int position, const Key& new_key, const Info& new_info) {
-    if (position < 0) throw std::out_of_range("Position out of range");
-    Node* current = head;
-    for (int idx = 0; idx < position; ++idx) {
-        if (!current) throw std::out_of_range("Position out of range");
-        current = current->next;
-    }
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::replace_at(int position, const Key& new_key, const Info& new_info) {
+    Node* current = node_at(position);
     if (!current) throw std::out_of_range("Position out of range");
     current->key = new_key;
     current->info = new_info;
@@ -515,8 +800,8 @@ void Sequence<Key, Info>::replace_at(int position, const Key& new_key, const Inf
  *
  * Complexity: O(n)
  */
-template <typename Key, typename Info>
-int Sequence<Key, Info>::find_key_occurrence(const Key& k, int occurrence) const {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+int Sequence<Key, Info, Alloc, Stats>::find_key_occurrence(const Key& k, int occurrence) const {
     if (occurrence <= 0) throw std::invalid_argument("Occurrence must be positive");
     Node* current = head;
     int count = 0;
@@ -525,11 +810,297 @@ int Sequence<Key, Info>::find_key_occurrence(const Key& k, int occurrence) const
         if (current->key == k) {
             count++;
             if (count == occurrence) {
+                counters.hops(index);
                 return index;
             }
         }
         current = current->next;
         index++;
     }
+    counters.hops(index);
     return -1; // Not found
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Return a copy of the allocator used by this sequence.
+ *
+ * Pass it to the constructor of another Sequence to make both share one node pool.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::allocator_type Sequence<Key, Info, Alloc, Stats>::get_allocator() const {
+    return allocator_type(alloc);
+}
+
+/**
+ * @brief Snapshot of the counters kept by the Stats policy (all zeros for no_stats).
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+container_stats Sequence<Key, Info, Alloc, Stats>::stats() const {
+    return counters.snapshot();
+}
+
+/**
+ * @brief Zero the counters kept by the Stats policy.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::reset_stats() {
+    counters.reset();
+}
+
+/**
+ * @brief Link an already allocated node at the end of the list.
+ * @param n Node to append. Its next pointer is reset; ownership passes to this sequence.
+ *
+ * Used by the split engine to move nodes between sequences without copying Key/Info.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::append_node(Node* n) {
+    n->next = nullptr;
+    if (is_empty()) {
+        head = n;
+    } else {
+        tail->next = n;
+    }
+    tail = n;
+    ++count;
+}
+
+/**
+ * @brief Move alternating blocks of nodes following `prev` to seq1 and seq2.
+ * @param prev   Node after which splitting starts, or nullptr to start at the head.
+ * @param len1   Maximum number of nodes moved to seq1 in each round.
+ * @param len2   Maximum number of nodes moved to seq2 in each round.
+ * @param rounds Number of (len1, len2) rounds to perform.
+ * @param seq1   Receives the first block of each round (appended).
+ * @param seq2   Receives the second block of each round (appended).
+ *
+ * Nodes are unlinked from this sequence and relinked onto the outputs in a single pass;
+ * no node is allocated or freed and no Key/Info is copied. Stops early when the list
+ * is exhausted. An output whose allocator differs from ours (e.g. a separate pool)
+ * cannot adopt our nodes, so its elements are moved into its own nodes instead.
+ *
+ * Complexity: O(moved nodes)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::split_after(Node* prev, int len1, int len2, int rounds, Sequence& seq1, Sequence& seq2) {
+    bool relink1 = seq1.alloc == alloc;
+    bool relink2 = seq2.alloc == alloc;
+    Node* current = prev ? prev->next : head;
+    unsigned int moved = 0;
+    auto transfer = [&](Sequence& dst, bool relink) {
+        Node* n = current;
+        if (relink) {
+            current = current->next;
+            dst.append_node(n);
+        } else {
+            // may throw; current is still linked here
+            dst.emplace_back(std::move_if_noexcept(n->key), std::move_if_noexcept(n->info));
+            current = current->next;
+            destroy_node(n);
+        }
+        ++moved;
+    };
+    try {
+        while (current && rounds > 0) {
+            for (int i = 0; i < len1 && current; i++) {
+                transfer(seq1, relink1);
+            }
+            for (int j = 0; j < len2 && current; j++) {
+                transfer(seq2, relink2);
+            }
+            rounds--;
+        }
+    } catch (...) {
+        forget_position();
+        if (prev) prev->next = current; else head = current;
+        if (!current) tail = prev;
+        count -= moved;
+        throw;
+    }
+    if (prev) {
+        prev->next = current;
+    } else {
+        head = current;
+    }
+    if (!current) tail = prev;
+    count -= moved;
+    forget_position();
+}
+
+/**
+ * @brief Find the node at a zero-based position, starting from the remembered position
+ *        when it is not past the requested one.
+ * @return The node, or nullptr if position < 0 or position >= size().
+ *
+ * The found node becomes the remembered position.
+ *
+ * Complexity: O(position), O(position - last position) when walking on
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::Node* Sequence<Key, Info, Alloc, Stats>::node_at(int position) const {
+    if (position < 0 || static_cast<unsigned int>(position) >= count) return nullptr;
+    Node* current = head;
+    int idx = 0;
+    if (static_cast<unsigned int>(position) == count - 1) {
+        current = tail;
+        idx = position;
+    } else if (last_node && last_pos <= position) {
+        current = last_node;
+        idx = last_pos;
+    }
+    counters.hops(position - idx);
+    for (; idx < position; ++idx) {
+        current = current->next;
+    }
+    last_node = current;
+    last_pos = position;
+    return current;
+}
+
+/**
+ * @brief Drop the remembered position; called when nodes before it move or disappear.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void Sequence<Key, Info, Alloc, Stats>::forget_position() const {
+    last_node = nullptr;
+    last_pos = -1;
+}
+
+/**
+ * @brief Cursor in front of the first element, for insert_after / erase_after at the head.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::cursor Sequence<Key, Info, Alloc, Stats>::before_begin() {
+    return cursor(this, nullptr, true);
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::const_cursor Sequence<Key, Info, Alloc, Stats>::before_begin() const {
+    return const_cursor(this, nullptr, true);
+}
+
+/**
+ * @brief Cursor at the first element (equal to end() for an empty sequence).
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::cursor Sequence<Key, Info, Alloc, Stats>::begin() {
+    return cursor(this, head, false);
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::const_cursor Sequence<Key, Info, Alloc, Stats>::begin() const {
+    return const_cursor(this, head, false);
+}
+
+/**
+ * @brief Cursor past the last element.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::cursor Sequence<Key, Info, Alloc, Stats>::end() {
+    return cursor(this, nullptr, false);
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::const_cursor Sequence<Key, Info, Alloc, Stats>::end() const {
+    return const_cursor(this, nullptr, false);
+}
+
+/**
+ * @brief Cursor at a zero-based position; -1 gives before_begin().
+ * @throws std::out_of_range if position < -1 or position >= size().
+ *
+ * Complexity: O(n), O(1) amortized for non-decreasing positions (see the position cache)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::cursor Sequence<Key, Info, Alloc, Stats>::cursor_at(int position) {
+    if (position == -1) return before_begin();
+    Node* n = node_at(position);
+    if (!n) throw std::out_of_range("Position out of range");
+    return cursor(this, n, false);
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::const_cursor Sequence<Key, Info, Alloc, Stats>::cursor_at(int position) const {
+    if (position == -1) return before_begin();
+    Node* n = node_at(position);
+    if (!n) throw std::out_of_range("Position out of range");
+    return const_cursor(this, n, false);
+}
+
+/**
+ * @brief Insert a new element right after `pos`.
+ * @param pos Cursor of this sequence; before_begin() inserts at the front.
+ * @return Cursor at the new element.
+ * @throws std::out_of_range if pos is end().
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::cursor Sequence<Key, Info, Alloc, Stats>::insert_after(cursor pos, const Key& k, const Info& i) {
+    return emplace_after(pos, k, i);
+}
+
+/**
+ * @brief Construct a new element in place right after `pos`.
+ * @return Cursor at the new element.
+ * @throws std::out_of_range if pos is end().
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename K, typename I>
+typename Sequence<Key, Info, Alloc, Stats>::cursor Sequence<Key, Info, Alloc, Stats>::emplace_after(cursor pos, K&& k, I&& i) {
+    if (pos.before) {
+        emplace_front(std::forward<K>(k), std::forward<I>(i));
+        return begin();
+    }
+    if (!pos.node) throw std::out_of_range("Cursor is at the end");
+    Node* newNode = create_node(std::forward<K>(k), std::forward<I>(i));
+    newNode->next = pos.node->next;
+    pos.node->next = newNode;
+    if (tail == pos.node) tail = newNode;
+    ++count;
+    forget_position();
+    return cursor(this, newNode, false);
+}
+
+/**
+ * @brief Remove the element right after `pos`.
+ * @param pos Cursor of this sequence; before_begin() removes the first element.
+ * @return Cursor at the element that followed the removed one (end() if none).
+ * @throws std::out_of_range if there is no element after pos.
+ *
+ * Complexity: O(1)
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename Sequence<Key, Info, Alloc, Stats>::cursor Sequence<Key, Info, Alloc, Stats>::erase_after(cursor pos) {
+    if (pos.before) {
+        if (is_empty()) throw std::out_of_range("No element after cursor");
+        pop_front();
+        return begin();
+    }
+    if (!pos.node || !pos.node->next) throw std::out_of_range("No element after cursor");
+    Node* temp = pos.node->next;
+    pos.node->next = temp->next;
+    if (tail == temp) tail = pos.node;
+    destroy_node(temp);
+    --count;
+    forget_position();
+    return cursor(this, pos.node->next, false);
+}
@@ -1,3 +1,6 @@
+#include <cstddef>
+#include <utility>
+#include <vector>
 #include "sequence.hpp"
 /**
  * @brief Splits a sequence into two output sequences by alternating blocks of elements,
@@ -31,6 +34,7 @@
  * @param seq2      Output sequence receiving the second block of each alternation (append-only).
  *
  * @throws std::invalid_argument if start_occ < 0, len1 < 0, len2 < 0, count < 0, or count > seq.size().
+ * @throws std::invalid_argument if seq1 or seq2 is the same object as seq.
  * @throws std::invalid_argument if a positive start_occ is provided but the requested occurrence
  *                              of start_key cannot be found in seq.
  *
@@ -40,29 +44,27 @@
  *   elements shift left; this function relies on that shifting behavior and always reads
  *   from the current index.
  * - The function has no return value; resulting partitions are visible in seq1, seq2, and seq.
+ * - Nodes are relinked, not copied: the split runs in a single pass over the list,
+ *   O(start_pos + moved elements), and Key/Info values are never copied or reallocated.
+ *   This requires seq1/seq2 to share seq's allocator (always true for std::allocator; for a
+ *   pool_allocator construct them from seq.get_allocator()), otherwise elements are moved into new nodes.
  */
-template <typename Key, typename Info>
-void split_pos(Sequence <Key, Info>& seq, int start_pos, int len1, int len2, int count, Sequence <Key, Info>& seq1, Sequence <Key, Info>& seq2) {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void split_pos(Sequence <Key, Info, Alloc, Stats>& seq, int start_pos, int len1, int len2, int count, Sequence <Key, Info, Alloc, Stats>& seq1, Sequence <Key, Info, Alloc, Stats>& seq2) {
 
     if (start_pos < 0 || start_pos > seq.size() || len1 < 0 || len2 < 0 || count < 0 || count > seq.size()) {
         throw std::invalid_argument("Invalid argument");
     }
+    if (&seq1 == &seq || &seq2 == &seq) {
+        throw std::invalid_argument("Output sequence aliases the source");
+    }
 
-    int currentPos = start_pos;
-
-    while(start_pos < seq.size() && count > 0){
-        for(int i=0; i<len1 && start_pos < seq.size(); i++){
-            seq1.push_back(seq.get_key_at(start_pos), seq.get_info_at(start_pos));
-            //std::cout<< "Added to seq1: " << seq.get_key_at(start_pos) << ", " << seq.get_info_at(start_pos) << std::endl;
-            seq.remove_at(start_pos);
-        }
-        for(int j=0; j<len2 && start_pos < seq.size(); j++){
-            seq2.push_back(seq.get_key_at(start_pos), seq.get_info_at(start_pos));
-            //std::cout<< "Added to seq2: " << seq.get_key_at(start_pos) << ", " << seq.get_info_at(start_pos) << std::endl;
-            seq.remove_at(start_pos);
-        }
-        count--;
+    // walk once to the node preceding start_pos, then relink everything after it
+    typename Sequence<Key, Info, Alloc, Stats>::Node* prev = nullptr;
+    for (int i = 0; i < start_pos; i++) {
+        prev = prev ? prev->next : seq.head;
     }
+    seq.split_after(prev, len1, len2, count, seq1, seq2);
 }
 
 /**
@@ -93,15 +95,13 @@ void split_pos(Sequence <Key, Info>& seq, int start_pos, int len1, int len2, int
  * @throws std::invalid_argument if:
  *         - any of `start_occ`, `len1`, `len2`, or `count` is negative,
  *         - `count` exceeds the size of `seq`,
- *         - the `start_key` is not found `start_occ` times in the sequence.
+ *         - `seq1` or `seq2` is the same object as `seq`,
+ *         - the `start_key` is not found `start_occ` times in the (non-empty) sequence.
  *
  * @note 
- *  - This function assumes that the `Sequence` class provides the following methods:
- *      - `size()` — returns the number of elements,
- *      - `get_key_at(i)` and `get_info_at(i)` — return the key and value at index `i`,
- *      - `push_back(key, info)` — appends a new element to the sequence,
- *      - `remove_at(i)` — removes the element at index `i`.
- *  - Removing elements shifts subsequent indices, so care is taken to handle indexing correctly.
+ *  - The occurrence search and the split share one pass over the list: the node preceding
+ *    the start occurrence is remembered and the following nodes are relinked onto `seq1`
+ *    and `seq2` without copying Key/Info. Complexity: O(start position + moved elements).
  *
  * @example
  * Sequence<char, int> seq, seq1, seq2;
@@ -110,40 +110,221 @@ void split_pos(Sequence <Key, Info>& seq, int start_pos, int len1, int len2, int
  * // seq1 and seq2 now contain alternating chunks taken from seq.
  */
 
-template <typename Key, typename Info>
-void split_key(Sequence <Key, Info>& seq, const Key& start_key, int start_occ, int len1, int len2, int count, Sequence <Key, Info>& seq1, Sequence <Key, Info>& seq2) {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void split_key(Sequence <Key, Info, Alloc, Stats>& seq, const Key& start_key, int start_occ, int len1, int len2, int count, Sequence <Key, Info, Alloc, Stats>& seq1, Sequence <Key, Info, Alloc, Stats>& seq2) {
 
     if (start_occ < 0 || len1 < 0 || len2 < 0 || count < 0 || count > seq.size()) {
         throw std::invalid_argument("Invalid argument");
     }
-        int currentPos = 0;
-
-    while(start_occ > 0 && seq.size() > 0){
-        for(int i=0; i<seq.size(); i++){
-            if(seq.get_key_at(i) == start_key){
-                start_occ--;
-                if(start_occ == 0){
-                    currentPos = i;
-                    break;
-                }
-            }
+    if (&seq1 == &seq || &seq2 == &seq) {
+        throw std::invalid_argument("Output sequence aliases the source");
+    }
+
+    typedef typename Sequence<Key, Info, Alloc, Stats>::Node Node;
+    Node* prev = nullptr; // node preceding the start occurrence, nullptr = head
+
+    if (start_occ > 0 && !seq.is_empty()) {
+        Node* current = seq.head;
+        while (current) {
+            if (current->key == start_key && --start_occ == 0) break;
+            prev = current;
+            current = current->next;
+        }
+        if (start_occ > 0) {
+            throw std::invalid_argument("Key occurrence not found");
+        }
+    }
+
+    seq.split_after(prev, len1, len2, count, seq1, seq2);
+}
+/**
+ * @brief Sink that drops the records it is given; the default for the records a
+ *        key_split_stream does not route to seq1/seq2.
+ */
+struct discard_records {
+    template <typename Batch>
+    void operator()(Batch&) const {}
+};
+
+/**
+ * @brief Sink appending every record of a batch to a Sequence (the records are moved).
+ */
+template <typename Key, typename Info, typename Alloc, typename Stats>
+struct sequence_sink {
+    Sequence<Key, Info, Alloc, Stats>* seq;
+    void operator()(std::vector<std::pair<Key, Info>>& batch) const {
+        for (auto& record : batch) seq->emplace_back(std::move(record.first), std::move(record.second));
+    }
+};
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+sequence_sink<Key, Info, Alloc, Stats> append_to(Sequence<Key, Info, Alloc, Stats>& seq) {
+    return sequence_sink<Key, Info, Alloc, Stats>{&seq};
+}
+
+/**
+ * @class key_split_stream
+ * @brief split_key over a stream of (key, info) records: the records are routed as they
+ *        arrive and the source is never held anywhere.
+ *
+ * Records are passed in with push() or feed(). The stream counts occurrences of start_key
+ * until the start_occ-th one (from the first record when start_occ == 0), then routes up to
+ * count rounds of len1 records to sink1 and len2 records to sink2, exactly where split_key
+ * would move them. Every other record (before the start, after the last round) is what
+ * split_key would leave in seq and goes to the optional rest sink.
+ *
+ * A sink is a callable taking std::vector<std::pair<Key, Info>>& with up to `batch`
+ * records, which it may move from; append_to(seq) appends them to a Sequence. Each sink
+ * has one buffer of at most `batch` records, so memory stays bounded however long the
+ * stream is. A buffer is emptied only after its sink returned: when a sink throws, its
+ * records stay buffered and flush() hands them over again.
+ *
+ *     auto s = make_key_split_stream<int, std::string>(7, 2, 3, 1, 100, append_to(seq1), append_to(seq2));
+ *     while (source.next(key, info)) s.push(key, info);
+ *     s.finish();
+ *
+ * Errors: negative start_occ, len1, len2 or count throw std::invalid_argument from the
+ * constructor. The checks split_key makes against the whole sequence (count > size, the
+ * occurrence not found in a non-empty sequence) can only be made at the end and are thrown
+ * by finish(), with the same messages; split_key would have left seq unchanged, whereas
+ * the records routed by then have been delivered already.
+ *
+ * Complexity: O(1) per record plus the sinks' work.
+ */
+template <typename Key, typename Info, typename Sink1, typename Sink2, typename Rest = discard_records>
+class key_split_stream {
+public:
+    typedef std::pair<Key, Info> record;
+    typedef std::vector<record> batch_type;
+
+    key_split_stream(const Key& start_key, int start_occ, int len1, int len2, int count,
+                     Sink1 sink1, Sink2 sink2, Rest rest = Rest(), std::size_t batch = 256)
+        : start_key(start_key), occ_left(start_occ), len1(len1), len2(len2), count(count),
+          rounds_left(len1 + len2 > 0 ? count : 0), pos(0), seen(0), batch_size(batch ? batch : 1),
+          sink1(std::move(sink1)), sink2(std::move(sink2)), rest(std::move(rest)) {
+        if (start_occ < 0 || len1 < 0 || len2 < 0 || count < 0) {
+            throw std::invalid_argument("Invalid argument");
+        }
+    }
+
+    void push(const Key& key, const Info& info) { route(record(key, info)); }
+    void push(Key&& key, Info&& info) { route(record(std::move(key), std::move(info))); }
+
+    /**
+     * @brief Pushes every record of [first, last), pair-like (key, info) values.
+     */
+    template <typename It>
+    void feed(It first, It last) {
+        for (; first != last; ++first) route(record((*first).first, (*first).second));
+    }
+
+    // hands every buffered record to its sink
+    void flush() {
+        deliver(out1, sink1);
+        deliver(out2, sink2);
+        deliver(out_rest, rest);
+    }
+
+    /**
+     * @brief Flushes, then makes the checks split_key makes against the whole sequence.
+     * @throws std::invalid_argument if count exceeded the number of records, or a positive
+     *         start_occ was not reached in a non-empty stream.
+     */
+    void finish() {
+        flush();
+        if (static_cast<unsigned long long>(count) > seen) {
+            throw std::invalid_argument("Invalid argument");
         }
-        if(start_occ > 0){
+        if (occ_left > 0 && seen > 0) {
             throw std::invalid_argument("Key occurrence not found");
         }
     }
 
-    while(currentPos < seq.size() && count > 0){
-        for(int i=0; i<len1 && currentPos < seq.size(); i++){
-            seq1.push_back(seq.get_key_at(currentPos), seq.get_info_at(currentPos));
-            //std::cout<< "Added to seq1: " << seq.get_key_at(currentPos) << ", " << seq.get_info_at(currentPos) << std::endl;
-            seq.remove_at(currentPos);
+    // true once the start occurrence was seen and every round is complete
+    bool done() const { return occ_left == 0 && rounds_left == 0; }
+
+    // records pushed so far
+    unsigned long long size() const { return seen; }
+
+private:
+    Key start_key;
+    int occ_left;    // occurrences of start_key still to see before routing starts
+    int len1, len2, count;
+    int rounds_left;
+    int pos;         // position within the current round, [0, len1 + len2)
+    unsigned long long seen;
+    std::size_t batch_size;
+    Sink1 sink1;
+    Sink2 sink2;
+    Rest rest;
+    batch_type out1, out2, out_rest;
+
+    template <typename Sink>
+    void deliver(batch_type& out, Sink& sink) {
+        if (out.empty()) return;
+        sink(out);
+        out.clear();
+    }
+
+    template <typename Sink>
+    void append(batch_type& out, Sink& sink, record&& r) {
+        out.push_back(std::move(r));
+        if (out.size() >= batch_size) deliver(out, sink);
+    }
+
+    void route(record&& r) {
+        ++seen;
+        // the start_occ-th occurrence itself is the first record routed
+        if (occ_left > 0 && (!(r.first == start_key) || --occ_left > 0)) {
+            to_rest(std::move(r));
+            return;
         }
-        for(int j=0; j<len2 && currentPos < seq.size(); j++){
-            seq2.push_back(seq.get_key_at(currentPos), seq.get_info_at(currentPos));
-            //std::cout<< "Added to seq2: " << seq.get_key_at(currentPos) << ", " << seq.get_info_at(currentPos) << std::endl;
-            seq.remove_at(currentPos);
+        if (rounds_left == 0) {
+            to_rest(std::move(r));
+            return;
         }
-        count--;
+        if (pos < len1) append(out1, sink1, std::move(r));
+        else append(out2, sink2, std::move(r));
+        if (++pos == len1 + len2) {
+            pos = 0;
+            --rounds_left;
+        }
+    }
+
+    void to_rest(record&& r) {
+        if (!std::is_same<Rest, discard_records>::value) append(out_rest, rest, std::move(r));
     }
-}
\ No newline at end of file
+};
+
+/**
+ * @brief Makes a key_split_stream with the sink types deduced.
+ */
+template <typename Key, typename Info, typename Sink1, typename Sink2>
+key_split_stream<Key, Info, Sink1, Sink2> make_key_split_stream(const Key& start_key, int start_occ, int len1, int len2,
+                                                                int count, Sink1 sink1, Sink2 sink2) {
+    return key_split_stream<Key, Info, Sink1, Sink2>(start_key, start_occ, len1, len2, count, sink1, sink2);
+}
+
+template <typename Key, typename Info, typename Sink1, typename Sink2, typename Rest>
+key_split_stream<Key, Info, Sink1, Sink2, Rest> make_key_split_stream(const Key& start_key, int start_occ, int len1, int len2,
+                                                                      int count, Sink1 sink1, Sink2 sink2, Rest rest,
+                                                                      std::size_t batch = 256) {
+    return key_split_stream<Key, Info, Sink1, Sink2, Rest>(start_key, start_occ, len1, len2, count, sink1, sink2, rest, batch);
+}
+
+/**
+ * @brief split_key reading the source from an input range of (key, info) records.
+ *
+ * seq1 and seq2 receive what split_key(seq, start_key, ...) would append to them for a seq
+ * holding the records of [first, last); the range is read once, in batches, and no Sequence
+ * of the source is built.
+ *
+ * @throws std::invalid_argument as split_key does (see key_split_stream for when).
+ */
+template <typename It, typename Key, typename Info, typename Alloc, typename Stats>
+void split_key_range(It first, It last, const Key& start_key, int start_occ, int len1, int len2, int count,
+                     Sequence<Key, Info, Alloc, Stats>& seq1, Sequence<Key, Info, Alloc, Stats>& seq2) {
+    auto stream = make_key_split_stream<Key, Info>(start_key, start_occ, len1, len2, count, append_to(seq1), append_to(seq2));
+    stream.feed(first, last);
+    stream.finish();
+}
@@ -1,9 +1,115 @@
 #pragma once 
 #include <iostream>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <numeric>
+#include <cstddef>
+#include <stdexcept>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include "../common/container_stats.hpp"
+#include "../common/node_pool.hpp"
 
 using namespace std;
 
-template <typename Key, typename Info>
+// Key index policies for bi_ring. The ring reports every node it links or unlinks to
+// Index::index<Key, Node>; find() and is_key_in_ring() use it when `enabled` is true.
+
+// no index: lookups scan the ring (default)
+struct no_key_index {
+    template <typename Key, typename Node>
+    struct index {
+        static const bool enabled = false;
+        void insert(const Key&, Node*) {}
+        void erase(const Key&, Node*) {}
+        void clear() {}
+        Node* find(const Key&) const { return nullptr; }
+    };
+};
+
+// hash index key -> nodes, O(1) average find() and is_key_in_ring(); with repeated keys
+// find() returns one of the matching nodes (not necessarily the first one after any)
+struct hashed_key_index {
+    template <typename Key, typename Node>
+    struct index {
+        static const bool enabled = true;
+        std::unordered_multimap<Key, Node*> nodes;
+
+        void insert(const Key& key, Node* n) {
+            nodes.emplace(key, n);
+        }
+        void erase(const Key& key, Node* n) {
+            auto range = nodes.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == n) {
+                    nodes.erase(it);
+                    return;
+                }
+            }
+        }
+        void clear() {
+            nodes.clear();
+        }
+        Node* find(const Key& key) const {
+            auto it = nodes.find(key);
+            return it == nodes.end() ? nullptr : it->second;
+        }
+    };
+};
+
+// Iterator checking policies for bi_ring. Every mutation of a ring bumps its version.
+// checked_iterators: an iterator remembers the version it was made at and which ring's
+// counter to compare with; insert/emplace/erase and ++/-- throw std::runtime_error for an
+// iterator that is out of date or belongs to another ring. unchecked_iterators: an iterator
+// is a single node pointer and nothing is checked. The default is checked unless NDEBUG is
+// defined, so release builds get plain pointers.
+
+struct checked_iterators {
+    static const bool enabled = true;
+    class stamp {
+        private:
+            int version;
+            const int* counter;
+        protected:
+            explicit stamp(const int* c) : version(*c), counter(c) {}
+            void check() const { check(counter); }
+            // also rejects an iterator of another ring
+            void check(const int* c) const {
+                if (c != counter || version != *c) throw runtime_error("Iterator version mismatch");
+            }
+    };
+};
+
+struct unchecked_iterators {
+    static const bool enabled = false;
+    class stamp {
+        protected:
+            explicit stamp(const int*) {}
+            void check() const {}
+            void check(const int*) const {}
+    };
+};
+
+#ifdef NDEBUG
+typedef unchecked_iterators default_iterator_check;
+#else
+typedef checked_iterators default_iterator_check;
+#endif
+
+// Alloc is rebound to the internal node type; pool_allocator (common/node_pool.hpp) serves
+// nodes from a slab/free-list pool and lets clear() and the destructor release them in bulk.
+// Index is a key index policy (see above); indexed_bi_ring selects hashed_key_index.
+// Stats is a counter policy from common/container_stats.hpp: no_stats (default) costs
+// nothing, atomic_stats counts node allocations, frees and version bumps for stats().
+// Check is an iterator checking policy (see above).
+template <typename Key, typename Info, typename Alloc = std::allocator<std::pair<const Key, Info>>,
+          typename Index = no_key_index, typename Stats = no_stats, typename Check = default_iterator_check>
 class bi_ring {
     private:
         struct Node {
@@ -13,118 +119,218 @@ class bi_ring {
             Node* prev;
 
             //Node(const Key& value) : key(value), next(nullptr), prev(nullptr) {}
-            Node(const Key& k, const Info& i) : key(k), info(i), next(this), prev(this) {}
+            template <typename K, typename I>
+            Node(K&& k, I&& i) : key(std::forward<K>(k)), info(std::forward<I>(i)), next(this), prev(this) {}
         };
+        typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node> node_allocator;
+        typedef std::allocator_traits<node_allocator> node_traits;
+        typedef typename Index::template index<Key, Node> key_index;
+        // keys of an indexed ring must not change behind the index's back
+        typedef typename std::conditional<key_index::enabled, const Key&, Key&>::type key_reference;
+
         int version;
         Node* any;
+        node_allocator alloc;
+        key_index index;
+        Stats counters;
+
+        template <typename K, typename I>
+        Node* create_node(K&& key, I&& info) {
+            Node* n = node_traits::allocate(alloc, 1);
+            try {
+                node_traits::construct(alloc, n, std::forward<K>(key), std::forward<I>(info));
+            } catch (...) {
+                node_traits::deallocate(alloc, n, 1);
+                throw;
+            }
+            try {
+                index.insert(n->key, n);
+            } catch (...) {
+                node_traits::destroy(alloc, n);
+                node_traits::deallocate(alloc, n, 1);
+                throw;
+            }
+            counters.allocation();
+            return n;
+        }
+
+        void destroy_node(Node* n) {
+            index.erase(n->key, n);
+            node_traits::destroy(alloc, n);
+            node_traits::deallocate(alloc, n, 1);
+            counters.frees(1);
+        }
+
+        // invalidates the iterators handed out so far
+        void bump_version() {
+            version++;
+            counters.version_bump();
+        }
+
+        // frees every node; an exclusively owned pool is handed back in bulk
+        void release_nodes() {
+            if (!any) return;
+            index.clear();
+            if (pool_can_release(alloc)) {
+                // the walk is skipped for trivially destructible nodes unless it is being counted
+                if (!std::is_trivially_destructible<Node>::value || Stats::enabled) {
+                    Node* current = any;
+                    do {
+                        Node* next = current->next;
+                        if (!std::is_trivially_destructible<Node>::value) node_traits::destroy(alloc, current);
+                        counters.frees(1);
+                        current = next;
+                    } while (current != any);
+                }
+                pool_release(alloc);
+            } else {
+                Node* current = any->next;
+                while (current != any) {
+                    Node* temp = current;
+                    current = current->next;
+                    destroy_node(temp);
+                }
+                destroy_node(any);
+            }
+            any = nullptr;
+        }
     public:
-    class iterator {
+        typedef Alloc allocator_type;
+
+    // what *it and it-> give: the element's key() and info(), no copy of the iterator
+    class element_ref {
+        friend class bi_ring;
+        private:
+            Node* node;
+            explicit element_ref(Node* n) : node(n) {}
+        public:
+            key_reference key() const { return node->key; }
+            Info& info() const { return node->info; }
+    };
+    class const_element_ref {
         friend class bi_ring;
+        private:
+            const Node* node;
+            explicit const_element_ref(const Node* n) : node(n) {}
+        public:
+            const Key& key() const { return node->key; }
+            const Info& info() const { return node->info; }
+    };
+    template <typename Ref>
+    class arrow {
+        friend class bi_ring;
+        private:
+            Ref ref;
+            explicit arrow(const Ref& r) : ref(r) {}
+        public:
+            const Ref* operator->() const { return &ref; }
+    };
+
+    class const_iterator;
+
+    // with checked_iterators the stamp holds the version, otherwise it is empty and the
+    // iterator is just the node pointer
+    class iterator : private Check::stamp {
+        friend class bi_ring;
+        friend class const_iterator;
         private: 
             Node* node;
-            int version;
+            iterator(Node* n, const int* counter) : Check::stamp(counter), node(n) {}
         public:
-            iterator(Node* n, int v) : node(n), version(v) {}
-            Key& key() { return node->key; }
-            Info& info() { return node->info; }
+            key_reference key() const { return node->key; }
+            Info& info() const { return node->info; }
             iterator& operator++() {
+                this->check();
                 node = node->next;
                 return *this;
             }
             iterator operator++(int) {
                 iterator temp = *this;
-                node = node->next;
+                ++*this;
                 return temp;
             }
             iterator& operator--() {
+                this->check();
                 node = node->prev;
                 return *this;
             }
             iterator operator--(int) {
                 iterator temp = *this;
-                node = node->prev;
+                --*this;
                 return temp;
             }
             bool operator!=(const iterator& other) const {
                 return node != other.node;
             }
-            iterator& operator=(const iterator& other) {
-                node = other.node;
-                version = other.version;
-                return *this;
+            bool operator==(const iterator& other) const {
+                return node == other.node;
             }
-            iterator(const iterator& other) : node(other.node), version(other.version) {}
-            iterator& operator*() {
-                return *this;
+            element_ref operator*() const {
+                return element_ref(node);
             }
-            iterator* operator->() {
-                return this;
+            arrow<element_ref> operator->() const {
+                return arrow<element_ref>(element_ref(node));
             }
-            
     };
-    class const_iterator {
+    class const_iterator : private Check::stamp {
             friend class bi_ring;
 
         private:
             const Node* node;
-            int version;
+            const_iterator(const Node* n, const int* counter) : Check::stamp(counter), node(n) {}
 
         public:
-            const_iterator(const Node* n, int v) : node(n), version(v) {}
-            const_iterator(const const_iterator& other) 
-                : node(other.node), version(other.version) {}
-
             // umożliwia konwersję iterator -> const_iterator
             const_iterator(const iterator& other)
-                : node(other.node), version(other.version) {}
+                : Check::stamp(static_cast<const typename Check::stamp&>(other)), node(other.node) {}
 
             const Key& key() const { return node->key; }
             const Info& info() const { return node->info; }
 
             const_iterator& operator++() {
+                this->check();
                 node = node->next;
                 return *this;
             }
             const_iterator operator++(int) {
                 const_iterator temp = *this;
-                node = node->next;
+                ++*this;
                 return temp;
             }
             const_iterator& operator--() {
+                this->check();
                 node = node->prev;
                 return *this;
             }
             const_iterator operator--(int) {
                 const_iterator temp = *this;
-                node = node->prev;
+                --*this;
                 return temp;
             }
 
             bool operator!=(const const_iterator& other) const {
                 return node != other.node;
             }
-
-            const_iterator& operator=(const const_iterator& other) {
-                node = other.node;
-                version = other.version;
-                return *this;
+            bool operator==(const const_iterator& other) const {
+                return node == other.node;
             }
 
-            // dereference returns const iterator to mimic your structure
-            const_iterator operator*() const {
-                return *this;
+            const_element_ref operator*() const {
+                return const_element_ref(node);
             }
-
-            const_iterator* operator->() {
-                return this;
+            arrow<const_element_ref> operator->() const {
+                return arrow<const_element_ref>(const_element_ref(node));
             }
         };
 
     
         //- - - - - METHODS - - - - -
-        bi_ring() : any(nullptr), version(0) {};
+        bi_ring() : version(0), any(nullptr), alloc() {};
 
-        bi_ring(const bi_ring& other) : any(nullptr), version(0) {
+        explicit bi_ring(const Alloc& a) : version(0), any(nullptr), alloc(a) {}
+
+        bi_ring(const bi_ring& other)
+            : version(0), any(nullptr), alloc(node_traits::select_on_container_copy_construction(other.alloc)) {
             if (!other.any) return;
             Node* current = other.any;
             do {
@@ -133,22 +339,23 @@ class bi_ring {
             } while (current != other.any);
         }
 
+        // takes over the nodes of other; unchecked iterators into other stay valid for this
+        // ring, checked ones are tied to the ring object and report the move as a change
+        bi_ring(bi_ring&& other) noexcept
+            : version(other.version), any(other.any), alloc(other.alloc), index(std::move(other.index)) {
+            other.any = nullptr;
+            other.index.clear();
+            other.bump_version();
+        }
+
         ~bi_ring() {
-            if (!any) return;
-            Node* current = any->next;
-            while (current != any) {
-                Node* temp = current;
-                current = current->next;
-                delete temp;
-            }
-            delete any;
+            release_nodes();
         }
 
         bi_ring& operator=(const bi_ring& other) {
             if (this == &other) return *this;
-            this->~bi_ring();
-            any = nullptr;
-            version = 0;
+            release_nodes();
+            bump_version(); // not back to 0, which old iterators may still carry
             if (!other.any) return *this;
             Node* current = other.any;
             do {
@@ -158,8 +365,46 @@ class bi_ring {
             return *this;
         }
 
+        // adopts the nodes of other when the allocator propagates or both are equal,
+        // otherwise moves the elements one by one into our own nodes
+        bi_ring& operator=(bi_ring&& other) {
+            if (this == &other) return *this;
+            release_nodes();
+            bool propagate = node_traits::propagate_on_container_move_assignment::value;
+            if (propagate || alloc == other.alloc) {
+                if (propagate) alloc = other.alloc;
+                any = other.any;
+                bump_version();
+                index = std::move(other.index);
+                other.any = nullptr;
+                other.index.clear();
+            } else {
+                bump_version();
+                if (other.any) {
+                    Node* current = other.any;
+                    do {
+                        this->push_back(std::move(current->key), std::move(current->info));
+                        current = current->next;
+                    } while (current != other.any);
+                }
+                other.release_nodes();
+            }
+            other.bump_version();
+            return *this;
+        }
+
         iterator push_front(const Key& key, const Info& info) {
-            Node* newNode = new Node(key, info);
+            return emplace_front(key, info);
+        }
+
+        iterator push_front(Key&& key, Info&& info) {
+            return emplace_front(std::move(key), std::move(info));
+        }
+
+        // constructs the element in place from the forwarded arguments
+        template <typename K, typename I>
+        iterator emplace_front(K&& key, I&& info) {
+            Node* newNode = create_node(std::forward<K>(key), std::forward<I>(info));
             if (!any) {
                 newNode->next = newNode;
                 newNode->prev = newNode;
@@ -172,12 +417,12 @@ class bi_ring {
                 any->prev = newNode;
                 any = newNode;
             }
-            version++;
-            return iterator(newNode, version);
+            bump_version();
+            return iterator(newNode, &version);
         }
 
         iterator pop_front() {
-            if (!any) return iterator(nullptr, version);
+            if (!any) return iterator(nullptr, &version);
             Node* toDelete = any;
             if (any->next == any) {
                 any = nullptr;
@@ -187,13 +432,23 @@ class bi_ring {
                 tail->next = any;
                 any->prev = tail;
             }
-            delete toDelete;
-            version++;
-            return iterator(any, version);
+            destroy_node(toDelete);
+            bump_version();
+            return iterator(any, &version);
         }
 
         iterator push_back(const Key& key, const Info& info) {
-            Node* newNode = new Node(key, info);
+            return emplace_back(key, info);
+        }
+
+        iterator push_back(Key&& key, Info&& info) {
+            return emplace_back(std::move(key), std::move(info));
+        }
+
+        // constructs the element in place from the forwarded arguments
+        template <typename K, typename I>
+        iterator emplace_back(K&& key, I&& info) {
+            Node* newNode = create_node(std::forward<K>(key), std::forward<I>(info));
             if (!any) {
                 any = newNode;
             } else {
@@ -203,12 +458,12 @@ class bi_ring {
                 tail->next = newNode;
                 any->prev = newNode;
             }
-            version++;
-            return iterator(newNode, version);
+            bump_version();
+            return iterator(newNode, &version);
         }
 
         iterator pop_back() {
-            if (!any) return iterator(nullptr, version);
+            if (!any) return iterator(nullptr, &version);
             Node* tail = any->prev;
             if (tail == any) {
                 any = nullptr;
@@ -217,30 +472,39 @@ class bi_ring {
                 newTail->next = any;
                 any->prev = newTail;
             }
-            delete tail;
-            version++;
-            return iterator(any, version);
+            destroy_node(tail);
+            bump_version();
+            return iterator(any, &version);
         }
 
         iterator insert(iterator position, const Key& key, const Info& info) {
-            if (position.version != version) {
-                throw runtime_error("Iterator version mismatch");
-            }
-            Node* newNode = new Node(key, info);
+            return emplace(position, key, info);
+        }
+
+        iterator insert(iterator position, Key&& key, Info&& info) {
+            return emplace(position, std::move(key), std::move(info));
+        }
+
+        // constructs the element in place before position
+        template <typename K, typename I>
+        iterator emplace(iterator position, K&& key, I&& info) {
+            position.check(&version);
+            Node* newNode = create_node(std::forward<K>(key), std::forward<I>(info));
             Node* posNode = position.node;
             Node* prevNode = posNode->prev;
             newNode->next = posNode;
             newNode->prev = prevNode;
             prevNode->next = newNode;
             posNode->prev = newNode;
-            version++;
-            return iterator(newNode, version);
+            bump_version();
+            return iterator(newNode, &version);
         }
 
         iterator erase(iterator position) {
-            if (position.version != version || !any) {
+            if (!any) {
                 throw runtime_error("Iterator version mismatch or empty ring");
             }
+            position.check(&version);
             Node* toDelete = position.node;
             if (toDelete->next == toDelete) {
                 any = nullptr;
@@ -253,17 +517,17 @@ class bi_ring {
                     any = nextNode;
                 }
             }
-            delete toDelete;
-            version++;
-            return iterator(any, version);
+            destroy_node(toDelete);
+            bump_version();
+            return iterator(any, &version);
         }
 
         iterator begin() const { 
-            return iterator(any, version); 
+            return iterator(any, &version); 
         }
 
         iterator end() const { 
-            return iterator(any, version); 
+            return iterator(any, &version); 
         } //let's agree, that end() points to the same element as begin()
 
         void print() {
@@ -311,19 +575,85 @@ class bi_ring {
             return any == nullptr;
         }
 
+        void clear() {
+            release_nodes();
+            bump_version();
+        }
+
+        // moves every element of other to the end of this ring and leaves other empty. With
+        // equal allocators the two rings are relinked in O(1) (an indexed ring also indexes
+        // the moved keys, O(size of other)); otherwise the elements are moved into new
+        // nodes one by one. Invalidates the iterators of both rings
+        void splice_back(bi_ring& other) {
+            if (this == &other || !other.any) return;
+            if (alloc == other.alloc) {
+                if (key_index::enabled) {
+                    Node* current = other.any;
+                    try {
+                        do {
+                            index.insert(current->key, current);
+                            current = current->next;
+                        } while (current != other.any);
+                    } catch (...) {
+                        while (current != other.any) {
+                            current = current->prev;
+                            index.erase(current->key, current);
+                        }
+                        throw;
+                    }
+                    other.index.clear();
+                }
+                if (!any) {
+                    any = other.any;
+                } else {
+                    Node* tail = any->prev;
+                    Node* other_tail = other.any->prev;
+                    tail->next = other.any;
+                    other.any->prev = tail;
+                    other_tail->next = any;
+                    any->prev = other_tail;
+                }
+                other.any = nullptr;
+            } else {
+                Node* current = other.any;
+                do {
+                    this->push_back(std::move(current->key), std::move(current->info));
+                    current = current->next;
+                } while (current != other.any);
+                other.release_nodes();
+            }
+            bump_version();
+            other.bump_version();
+        }
+
+        allocator_type get_allocator() const {
+            return allocator_type(alloc);
+        }
+
+        // snapshot of the Stats counters (all zeros for no_stats)
+        container_stats stats() const {
+            return counters.snapshot();
+        }
+
+        void reset_stats() {
+            counters.reset();
+        }
+
         const_iterator find(const Key& key) const {
-            if (!any) return const_iterator(nullptr, version);
+            if (key_index::enabled) return const_iterator(index.find(key), &version);
+            if (!any) return const_iterator(nullptr, &version);
             Node* current = any;
             do {
                 if (current->key == key) {
-                    return const_iterator(current, version);
+                    return const_iterator(current, &version);
                 }
                 current = current->next;
             } while (current != any);
-            return const_iterator(nullptr, version);
+            return const_iterator(nullptr, &version);
         }
 
         bool is_key_in_ring(const Key& key) const {
+            if (key_index::enabled) return index.find(key) != nullptr;
             if (!any) return false;
             Node* current = any;
             do {
@@ -336,10 +666,16 @@ class bi_ring {
         }
 };
 
-template <typename Key, typename Info>
-bi_ring<Key, Info> join(const bi_ring<Key, Info>& first, const bi_ring<Key, Info>& second)
+// ring with a hash index over its keys
+template <typename Key, typename Info, typename Alloc = std::allocator<std::pair<const Key, Info>>>
+using indexed_bi_ring = bi_ring<Key, Info, Alloc, hashed_key_index>;
+
+// join by scanning: every element looks its key up with is_key_in_ring/find, O(n*m);
+// used for keys without std::hash
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join_scan(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second)
 {
-    bi_ring<Key, Info> result;
+    bi_ring<Key, Info, P...> result;
 
     if (first.is_empty() && second.is_empty())
         return result;
@@ -355,7 +691,7 @@ bi_ring<Key, Info> join(const bi_ring<Key, Info>& first, const bi_ring<Key, Info
                 v = v + it2.info();
             }
 
-            result.push_back(k, v);
+            result.push_back(std::move(k), std::move(v));
             it1++;
         } while (it1.key() != first.begin().key());
     }
@@ -374,9 +710,139 @@ bi_ring<Key, Info> join(const bi_ring<Key, Info>& first, const bi_ring<Key, Info
     return result;
 }
 
-template <typename Key, typename Info>
-bi_ring<Key, Info> shuffle(const bi_ring<Key, Info>& first, unsigned int fcnt, const bi_ring<Key, Info>& second, unsigned int scnt, unsigned int reps) {
-     bi_ring<Key, Info> result;
+// join with a temporary hash index over second, O(n + m) on average; same result as join_scan:
+// infos of keys present in both rings are summed with the first match in second, the elements
+// of second whose key is not in first follow
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join_hashed(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second)
+{
+    bi_ring<Key, Info, P...> result;
+
+    if (first.is_empty() && second.is_empty())
+        return result;
+
+    struct entry {
+        const Info* info; // first match in second, what second.find() would return
+        bool in_first;
+    };
+    std::unordered_map<Key, entry> index;
+
+    if (!second.is_empty()) {
+        auto it2 = second.begin();
+        do {
+            index.emplace(it2.key(), entry{&it2.info(), false}); // keeps the first occurrence
+            ++it2;
+        } while (it2 != second.begin());
+    }
+    if (!first.is_empty()) {
+        auto it1 = first.begin();
+        do {
+            auto found = index.find(it1.key());
+            if (found != index.end()) found->second.in_first = true;
+            ++it1;
+        } while (it1 != first.begin());
+
+        // same traversal as join_scan, including its stop at the first repeat of the first key
+        it1 = first.begin();
+        do {
+            auto found = index.find(it1.key());
+            if (found != index.end()) {
+                result.push_back(it1.key(), it1.info() + *found->second.info);
+            } else {
+                result.push_back(it1.key(), it1.info());
+            }
+            it1++;
+        } while (it1.key() != first.begin().key());
+    }
+
+    if (!second.is_empty()) {
+        auto it2 = second.begin();
+        do {
+            if (!index.find(it2.key())->second.in_first) {
+                result.push_back(it2.key(), it2.info());
+            }
+            it2++;
+        } while (it2.key() != second.begin().key());
+    }
+
+    return result;
+}
+
+// join of two rings whose keys ascend from begin(), by merging them in lockstep, O(n + m)
+// without hashing; same result as join_scan for such rings
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join_sorted(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second)
+{
+    bi_ring<Key, Info, P...> result;
+
+    if (first.is_empty() && second.is_empty())
+        return result;
+
+    if (!first.is_empty()) {
+        auto it1 = first.begin();
+        auto it2 = second.begin();
+        bool more2 = !second.is_empty(); // it2 has not wrapped around yet
+        do {
+            while (more2 && it2.key() < it1.key()) {
+                ++it2;
+                more2 = it2 != second.begin();
+            }
+            if (more2 && it2.key() == it1.key()) {
+                result.push_back(it1.key(), it1.info() + it2.info());
+            } else {
+                result.push_back(it1.key(), it1.info());
+            }
+            it1++;
+        } while (it1.key() != first.begin().key());
+    }
+
+    if (!second.is_empty()) {
+        auto it2 = second.begin();
+        auto it1 = first.begin();
+        bool more1 = !first.is_empty();
+        do {
+            while (more1 && it1.key() < it2.key()) {
+                ++it1;
+                more1 = it1 != first.begin();
+            }
+            if (!(more1 && it1.key() == it2.key())) {
+                result.push_back(it2.key(), it2.info());
+            }
+            it2++;
+        } while (it2.key() != second.begin().key());
+    }
+
+    return result;
+}
+
+template <typename T, typename = void>
+struct is_hashable : std::false_type {};
+
+template <typename T>
+struct is_hashable<T, decltype(void(std::hash<T>()(std::declval<const T&>())))> : std::true_type {};
+
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second, std::true_type)
+{
+    return join_hashed(first, second);
+}
+
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second, std::false_type)
+{
+    return join_scan(first, second);
+}
+
+// hash join when std::hash<Key> is available, scanning join otherwise
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second)
+{
+    return join(first, second, is_hashable<Key>());
+}
+
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> shuffle(const bi_ring<Key, Info, P...>& first, unsigned int fcnt, const bi_ring<Key, Info, P...>& second, unsigned int scnt, unsigned int reps) {
+     bi_ring<Key, Info, P...> result;
     //both empty
         if (first.is_empty() && second.is_empty())
         return result;
@@ -412,8 +878,8 @@ bi_ring<Key, Info> shuffle(const bi_ring<Key, Info>& first, unsigned int fcnt, c
     }
 
     // none empty
-    auto it1 = first.is_empty() ? typename bi_ring<Key,Info>::iterator(nullptr, 0) : first.begin();
-    auto it2 = second.is_empty() ? typename bi_ring<Key,Info>::iterator(nullptr, 0) : second.begin();
+    auto it1 = first.begin();
+    auto it2 = second.begin();
 
     for (unsigned int r = 0; r < reps; r++) {
 
@@ -429,4 +895,261 @@ bi_ring<Key, Info> shuffle(const bi_ring<Key, Info>& first, unsigned int fcnt, c
     }
 
     return result;
-}
\ No newline at end of file
+}
+
+// Builds the output of a parallel shuffle/join from `units` consecutive pieces of work:
+// thread t makes the ring of units [units*t/threads, units*(t+1)/threads) with
+// emit(ring, lo, hi), and the rings are spliced together in order, O(threads) relinks.
+// The calling thread builds the first part; a part whose thread cannot be started is built
+// here too. The first exception thrown by emit is rethrown once every thread has finished
+template <typename Ring, typename Emit>
+Ring build_in_parts(std::size_t units, unsigned threads, Emit emit) {
+    if (threads > units) threads = static_cast<unsigned>(units);
+    if (threads == 0) threads = 1;
+    std::vector<Ring> parts(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    auto work = [&](unsigned t) {
+        try {
+            emit(parts[t], units * t / threads, units * (t + 1) / threads);
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++) {
+        try {
+            workers.emplace_back(work, t);
+        } catch (const std::system_error&) {
+            work(t);
+        }
+    }
+    work(0);
+    for (auto& worker : workers) worker.join();
+    for (auto& error : errors)
+        if (error) std::rethrow_exception(error);
+    Ring result(std::move(parts[0]));
+    for (unsigned t = 1; t < threads; t++) result.splice_back(parts[t]);
+    return result;
+}
+
+// the parts of a parallel result are spliced together, which needs nodes that any ring of
+// this type can free: allocators that always compare equal (std::allocator, not pool_allocator)
+template <typename Ring>
+struct ring_parts_splice : std::allocator_traits<typename Ring::allocator_type>::is_always_equal {};
+
+// pointers to the key and info of every element, in order from begin()
+template <typename Key, typename Info, typename... P>
+std::vector<std::pair<const Key*, const Info*>> ring_entries(const bi_ring<Key, Info, P...>& ring) {
+    std::vector<std::pair<const Key*, const Info*>> entries;
+    if (ring.is_empty()) return entries;
+    auto it = ring.begin();
+    do {
+        entries.emplace_back(&it.key(), &it.info());
+        ++it;
+    } while (it != ring.begin());
+    return entries;
+}
+
+// below this many output elements the parallel versions call the serial ones
+const std::size_t ring_parallel_cutoff = 1 << 14;
+
+// shuffle() on `threads` threads (0: every hardware thread), with the same output. The
+// repetitions are dealt out in blocks: block [r0, r1) starts at output offset r0*(fcnt+scnt)
+// and at positions r0*fcnt mod |first| and r0*scnt mod |second| of the rings, so every
+// block is built on its own thread without looking at the others
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> shuffle_parallel(const bi_ring<Key, Info, P...>& first, unsigned int fcnt,
+                                          const bi_ring<Key, Info, P...>& second, unsigned int scnt,
+                                          unsigned int reps, unsigned threads = 0) {
+    typedef bi_ring<Key, Info, P...> ring;
+    std::size_t take1 = first.is_empty() ? 0 : fcnt;
+    std::size_t take2 = second.is_empty() ? 0 : scnt;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads == 1 || !ring_parts_splice<ring>::value || std::size_t(reps) * (take1 + take2) < ring_parallel_cutoff)
+        return shuffle(first, fcnt, second, scnt, reps);
+
+    std::vector<std::pair<const Key*, const Info*>> one = ring_entries(first), two = ring_entries(second);
+    return build_in_parts<ring>(reps, threads, [&](ring& part, std::size_t lo, std::size_t hi) {
+        std::size_t i1 = one.empty() ? 0 : lo * take1 % one.size();
+        std::size_t i2 = two.empty() ? 0 : lo * take2 % two.size();
+        for (std::size_t r = lo; r < hi; r++) {
+            for (std::size_t i = 0; i < take1; i++) {
+                part.push_back(*one[i1].first, *one[i1].second);
+                if (++i1 == one.size()) i1 = 0;
+            }
+            for (std::size_t i = 0; i < take2; i++) {
+                part.push_back(*two[i2].first, *two[i2].second);
+                if (++i2 == two.size()) i2 = 0;
+            }
+        }
+    });
+}
+
+// the elements join() visits: the ring from begin() up to the first repeat of the first key
+template <typename Key, typename Info, typename... P>
+std::vector<std::pair<const Key*, const Info*>> join_entries(const bi_ring<Key, Info, P...>& ring) {
+    std::vector<std::pair<const Key*, const Info*>> entries = ring_entries(ring);
+    for (std::size_t i = 1; i < entries.size(); i++) {
+        if (*entries[i].first == *entries[0].first) {
+            entries.resize(i);
+            break;
+        }
+    }
+    return entries;
+}
+
+// join() in parts: output unit i < |a| is element i of first's traversal a, the rest are the
+// elements of second's traversal b; match(key) is the info to add (nullptr for none) and
+// in_first(key) drops an element of b
+template <typename Key, typename Info, typename... P, typename Match, typename InFirst>
+bi_ring<Key, Info, P...> join_in_parts(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second,
+                                       unsigned threads, Match match, InFirst in_first) {
+    typedef bi_ring<Key, Info, P...> ring;
+    std::vector<std::pair<const Key*, const Info*>> a = join_entries(first), b = join_entries(second);
+    return build_in_parts<ring>(a.size() + b.size(), threads, [&](ring& part, std::size_t lo, std::size_t hi) {
+        for (std::size_t i = lo; i < hi; i++) {
+            if (i < a.size()) {
+                const Info* other = match(*a[i].first);
+                if (other) part.push_back(*a[i].first, *a[i].second + *other);
+                else part.push_back(*a[i].first, *a[i].second);
+            } else {
+                const std::pair<const Key*, const Info*>& e = b[i - a.size()];
+                if (!in_first(*e.first)) part.push_back(*e.first, *e.second);
+            }
+        }
+    });
+}
+
+// hashed: the index over second is built first, the parts look keys up in it concurrently
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join_parallel(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second,
+                                       unsigned threads, std::true_type)
+{
+    struct entry {
+        const Info* info; // first match in second
+        bool in_first;
+    };
+    std::unordered_map<Key, entry> index;
+    for (const auto& e : ring_entries(second)) index.emplace(*e.first, entry{e.second, false});
+    for (const auto& e : ring_entries(first)) {
+        auto found = index.find(*e.first);
+        if (found != index.end()) found->second.in_first = true;
+    }
+    return join_in_parts(first, second, threads,
+        [&](const Key& key) -> const Info* {
+            auto found = index.find(key);
+            return found == index.end() ? nullptr : found->second.info;
+        },
+        [&](const Key& key) { return index.find(key)->second.in_first; });
+}
+
+// scanning: every part runs the O(n*m) ring lookups of join_scan for its own elements
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join_parallel(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second,
+                                       unsigned threads, std::false_type)
+{
+    return join_in_parts(first, second, threads,
+        [&](const Key& key) -> const Info* {
+            return second.is_key_in_ring(key) ? &second.find(key).info() : nullptr;
+        },
+        [&](const Key& key) { return first.is_key_in_ring(key); });
+}
+
+// join() on `threads` threads (0: every hardware thread), with the same output: the
+// elements join() visits are cut into contiguous ranges, each range is joined into a ring
+// of its own and the rings are spliced together in order
+template <typename Key, typename Info, typename... P>
+bi_ring<Key, Info, P...> join_parallel(const bi_ring<Key, Info, P...>& first, const bi_ring<Key, Info, P...>& second,
+                                       unsigned threads = 0)
+{
+    typedef bi_ring<Key, Info, P...> ring;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads == 1 || !ring_parts_splice<ring>::value)
+        return join(first, second);
+    // the sizes are only known after a walk, which the parallel version needs anyway
+    std::size_t n = 0;
+    for (const bi_ring<Key, Info, P...>* r : {&first, &second}) {
+        if (r->is_empty()) continue;
+        auto it = r->begin();
+        do {
+            n++;
+            ++it;
+        } while (it != r->begin() && n < ring_parallel_cutoff);
+    }
+    if (n < ring_parallel_cutoff)
+        return join(first, second);
+    return join_parallel(first, second, threads, is_hashable<Key>());
+}
+
+// Lazy result of shuffle(): the sequence shuffle(first, fcnt, second, scnt, reps) would
+// build, without materialising it. The output repeats with a period of lcm(p1, p2)
+// repetitions, where p1 = |first| / gcd(|first|, fcnt) (likewise p2), so only one period
+// (at most reps repetitions) is copied; element i is period[i % period length].
+// The view holds copies and stays valid when first and second change afterwards.
+template <typename Key, typename Info>
+class shuffle_view {
+    public:
+        typedef std::pair<Key, Info> value_type;
+
+        template <typename... P>
+        shuffle_view(const bi_ring<Key, Info, P...>& first, unsigned int fcnt,
+                     const bi_ring<Key, Info, P...>& second, unsigned int scnt, unsigned int reps) : total(0) {
+            std::size_t take1 = first.is_empty() ? 0 : fcnt;
+            std::size_t take2 = second.is_empty() ? 0 : scnt;
+            if (reps == 0 || take1 + take2 == 0) return;
+
+            std::size_t cycle = std::lcm(cycle_reps(first, take1), cycle_reps(second, take2));
+            std::size_t period_reps = cycle < reps ? cycle : reps;
+            period.reserve(period_reps * (take1 + take2));
+            auto it1 = first.begin();
+            auto it2 = second.begin();
+            for (std::size_t r = 0; r < period_reps; r++) {
+                for (std::size_t i = 0; i < take1; i++, ++it1) period.emplace_back(it1.key(), it1.info());
+                for (std::size_t i = 0; i < take2; i++, ++it2) period.emplace_back(it2.key(), it2.info());
+            }
+            total = std::size_t(reps) * (take1 + take2);
+        }
+
+        std::size_t size() const { return total; }
+        bool is_empty() const { return total == 0; }
+        // number of elements stored for one period
+        std::size_t period_size() const { return period.size(); }
+
+        const value_type& operator[](std::size_t i) const { return period[i % period.size()]; }
+        const Key& key(std::size_t i) const { return (*this)[i].first; }
+        const Info& info(std::size_t i) const { return (*this)[i].second; }
+
+        // builds the ring shuffle() returns
+        template <typename Ring = bi_ring<Key, Info>>
+        Ring to_ring() const {
+            Ring result;
+            for (std::size_t i = 0; i < total; i++) {
+                const value_type& v = (*this)[i];
+                result.push_back(v.first, v.second);
+            }
+            return result;
+        }
+
+    private:
+        std::vector<value_type> period;
+        std::size_t total;
+
+        // repetitions after which taking `take` elements per repetition returns to begin()
+        template <typename... P>
+        static std::size_t cycle_reps(const bi_ring<Key, Info, P...>& ring, std::size_t take) {
+            if (take == 0) return 1;
+            std::size_t n = 0;
+            auto it = ring.begin();
+            do {
+                n++;
+                ++it;
+            } while (it != ring.begin());
+            return n / std::gcd(n, take);
+        }
+};
+
+template <typename Key, typename Info, typename... P>
+shuffle_view<Key, Info> make_shuffle_view(const bi_ring<Key, Info, P...>& first, unsigned int fcnt,
+                                          const bi_ring<Key, Info, P...>& second, unsigned int scnt, unsigned int reps) {
+    return shuffle_view<Key, Info>(first, fcnt, second, scnt, reps);
+}
@@ -1,10 +1,15 @@
 #include "bi_ring.hpp" 
+#include "concurrent_ring.hpp"
+#include "../common/cow.hpp"
+#include <atomic>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 //functions to manage unit_tests for bi_ring, join and shuffle
-template <typename Key, typename Info> 
-std::vector<std::pair<Key,Info>> toVector(const bi_ring<Key,Info>& r) { // function in order to change bi_ring to vector for easy testing
+template <typename Key, typename Info, typename... P> 
+std::vector<std::pair<Key,Info>> toVector(const bi_ring<Key,Info,P...>& r) { // function in order to change bi_ring to vector for easy testing
     std::vector<std::pair<Key,Info>> out;
     if (r.is_empty()) return out;
 
@@ -32,6 +37,11 @@ void assertEqual(const std::vector<std::pair<Key,Info>>& a, const std::vector<st
     }
 }
 
+void assertTrue(bool condition, const std::string& testName)
+{
+    std::cout << (condition ? "[OK] " : "[FAIL] ") << testName << "\n";
+}
+
 //bi_ring tests
 void testBiRingBasic() {
     bi_ring<int, std::string> r;
@@ -163,6 +173,239 @@ void eraseTest(){
     assertEqual(out, expected, "EraseTest");
 }
 
+void testPoolAllocator() {
+    typedef bi_ring<int, std::string, pool_allocator<std::pair<const int, std::string>>> pooled_ring;
+    pooled_ring r;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 300; i++) r.push_back(i, std::to_string(i));
+        for (int i = 0; i < 100; i++) r.pop_front();
+        r.clear(); // pool released in bulk
+    }
+    r.push_back(1, "one");
+    r.push_back(2, "two");
+    r.push_front(0, "zero");
+    r.pop_back();
+
+    pooled_ring copy = r;
+    pooled_ring assigned;
+    assigned = copy;
+
+    std::vector<std::pair<int, std::string>> expected = {
+        {0, "zero"},
+        {1, "one"}
+    };
+    assertEqual(toVector(r), expected, "PoolAllocator");
+    assertEqual(toVector(assigned), expected, "PoolAllocatorCopy");
+}
+
+void testMoveAndEmplace() {
+    bi_ring<int, std::string> r;
+    std::string big(100, 'x');
+    r.push_back(1, std::move(big));
+    r.emplace_back(2, "two");
+    r.emplace_front(0, std::string(3, 'z'));
+    auto it = r.begin();
+    ++it;
+    r.emplace(it, 5, "five");
+
+    bi_ring<int, std::string> moved(std::move(r));
+    bi_ring<int, std::string> assigned;
+    assigned.push_back(9, "nine");
+    assigned = std::move(moved);
+
+    std::vector<std::pair<int, std::string>> expected = {
+        {0, "zzz"},
+        {5, "five"},
+        {1, std::string(100, 'x')},
+        {2, "two"}
+    };
+    assertEqual(toVector(assigned), expected, "MoveAndEmplace");
+    assertEqual(toVector(moved), {}, "MovedFromEmpty");
+    moved.push_back(4, "four"); // moved-from ring stays usable
+    assertEqual(toVector(moved), {{4, "four"}}, "MovedFromReuse");
+}
+
+void testIndexedRing() {
+    indexed_bi_ring<int, std::string> r;
+    for (int i = 0; i < 50; i++) r.push_back(i, std::to_string(i));
+    r.push_front(-1, "minus");
+    auto pos = r.begin();
+    ++pos;
+    r.insert(pos, 100, "hundred");
+    r.pop_back();                 // 49
+    r.pop_front();                // -1
+    auto it = r.begin();
+    ++it;
+    ++it;
+    r.erase(it);                  // 1
+
+    assertTrue(r.is_key_in_ring(100) && r.find(100).info() == "hundred", "IndexedFindInserted");
+    assertTrue(!r.is_key_in_ring(49) && !r.is_key_in_ring(-1) && !r.is_key_in_ring(1), "IndexedErased");
+    assertTrue(r.find(30).key() == 30 && r.find(30).info() == "30", "IndexedFind");
+    assertTrue(!r.is_key_in_ring(1000), "IndexedMissing");
+
+    indexed_bi_ring<int, std::string> copy = r;
+    r.clear();
+    assertTrue(!r.is_key_in_ring(30) && copy.is_key_in_ring(30), "IndexedCopyClear");
+
+    indexed_bi_ring<int, std::string> moved(std::move(copy));
+    assertTrue(!copy.is_key_in_ring(30) && moved.find(30).info() == "30", "IndexedMove");
+    copy.push_back(30, "again");
+    assertTrue(copy.find(30).info() == "again", "IndexedMovedFromReuse");
+
+    // same contents and iteration order as a plain ring
+    bi_ring<int, std::string> plain;
+    auto k = moved.begin();
+    do {
+        plain.push_back(k.key(), k.info());
+        ++k;
+    } while (k != moved.begin());
+    assertEqual(toVector(moved), toVector(plain), "IndexedOrder");
+    assertEqual(toVector(join(moved, moved)), toVector(join(plain, plain)), "IndexedJoin");
+}
+
+void testStatsPolicy() {
+    typedef std::pair<const int, std::string> value_type;
+    bi_ring<int, std::string, std::allocator<value_type>, no_key_index, atomic_stats> r;
+    for (int i = 0; i < 5; i++) r.push_back(i, "v");
+    r.insert(r.begin(), 9, "w");
+    r.pop_front();
+    container_stats s = r.stats();
+    assertTrue(s.allocations == 6 && s.frees == 1 && s.version_bumps == 7, "StatsCounts");
+
+    bi_ring<int, std::string, std::allocator<value_type>, no_key_index, atomic_stats> moved(std::move(r));
+    assertTrue(moved.stats().version_bumps == 0 && r.stats().version_bumps == 8, "StatsMoveBumpsSource");
+    moved.clear();
+    assertTrue(moved.stats().frees == 5 && moved.stats().version_bumps == 1, "StatsClear");
+
+    // bulk release of a pool still counts every node
+    bi_ring<int, int, pool_allocator<std::pair<const int, int>>, no_key_index, atomic_stats> pooled;
+    for (int i = 0; i < 100; i++) pooled.push_back(i, i);
+    pooled.clear();
+    assertTrue(pooled.stats().allocations == 100 && pooled.stats().frees == 100, "StatsPoolRelease");
+    pooled.reset_stats();
+    assertTrue(pooled.stats().allocations == 0, "StatsReset");
+
+    bi_ring<int, int> plain;
+    plain.push_back(1, 1);
+    assertTrue(plain.stats().allocations == 0 && plain.stats().version_bumps == 0, "StatsOffByDefault");
+}
+
+// throws the expected std::runtime_error, for the checked iterator tests
+template <typename F>
+bool throwsMismatch(F f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void testIteratorChecking() {
+    typedef std::allocator<std::pair<const int, int>> alloc;
+    typedef bi_ring<int, int, alloc, no_key_index, no_stats, checked_iterators> checked_ring;
+    typedef bi_ring<int, int, alloc, no_key_index, no_stats, unchecked_iterators> unchecked_ring;
+
+    checked_ring r;
+    r.push_back(1, 10);
+    auto stale = r.push_back(2, 20);
+    r.push_back(3, 30);
+    assertTrue(throwsMismatch([&] { ++stale; }), "CheckedIncrementStale");
+    assertTrue(throwsMismatch([&] { stale--; }), "CheckedDecrementStale");
+    assertTrue(throwsMismatch([&] { r.insert(stale, 4, 40); }), "CheckedInsertStale");
+    assertTrue(throwsMismatch([&] { r.erase(stale); }), "CheckedEraseStale");
+
+    checked_ring other = r;
+    assertTrue(throwsMismatch([&] { other.insert(r.begin(), 4, 40); }), "CheckedOtherRing");
+    auto it = r.begin();
+    ++it;
+    it = r.insert(it, 4, 40); // the returned iterator is current
+    ++it;
+    --it;
+    checked_ring::const_iterator cit = it;
+    ++cit;
+    assertTrue(cit.key() == 2, "CheckedFreshIterators");
+
+    // copy assignment bumps the version instead of restarting it, so an iterator from before
+    // cannot match again by chance
+    checked_ring a, b;
+    a.push_back(1, 1);
+    auto before = a.push_back(2, 2);
+    b.push_back(5, 5);
+    b.push_back(6, 6);
+    a = b;
+    assertTrue(throwsMismatch([&] { a.insert(before, 7, 7); }), "CheckedAfterCopyAssign");
+
+    // unchecked: a single pointer, and element_ref gives the element through * and ->
+    unchecked_ring u;
+    for (int i = 0; i < 4; i++) u.push_back(i, i * 10);
+    assertTrue(sizeof(unchecked_ring::iterator) == sizeof(void*) && sizeof(unchecked_ring::const_iterator) == sizeof(void*),
+               "UncheckedPointerSize");
+    auto ui = u.begin();
+    u.push_back(4, 40); // node of ui stays, only the checking would object
+    ++ui;
+    ui->info() += 1;
+    (*ui).info() += 1;
+    assertTrue((*ui).key() == 1 && ui->info() == 12, "ElementRef");
+    unchecked_ring::const_iterator uc = ui;
+    assertTrue(uc->key() == 1 && (*uc).info() == 12, "ConstElementRef");
+    assertEqual(toVector(u), {{0,0},{1,12},{2,20},{3,30},{4,40}}, "UncheckedContents");
+}
+
+void testCowRing() {
+    cow<bi_ring<int, int>> a;
+    for (int i = 0; i < 4; i++) a.mutate().push_back(i, i * 10);
+    cow<bi_ring<int, int>> b = a;
+    assertTrue(a.shared() && &a.get() == &b.get(), "CowShares");
+    b.mutate().push_back(9, 90);
+    assertEqual(toVector(a.get()), {{0,0},{1,10},{2,20},{3,30}}, "CowSourceUnchanged");
+    assertEqual(toVector(b.get()), {{0,0},{1,10},{2,20},{3,30},{9,90}}, "CowCopyChanged");
+    assertTrue(!a.shared() && !b.shared(), "CowNoLongerShared");
+    auto joined = join(a.get(), b.get());
+    assertTrue(toVector(joined).size() == 5, "CowReadOnlyJoin");
+}
+
+// a reader drops its handle on another thread while the owner mutates: mutate() either
+// copies or, once the reader is gone, writes in place after the reader's last reads
+void testCowRingThreads() {
+    cow<bi_ring<int, int>> a;
+    for (int i = 0; i < 64; i++) a.mutate().push_back(i, i);
+    std::atomic<long> total(0);
+    int in_place = 0; // rounds in which mutate() found no other handle
+    for (int round = 0; round < 200; round++) {
+        cow<bi_ring<int, int>> handle = a;
+        // h binds to the copy std::thread keeps, so clearing h drops the thread's only reference
+        std::thread reader([&total](cow<bi_ring<int, int>>&& h) {
+            long sum = 0;
+            auto it = h->begin();
+            do {
+                sum += it.info();
+                ++it;
+            } while (it != h->begin());
+            total += sum;
+            h = cow<bi_ring<int, int>>();
+        }, handle);
+        handle = cow<bi_ring<int, int>>();
+#ifndef __SANITIZE_THREAD__
+        // ThreadSanitizer does not model the fence in cow::shared() and would report these rounds
+        if (round % 2 == 0) {
+            while (a.shared()) std::this_thread::yield(); // no other sync: mutate() below writes in place
+        }
+#endif
+        if (!a.shared()) in_place++;
+        for (int i = 0; i < 8; i++) {
+            auto first = a.mutate().begin();
+            first.info() += 1;
+        }
+        reader.join();
+    }
+#ifndef __SANITIZE_THREAD__
+    assertTrue(in_place >= 100, "CowRingThreads in place");
+#endif
+    assertTrue(!a.shared() && total.load() > 0 && a->begin().info() == 200 * 8, "CowRingThreads");
+}
+
 //join tests
 void testJoinBothEmpty() {
     bi_ring<int,int> a, b;
@@ -273,6 +516,125 @@ void testJoinSomeCommon() {
     assertEqual(out, expected, "JoinSomeCommon");
 }
 
+void testJoinVariantsMatchScan() {
+    unsigned seed = 99;
+    auto next = [&seed]() { seed = seed * 1103515245u + 12345u; return (seed >> 16) % 40; };
+    for (int round = 0; round < 50; round++) {
+        bi_ring<int,int> a, b;
+        int na = next() % 12, nb = next() % 12;
+        for (int i = 0; i < na; i++) a.push_back(next() % 15, i);          // duplicates on purpose
+        for (int i = 0; i < nb; i++) b.push_back(next() % 15, 100 + i);
+        auto expected = toVector(join_scan(a, b));
+        if (toVector(join_hashed(a, b)) != expected || toVector(join(a, b)) != expected) {
+            assertEqual(toVector(join_hashed(a, b)), expected, "JoinHashedMatchesScan");
+            return;
+        }
+    }
+    std::cout << "[OK] JoinHashedMatchesScan\n";
+
+    bi_ring<int,int> sa, sb;
+    for (int i = 0; i < 1000; i += 2) sa.push_back(i, 1);
+    for (int i = 0; i < 1000; i += 3) sb.push_back(i, 10);
+    assertEqual(toVector(join_sorted(sa, sb)), toVector(join_scan(sa, sb)), "JoinSortedMatchesScan");
+    assertEqual(toVector(join_sorted(sa, bi_ring<int,int>())), toVector(join_scan(sa, bi_ring<int,int>())), "JoinSortedSecondEmpty");
+    assertEqual(toVector(join_sorted(bi_ring<int,int>(), sb)), toVector(join_scan(bi_ring<int,int>(), sb)), "JoinSortedFirstEmpty");
+}
+
+struct ring_point { // key without std::hash, join falls back to scanning
+    int x;
+    bool operator==(const ring_point& o) const { return x == o.x; }
+    bool operator!=(const ring_point& o) const { return x != o.x; }
+};
+
+void testJoinUnhashableKey() {
+    bi_ring<ring_point,int> a, b;
+    a.push_back({1}, 1);
+    a.push_back({2}, 2);
+    b.push_back({2}, 5);
+    b.push_back({3}, 7);
+    auto res = join(a, b);
+    std::vector<std::pair<int,int>> out;
+    auto it = res.begin();
+    do {
+        out.push_back({it.key().x, it.info()});
+        ++it;
+    } while (it != res.begin());
+    assertEqual(out, {{1,1}, {2,7}, {3,7}}, "JoinUnhashableKey");
+}
+
+void testSpliceBack() {
+    bi_ring<int, int> a, b, empty;
+    for (int i = 0; i < 3; i++) a.push_back(i, i);
+    for (int i = 3; i < 5; i++) b.push_back(i, i);
+    a.splice_back(b);
+    a.splice_back(empty);
+    empty.splice_back(a);
+    assertEqual(toVector(empty), {{0,0},{1,1},{2,2},{3,3},{4,4}}, "SpliceBack");
+    assertTrue(a.is_empty() && b.is_empty(), "SpliceBackEmptiesSource");
+
+    // different pools: the elements are moved into nodes of the receiving ring
+    typedef bi_ring<int, int, pool_allocator<std::pair<const int, int>>> pooled_ring;
+    pooled_ring p, q;
+    p.push_back(1, 1);
+    q.push_back(2, 2);
+    q.push_back(3, 3);
+    p.splice_back(q);
+    q.push_back(9, 9);
+    assertEqual(toVector(p), {{1,1},{2,2},{3,3}}, "SpliceBackOtherPool");
+
+    indexed_bi_ring<int, int> x, y;
+    x.push_back(1, 1);
+    y.push_back(2, 2);
+    x.splice_back(y);
+    assertTrue(x.is_key_in_ring(2) && x.find(2).info() == 2 && !y.is_key_in_ring(2), "SpliceBackIndex");
+}
+
+void testParallelShuffleJoin() {
+    bi_ring<int,int> a, b, none;
+    for (int i = 0; i < 7; i++) a.push_back(i, i);
+    for (int i = 0; i < 5; i++) b.push_back(100 + i, i);
+    bool same = true;
+    for (unsigned threads : {2u, 3u, 8u}) {
+        same = same && toVector(shuffle_parallel(a, 3, b, 2, 5000, threads)) == toVector(shuffle(a, 3, b, 2, 5000));
+        same = same && toVector(shuffle_parallel(a, 4, none, 9, 9000, threads)) == toVector(shuffle(a, 4, none, 9, 9000));
+        same = same && toVector(shuffle_parallel(none, 4, b, 9, 9000, threads)) == toVector(shuffle(none, 4, b, 9, 9000));
+        same = same && toVector(shuffle_parallel(a, 0, b, 0, 100000, threads)).empty();
+    }
+    assertTrue(same, "ShuffleParallelMatchesShuffle");
+    assertEqual(toVector(shuffle_parallel(a, 3, b, 2, 4, 4)), toVector(shuffle(a, 3, b, 2, 4)), "ShuffleParallelSmall");
+
+    // repeated and common keys, and a repeat of the first key that ends join()'s walk
+    bi_ring<int,int> big1, big2;
+    unsigned seed = 7;
+    auto next = [&seed]() { seed = seed * 1103515245u + 12345u; return static_cast<int>((seed >> 16) % 30000); };
+    big1.push_back(-1, 1);
+    for (int i = 0; i < 20000; i++) big1.push_back(next(), i);
+    big1.push_back(-1, 2);
+    for (int i = 0; i < 20000; i++) big1.push_back(next(), i);
+    for (int i = 0; i < 20000; i++) big2.push_back(next(), i);
+    same = true;
+    for (unsigned threads : {2u, 5u})
+        same = same && toVector(join_parallel(big1, big2, threads)) == toVector(join(big1, big2))
+                    && toVector(join_parallel(big2, big1, threads)) == toVector(join(big2, big1))
+                    && toVector(join_parallel(big1, none, threads)) == toVector(join(big1, none));
+    assertTrue(same, "JoinParallelMatchesJoin");
+
+    bi_ring<ring_point,int> p1, p2;
+    for (int i = 0; i < 9000; i++) p1.push_back({i % 6000}, i);
+    for (int i = 0; i < 9000; i++) p2.push_back({i % 7000 + 3000}, i);
+    auto ref = join(p1, p2), par = join_parallel(p1, p2, 4);
+    auto ir = ref.begin();
+    auto ip = par.begin();
+    std::size_t n = 0;
+    same = true;
+    do {
+        same = same && ir.key() == ip.key() && ir.info() == ip.info();
+        ++ir;
+        ++ip;
+        n++;
+    } while (ir != ref.begin() && same);
+    assertTrue(same && ip == par.begin() && n == 10000, "JoinParallelUnhashableKey");
+}
 
 //shuffle tests
 void testShuffleBothEmpty() {
@@ -363,4 +725,115 @@ void testShuffleZeroCounts() {
     auto out = toVector(res);
 
     assertEqual(out, {}, "ZeroCounts");
-}
\ No newline at end of file
+}
+
+void testShuffleView() {
+    bi_ring<int,char> a, b, empty;
+    for (int i = 0; i < 4; i++) a.push_back(i, 'a' + i);
+    for (int i = 0; i < 3; i++) b.push_back(10 + i, 'x' + i);
+
+    // (fcnt, scnt, reps) covering wrap-around, counts above the ring size and empty sides
+    const unsigned int cases[][3] = {{2, 1, 20}, {3, 2, 50}, {4, 3, 7}, {5, 0, 9}, {0, 0, 5}, {1, 4, 0}};
+    bool same = true;
+    for (auto& c : cases) {
+        auto view = make_shuffle_view(a, c[0], b, c[1], c[2]);
+        auto eager = toVector(shuffle(a, c[0], b, c[1], c[2]));
+        same = same && view.size() == eager.size() && toVector(view.to_ring()) == eager;
+        for (std::size_t i = 0; same && i < eager.size(); i++)
+            same = view.key(i) == eager[i].first && view.info(i) == eager[i].second;
+        auto one_side = toVector(shuffle(a, c[0], empty, c[1], c[2]));
+        same = same && toVector(make_shuffle_view(a, c[0], empty, c[1], c[2]).to_ring()) == one_side;
+    }
+    assertTrue(same, "ShuffleViewMatchesShuffle");
+
+    // 2 of 4 and 1 of 3 per repetition: the pattern repeats after lcm(2, 3) = 6 repetitions
+    auto view = make_shuffle_view(a, 2, b, 1, 1000000);
+    assertTrue(view.size() == 3000000 && view.period_size() == 18, "ShuffleViewPeriod");
+}
+
+//concurrent_bi_ring tests
+void testConcurrentRingBasic() {
+    concurrent_bi_ring<int,std::string> q(3);
+    assertTrue(q.capacity() == 4 && q.size_approx() == 0, "ConcurrentCapacity");
+
+    int key;
+    std::string info;
+    bool ok = !q.try_pop(key, info);
+    for (int lap = 0; lap < 5; lap++) { // wraps the slot array several times
+        for (int i = 0; i < 4; i++) ok = ok && q.try_push(lap * 10 + i, std::to_string(i));
+        ok = ok && !q.try_push(99, "full") && q.size_approx() == 4;
+        for (int i = 0; i < 4; i++) ok = ok && q.try_pop(key, info) && key == lap * 10 + i && info == std::to_string(i);
+        ok = ok && !q.try_pop(key, info);
+    }
+    assertTrue(ok, "ConcurrentPushPopWrap");
+
+    std::vector<std::pair<int,std::string>> in = {{1,"a"}, {2,"b"}, {3,"c"}, {4,"d"}, {5,"e"}, {6,"f"}};
+    std::vector<std::pair<int,std::string>> out;
+    std::size_t pushed = q.push_batch(in.begin(), in.end());
+    std::size_t popped = q.pop_batch(std::back_inserter(out), 3);
+    pushed += q.push_batch(in.begin() + pushed, in.end());
+    popped += q.pop_batch(std::back_inserter(out), 10);
+    assertTrue(pushed == 6 && popped == 6 && out == in, "ConcurrentBatch");
+
+    q.try_push(7, "g");
+    q.try_push(8, "h");
+    auto snap = q.snapshot();
+    bi_ring<int,std::string> ring;
+    ring.push_back(0, "z");
+    std::size_t moved = q.drain_to(ring);
+    std::vector<std::pair<int,std::string>> drained = {{0,"z"}, {7,"g"}, {8,"h"}};
+    std::vector<std::pair<int,std::string>> snapped = {{7,"g"}, {8,"h"}};
+    assertTrue(moved == 2 && toVector(ring) == drained && toVector(snap) == snapped && q.size_approx() == 0,
+               "ConcurrentDrainSnapshot");
+
+    concurrent_bi_ring<int,std::string> leftover(8); // destructor frees what is still queued
+    leftover.try_push(1, std::string(100, 'x'));
+}
+
+void testConcurrentRingThreads() {
+    const int producers = 2, consumers = 2, per_producer = 20000;
+    concurrent_bi_ring<int,int> q(64);
+    std::atomic<long long> key_sum(0);
+    std::atomic<int> received(0);
+    std::atomic<bool> in_order(true);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&q, p] {
+            std::vector<std::pair<int,int>> batch;
+            for (int i = 0; i < per_producer; i++) {
+                if (i % 2) {
+                    while (!q.try_push(i, p)) std::this_thread::yield();
+                    continue;
+                }
+                batch.assign(1, std::make_pair(i, p));
+                while (q.push_batch(batch.begin(), batch.end()) == 0) std::this_thread::yield();
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&] {
+            std::vector<int> last(producers, -1); // keys of one producer must arrive increasing
+            std::vector<std::pair<int,int>> batch;
+            while (received.load() < producers * per_producer) {
+                batch.clear();
+                std::size_t n = q.pop_batch(std::back_inserter(batch), 16);
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (auto& x : batch) {
+                    if (x.first <= last[x.second]) in_order = false;
+                    last[x.second] = x.first;
+                    key_sum += x.first;
+                }
+                received += static_cast<int>(n);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    long long expected = static_cast<long long>(producers) * per_producer * (per_producer - 1) / 2;
+    assertTrue(received.load() == producers * per_producer && key_sum.load() == expected && in_order.load()
+               && q.size_approx() == 0, "ConcurrentProducersConsumers");
+}
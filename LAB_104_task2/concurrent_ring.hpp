@@ -0,0 +1,240 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "bi_ring.hpp"
+
+// Bounded lock-free multi-producer/multi-consumer ring of (key, info) pairs, for handing
+// work between threads without a mutex around bi_ring. Elements leave in the order they
+// were pushed (FIFO).
+//
+// Each slot carries a sequence number telling producers and consumers whose turn it is
+// (D. Vyukov's bounded MPMC queue): a producer claims the slot at the tail index with one
+// CAS, builds the element and publishes it by advancing the slot's sequence; consumers
+// do the same at the head index. The batch calls claim a whole run of ready slots with a
+// single CAS. The slots are allocated once by the constructor and the head and tail
+// indices live on separate cache lines.
+//
+// Key and Info must be nothrow move constructible: values are built before a slot is
+// claimed and then moved in, so a throwing copy never leaves a claimed slot empty.
+template <typename Key, typename Info>
+class concurrent_bi_ring {
+    static_assert(std::is_nothrow_move_constructible<Key>::value && std::is_nothrow_move_constructible<Info>::value,
+                  "concurrent_bi_ring needs nothrow move constructible Key and Info");
+    public:
+        typedef std::pair<Key, Info> value_type;
+
+    private:
+        static const std::size_t cache_line = 64;
+
+        struct alignas(cache_line) slot {
+            std::atomic<std::size_t> sequence;
+            typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+
+            value_type* value() { return reinterpret_cast<value_type*>(&storage); }
+            const value_type* value() const { return reinterpret_cast<const value_type*>(&storage); }
+        };
+
+        alignas(cache_line) std::atomic<std::size_t> tail; // next position to push
+        alignas(cache_line) std::atomic<std::size_t> head; // next position to pop
+        alignas(cache_line) std::size_t mask;               // capacity - 1
+        std::unique_ptr<slot[]> slots;
+
+        static const std::size_t batch_chunk = 32; // values staged per push_batch claim
+        typedef typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type raw_value;
+
+        static std::size_t round_up(std::size_t n) {
+            std::size_t cap = 2;
+            while (cap < n) cap <<= 1;
+            return cap;
+        }
+
+        // claim up to `wanted` consecutive slots that are ready for a producer (ready_offset 0)
+        // or a consumer (ready_offset 1) at `index`; returns the first position and the count
+        std::size_t claim(std::atomic<std::size_t>& index, std::size_t ready_offset, std::size_t wanted, std::size_t& got) {
+            std::size_t pos = index.load(std::memory_order_relaxed);
+            for (;;) {
+                std::size_t n = 0;
+                while (n < wanted) {
+                    std::size_t seq = slots[(pos + n) & mask].sequence.load(std::memory_order_acquire);
+                    if (seq != pos + n + ready_offset) break;
+                    ++n;
+                }
+                if (n == 0) {
+                    // a slot one lap behind is not released yet: ring full (or empty)
+                    std::size_t seq = slots[pos & mask].sequence.load(std::memory_order_acquire);
+                    if (static_cast<std::ptrdiff_t>(seq - (pos + ready_offset)) < 0) {
+                        got = 0;
+                        return pos;
+                    }
+                    pos = index.load(std::memory_order_relaxed); // another thread took it, retry
+                    continue;
+                }
+                if (index.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                    got = n;
+                    return pos;
+                }
+            }
+        }
+
+        void fill(std::size_t pos, value_type&& v) {
+            slot& s = slots[pos & mask];
+            ::new (static_cast<void*>(s.value())) value_type(std::move(v));
+            s.sequence.store(pos + 1, std::memory_order_release);
+        }
+
+        value_type take(std::size_t pos) {
+            slot& s = slots[pos & mask];
+            value_type v(std::move(*s.value()));
+            s.value()->~value_type();
+            s.sequence.store(pos + mask + 1, std::memory_order_release);
+            return v;
+        }
+
+    public:
+        // capacity is rounded up to a power of two (at least 2)
+        explicit concurrent_bi_ring(std::size_t capacity)
+            : tail(0), head(0), mask(round_up(capacity) - 1), slots(new slot[mask + 1]) {
+            for (std::size_t i = 0; i <= mask; ++i) {
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        concurrent_bi_ring(const concurrent_bi_ring&) = delete;
+        concurrent_bi_ring& operator=(const concurrent_bi_ring&) = delete;
+
+        ~concurrent_bi_ring() {
+            std::size_t end = tail.load(std::memory_order_relaxed);
+            for (std::size_t pos = head.load(std::memory_order_relaxed); pos != end; ++pos) {
+                slot& s = slots[pos & mask];
+                if (s.sequence.load(std::memory_order_relaxed) == pos + 1) s.value()->~value_type();
+            }
+        }
+
+        std::size_t capacity() const {
+            return mask + 1;
+        }
+
+        // number of elements at the moment of the call; exact only while no thread pushes or pops
+        std::size_t size_approx() const {
+            std::size_t t = tail.load(std::memory_order_acquire);
+            std::size_t h = head.load(std::memory_order_acquire);
+            return t - h <= mask + 1 ? t - h : 0;
+        }
+
+        bool try_push(const Key& key, const Info& info) {
+            return try_emplace(value_type(key, info));
+        }
+
+        bool try_push(Key&& key, Info&& info) {
+            return try_emplace(value_type(std::move(key), std::move(info)));
+        }
+
+        // false when the ring is full; v is left untouched then
+        bool try_emplace(value_type&& v) {
+            std::size_t got;
+            std::size_t pos = claim(tail, 0, 1, got);
+            if (got == 0) return false;
+            fill(pos, std::move(v));
+            return true;
+        }
+
+        // false when the ring is empty
+        bool try_pop(Key& key, Info& info) {
+            std::size_t got;
+            std::size_t pos = claim(head, 1, 1, got);
+            if (got == 0) return false;
+            value_type v = take(pos);
+            key = std::move(v.first);
+            info = std::move(v.second);
+            return true;
+        }
+
+        // copy the (key, info) pairs of the forward range [first, last) in, in order, as many
+        // as fit; up to batch_chunk copies are built first and their slots claimed with one
+        // CAS. Returns the number of pairs pushed (a prefix of the range).
+        template <typename It>
+        std::size_t push_batch(It first, It last) {
+            std::size_t pushed = 0;
+            raw_value staged[batch_chunk];
+            value_type* values = reinterpret_cast<value_type*>(staged);
+            while (first != last) {
+                std::size_t built = 0;
+                try {
+                    for (It it = first; it != last && built < batch_chunk; ++it, ++built) {
+                        const auto& p = *it;
+                        ::new (static_cast<void*>(values + built)) value_type(p.first, p.second);
+                    }
+                } catch (...) {
+                    for (std::size_t i = 0; i < built; ++i) values[i].~value_type();
+                    throw;
+                }
+                std::size_t got;
+                std::size_t pos = claim(tail, 0, built, got);
+                for (std::size_t i = 0; i < got; ++i) fill(pos + i, std::move(values[i]));
+                for (std::size_t i = 0; i < built; ++i) values[i].~value_type();
+                if (got == 0) break;
+                std::advance(first, got);
+                pushed += got;
+            }
+            return pushed;
+        }
+
+        // pop up to max pairs in order and write them to out; each run of ready slots is
+        // claimed with one CAS. Returns the number of pairs popped.
+        template <typename OutIt>
+        std::size_t pop_batch(OutIt out, std::size_t max) {
+            std::size_t popped = 0;
+            while (popped < max) {
+                std::size_t got;
+                std::size_t pos = claim(head, 1, max - popped, got);
+                if (got == 0) break;
+                std::size_t i = 0;
+                try {
+                    for (; i < got; ++i) {
+                        *out = take(pos + i);
+                        ++out;
+                    }
+                } catch (...) {
+                    for (++i; i < got; ++i) take(pos + i); // claimed slots must be released
+                    throw;
+                }
+                popped += got;
+            }
+            return popped;
+        }
+
+        // pop everything currently in the ring and append it to ring (safe next to other threads)
+        template <typename... P>
+        std::size_t drain_to(bi_ring<Key, Info, P...>& ring) {
+            std::size_t moved = 0;
+            for (;;) {
+                std::size_t got;
+                std::size_t pos = claim(head, 1, 1, got);
+                if (got == 0) break;
+                value_type v = take(pos);
+                ring.push_back(std::move(v.first), std::move(v.second));
+                ++moved;
+            }
+            return moved;
+        }
+
+        // copy of the contents, oldest first, as a bi_ring for join()/shuffle();
+        // only while no thread pushes or pops
+        template <typename Ring = bi_ring<Key, Info>>
+        Ring snapshot() const {
+            Ring ring;
+            std::size_t end = tail.load(std::memory_order_acquire);
+            for (std::size_t pos = head.load(std::memory_order_acquire); pos != end; ++pos) {
+                const slot& s = slots[pos & mask];
+                if (s.sequence.load(std::memory_order_acquire) != pos + 1) break;
+                ring.push_back(s.value()->first, s.value()->second);
+            }
+            return ring;
+        }
+};
@@ -13,6 +13,13 @@ int main() {
     testIterators();
     testInsert();
     eraseTest();
+    testPoolAllocator();
+    testMoveAndEmplace();
+    testIndexedRing();
+    testStatsPolicy();
+    testIteratorChecking();
+    testCowRing();
+    testCowRingThreads();
 
     cout << "Running bi_ring join tests..." << endl;
     testJoinBothEmpty();
@@ -21,6 +28,8 @@ int main() {
     testJoinNoCommonKeys();
     testJoinExample();
     testJoinSomeCommon();
+    testJoinVariantsMatchScan();
+    testJoinUnhashableKey();
 
     cout << "Running bi_ring shuffle tests..." << endl;
     testShuffleBothEmpty();
@@ -29,6 +38,13 @@ int main() {
     testShuffleBasic();
     testShuffleWrapAround();
     testShuffleZeroCounts();
+    testShuffleView();
+    testSpliceBack();
+    testParallelShuffleJoin();
+
+    cout << "Running concurrent_bi_ring tests..." << endl;
+    testConcurrentRingBasic();
+    testConcurrentRingThreads();
     cout << "All tests passed!" << endl;
     return 0;
 }
\ No newline at end of file
@@ -2,10 +2,46 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <sstream>
+#include <fstream>
 #include <cctype>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include "../common/container_stats.hpp"
+#include "../common/node_pool.hpp"
+#include "snapshot.hpp"
 
-template <typename Key, typename Info>
+//lookup keys of type K that avl_tree<Key, ...> compares with its keys directly instead of
+//building a Key first, the role is_transparent plays for std::less<>. type is what K is
+//converted to once per lookup; it must compare with Key through ==, < and >, and on a miss
+//operator[] constructs the new Key from it. std::string keys take anything that converts to
+//std::string_view; specialize for other pairs (see interned_avl_tree.hpp)
+template <typename Key, typename K, typename = void>
+struct transparent_key {};
+
+template <typename K>
+struct transparent_key<std::string, K, typename std::enable_if<std::is_convertible<const K&, std::string_view>::value &&
+                                                               !std::is_same<K, std::string>::value>::type> {
+    typedef std::string_view type;
+};
+
+// Alloc is rebound to the internal node type; pool_allocator (common/node_pool.hpp) serves
+// nodes from a slab/free-list pool and lets clear() and the destructor release them in bulk.
+// Stats is a counter policy from common/container_stats.hpp: no_stats (default) costs
+// nothing, atomic_stats counts rotations, lookup path lengths and node allocations/frees.
+template <typename Key, typename Info, typename Alloc = std::allocator<std::pair<const Key, Info>>,
+          typename Stats = no_stats>
 class avl_tree {
 private:
     struct node {
@@ -14,9 +50,38 @@ private:
         node* left;
         node* right;
         int height;
-        node(const Key& k, const Info& i) : key(k), info(i), left(nullptr), right(nullptr), height(1) {}
+        int count; //number of nodes in the subtree rooted here
+        template <typename K, typename... Args>
+        node(K&& k, Args&&... args)
+            : key(std::forward<K>(k)), info(std::forward<Args>(args)...), left(nullptr), right(nullptr), height(1), count(1) {}
     };
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<node> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
     node* root;
+    node_allocator alloc;
+    mutable Stats counters;
+
+    //allocate and construct a node, Info is built from args (value-initialized when empty)
+    template <typename K, typename... Args>
+    node* create_node(K&& k, Args&&... args) {
+    node* n = node_traits::allocate(alloc, 1);
+    try {
+        node_traits::construct(alloc, n, std::forward<K>(k), std::forward<Args>(args)...);
+    } catch (...) {
+        node_traits::deallocate(alloc, n, 1);
+        throw;
+    }
+    counters.allocation();
+    return n;
+    }
+
+    //destroy and deallocate a node
+    void destroy_node(node* n) {
+    node_traits::destroy(alloc, n);
+    node_traits::deallocate(alloc, n, 1);
+    counters.frees(1);
+    }
 
     //functions that use node* or node as parameter or return type
 
@@ -32,23 +97,64 @@ private:
     print(n->left, depth + 1);
     }
 
-    //clear
+    //clear, without recursion: left children are rotated up until the current node has
+    //none, then it is freed and the walk goes on with its right subtree
     void clear(node* n){
-        if(n != nullptr) {
-            clear(n->left);
-            clear(n->right);
-            delete n;
+        while (n != nullptr) {
+            node* next = n->left;
+            if (next != nullptr) {
+                n->left = next->right;
+                next->right = n;
+            } else {
+                next = n->right;
+                destroy_node(n);
+            }
+            n = next;
+        }
+    }
+
+    //run node destructors only, memory is released with the pool
+    void destroy_all(node* n){
+        while (n != nullptr) {
+            node* next = n->left;
+            if (next != nullptr) {
+                n->left = next->right;
+                next->right = n;
+            } else {
+                next = n->right;
+                node_traits::destroy(alloc, n);
+            }
+            n = next;
         }
     }
+
+    //free the whole tree, in bulk when the pool belongs to this tree only
+    void release_nodes() {
+    if (root && pool_can_release(alloc)) {
+        counters.frees(root->count);
+        if (!std::is_trivially_destructible<node>::value)
+            destroy_all(root);
+        pool_release(alloc);
+    } else {
+        clear(root);
+    }
+    root = nullptr;
+    }
     
     //height
     int height(node* n) const {
     return n ? n->height : 0;
     }
 
-    //update height
+    //subtree size
+    int count(const node* n) const {
+    return n ? n->count : 0;
+    }
+
+    //update height and subtree size, called by rotate_left/rotate_right/rebalance
     void update_height(node* n) {
     n->height = 1 + std::max(height(n->left), height(n->right));
+    n->count = 1 + count(n->left) + count(n->right);
     }
 
     //balance factor
@@ -64,6 +170,7 @@ private:
     y->left = T2;
     update_height(y);
     update_height(x);
+    counters.rotation();
     return x;
     }
 
@@ -75,6 +182,7 @@ private:
     x->right = T2;
     update_height(x);
     update_height(y);
+    counters.rotation();
     return y;
     }
 
@@ -101,136 +209,676 @@ private:
     return n;
     }
 
-    //min node
-    node* min_node(node* n) const {
-    node* current = n;
-    while (current->left != nullptr)
-        current = current->left;
-    return current;
-    }
-
-    //find
-    node* find(const Key& key) {
+    //find, K is Key or a transparent_key lookup type
+    template <typename K>
+    node* find(const K& key) {
     node* current = root;
+    unsigned int steps = 0;
     while (current != nullptr) {
+        ++steps;
         if (key == current->key)
-            return current;
+            break;
         else if (key < current->key)
             current = current->left;
         else
             current = current->right;
     }
-    return nullptr;
+    counters.search(steps);
+    return current;
     }
 
     //const find
-    const node* find(const Key& key) const {
+    template <typename K>
+    const node* find(const K& key) const {
     const node* current = root;
+    unsigned int steps = 0;
     while (current != nullptr) {
+        ++steps;
         if (key == current->key)
-            return current;
+            break;
         else if (key < current->key)
             current = current->left;
         else
             current = current->right;
     }
-    return nullptr;
+    counters.search(steps);
+    return current;
+    }
+
+    //lookups walked down the tree together by search_batch
+    static const int batch_lanes = 16;
+
+    static void prefetch_node(const node* n) {
+#if defined(__GNUC__)
+    __builtin_prefetch(n);
+#else
+    (void)n;
+#endif
     }
 
-    //clone
-    node* clone(node* n) const {
-    if (n == nullptr)
+    //finds keys[order[i]] for i < lanes, one level per lane per round: the child each lane
+    //moves to is prefetched and only loaded on the next round, after the other lanes had
+    //their turn, so up to `lanes` cache misses are in flight at once
+    std::size_t find_lanes(const Key* keys, const std::size_t* order, int lanes, const Info** out) const {
+    const node* cur[batch_lanes];
+    unsigned int steps[batch_lanes];
+    for (int j = 0; j < lanes; ++j) {
+        cur[j] = root;
+        steps[j] = 0;
+    }
+    std::size_t found = 0;
+    for (int active = lanes; active > 0;) {
+        for (int j = 0; j < lanes; ++j) {
+            const node* n = cur[j];
+            if (n == nullptr)
+                continue;
+            const Key& key = keys[order[j]];
+            ++steps[j];
+            if (key == n->key) {
+                out[order[j]] = &n->info;
+                ++found;
+                n = nullptr;
+            } else {
+                n = key < n->key ? n->left : n->right;
+                if (n != nullptr)
+                    prefetch_node(n);
+            }
+            cur[j] = n;
+            if (n == nullptr) {
+                --active;
+                counters.search(steps[j]);
+            }
+        }
+    }
+    return found;
+    }
+
+    //clone in pre-order; the right subtrees still to copy wait on a stack that never holds
+    //more than one entry per level. The partial copy is always a valid tree, so a throwing
+    //copy only has to free it
+    node* clone(const node* n) {
+    struct pending {
+        const node* src;
+        node** link;
+    };
+    pending stack[max_height];
+    int depth = 0;
+    node* copy = nullptr;
+    node** link = &copy;
+    try {
+        for (;;) {
+            for (; n != nullptr; n = n->left) {
+                node* new_node = create_node(n->key, n->info);
+                new_node->height = n->height;
+                new_node->count = n->count;
+                *link = new_node;
+                if (n->right)
+                    stack[depth++] = pending{n->right, &new_node->right};
+                link = &new_node->left;
+            }
+            if (depth == 0)
+                break;
+            --depth;
+            n = stack[depth].src;
+            link = stack[depth].link;
+        }
+    } catch (...) {
+        clear(copy);
+        throw;
+    }
+    return copy;
+    }
+    
+    //perfectly balanced subtree from the next n distinct entries of [it, last), the last
+    //entry of a run of equal keys wins; heights and counts are exact
+    template <typename It>
+    node* build_sorted(It& it, It last, int n) {
+    if (n == 0)
         return nullptr;
-    node* new_node = new node(n->key, n->info);
-    new_node->left = clone(n->left);
-    new_node->right = clone(n->right);
-    new_node->height = n->height;
+    int left_n = (n - 1) / 2;
+    node* left = build_sorted(it, last, left_n);
+    It cur = it;
+    for (++it; it != last && !((*cur).first < (*it).first); ++it)
+        cur = it;
+    node* new_node;
+    try {
+        new_node = create_node((*cur).first, (*cur).second);
+    } catch (...) {
+        clear(left);
+        throw;
+    }
+    new_node->left = left;
+    try {
+        new_node->right = build_sorted(it, last, n - 1 - left_n);
+    } catch (...) {
+        clear(new_node);
+        throw;
+    }
+    update_height(new_node);
     return new_node;
     }
-    
-    //insert
-    node* insert(node* n, const Key& key, const Info& info) {
-    if (n == nullptr)
-        return new node(key, info);
-    if (key < n->key)
-        n->left = insert(n->left, key, info);
-    else if (key > n->key)
-        n->right = insert(n->right, key, info);
-    else {
-        n->info = info; //update existing key
-        return n;
-    }
-    return rebalance(n);
-    }
-
-    //remove
-    node* remove(node* n, const Key& key) {
-    if (n == nullptr)
-        return n;
-    if (key < n->key)
-        n->left = remove(n->left, key);
-    else if (key > n->key)
-        n->right = remove(n->right, key);
-    else {
-        if ((n->left == nullptr) || (n->right == nullptr)) {
-            node* temp = n->left ? n->left : n->right;
-            if (temp == nullptr) {
-                temp = n;
-                n = nullptr;
-            } else
-                *n = *temp;
-            delete temp;
+
+    //walk back up a path of links (root side first) after a node was added (delta 1) or
+    //taken out (delta -1) below it; once a subtree keeps its height the ancestors stay
+    //balanced and only their counts change
+    void retrace(node** links[], int depth, int delta) {
+    while (depth > 0) {
+        node** link = links[--depth];
+        int old_height = (*link)->height;
+        *link = rebalance(*link);
+        if ((*link)->height == old_height)
+            break;
+    }
+    while (depth > 0)
+        (*links[--depth])->count += delta;
+    }
+
+    //insert if absent in a single descent, returns the node holding key; `inserted` tells
+    //whether it was created (args are only consumed in that case)
+    template <typename K, typename... Args>
+    node* emplace_at(bool& inserted, K&& key, Args&&... args) {
+    node** links[max_height];
+    int depth = 0;
+    node** link = &root;
+    while (*link != nullptr) {
+        node* n = *link;
+        if (key < n->key) {
+            links[depth++] = link;
+            link = &n->left;
+        } else if (key > n->key) {
+            links[depth++] = link;
+            link = &n->right;
         } else {
-            node* temp = min_node(n->right);
-            n->key = temp->key;
-            n->info = temp->info;
-            n->right = remove(n->right, temp->key);
+            inserted = false;
+            return n;
+        }
+    }
+    node* created = create_node(std::forward<K>(key), std::forward<Args>(args)...);
+    *link = created;
+    inserted = true;
+    retrace(links, depth, 1);
+    return created;
+    }
+
+    //remove in a single descent; a node with two children is replaced by relinking its
+    //in-order successor into its place, so no Key or Info is copied or assigned
+    bool unlink(const Key& key) {
+    node** links[max_height];
+    int depth = 0;
+    node** link = &root;
+    while (*link != nullptr && !(key == (*link)->key)) {
+        links[depth++] = link;
+        link = key < (*link)->key ? &(*link)->left : &(*link)->right;
+    }
+    node* target = *link;
+    if (target == nullptr)
+        return false;
+    if (target->left == nullptr || target->right == nullptr) {
+        *link = target->left ? target->left : target->right;
+    } else {
+        int target_depth = depth;
+        links[depth++] = link; //will hold the successor
+        node** succ_link = &target->right;
+        while ((*succ_link)->left != nullptr) {
+            links[depth++] = succ_link;
+            succ_link = &(*succ_link)->left;
         }
+        node* succ = *succ_link;
+        *succ_link = succ->right;
+        succ->left = target->left;
+        succ->right = target->right;
+        succ->height = target->height; //retrace starts from what this spot held
+        succ->count = target->count;
+        *link = succ;
+        if (depth > target_depth + 1)
+            links[target_depth + 1] = &succ->right; //was &target->right
     }
-    if (n == nullptr)
-        return n;
-    return rebalance(n);
+    destroy_node(target);
+    retrace(links, depth, -1);
+    return true;
     }
 
-    //to_vector
-    void to_vector(node* n, std::vector<std::pair<Key, Info>>& vec) const {
-    if (n != nullptr) {
-        to_vector(n->left, vec);
-        vec.emplace_back(n->key, n->info);
-        to_vector(n->right, vec);
+    //set operations (split/join based, as in Blelloch, Ferizovic and Sun, "Just Join for
+    //Parallel Ordered Sets"): every step costs O(log) of the size ratio of the subtrees it
+    //combines, so two trees of sizes m <= n are combined in O(m log(n/m + 1))
+
+    //l, k and r as one balanced tree, where the keys of l < k->key < the keys of r; walks
+    //down the spine of the higher tree until the heights are within one
+    node* join(node* l, node* k, node* r) {
+    if (height(l) > height(r) + 1)
+        return join_right(l, k, r);
+    if (height(r) > height(l) + 1)
+        return join_left(l, k, r);
+    k->left = l;
+    k->right = r;
+    update_height(k);
+    return k;
+    }
+
+    node* join_right(node* l, node* k, node* r) {
+    node* c = l->right;
+    if (height(c) <= height(r) + 1) {
+        k->left = c;
+        k->right = r;
+        update_height(k);
+        l->right = k;
+        if (height(k) <= height(l->left) + 1) {
+            update_height(l);
+            return l;
+        }
+        l->right = rotate_right(k);
+        return rotate_left(l);
+    }
+    l->right = join_right(c, k, r);
+    update_height(l);
+    return balance_factor(l) < -1 ? rotate_left(l) : l;
+    }
+
+    node* join_left(node* l, node* k, node* r) {
+    node* c = r->left;
+    if (height(c) <= height(l) + 1) {
+        k->left = l;
+        k->right = c;
+        update_height(k);
+        r->left = k;
+        if (height(k) <= height(r->right) + 1) {
+            update_height(r);
+            return r;
+        }
+        r->left = rotate_left(k);
+        return rotate_right(r);
     }
+    r->left = join_left(l, k, c);
+    update_height(r);
+    return balance_factor(r) > 1 ? rotate_right(r) : r;
+    }
+
+    //join of two trees without a middle node, the keys of l < the keys of r
+    node* join2(node* l, node* r) {
+    if (l == nullptr)
+        return r;
+    if (r == nullptr)
+        return l;
+    node* last;
+    node* rest = split_last(l, last);
+    return join(rest, last, r);
+    }
+
+    //takes the largest node out of t, returns the rest
+    node* split_last(node* t, node*& last) {
+    if (t->right == nullptr) {
+        last = t;
+        return t->left;
+    }
+    node* rest = split_last(t->right, last);
+    return join(t->left, t, rest);
+    }
+
+    //splits t into the keys < key (l), the node holding key, if any (mid, detached) and
+    //the keys > key (r)
+    void split(node* t, const Key& key, node*& l, node*& mid, node*& r) {
+    if (t == nullptr) {
+        l = mid = r = nullptr;
+        return;
+    }
+    node* tl = t->left;
+    node* tr = t->right;
+    if (key < t->key) {
+        node* rl;
+        split(tl, key, l, mid, rl);
+        r = join(rl, t, tr);
+    } else if (key > t->key) {
+        node* lr;
+        split(tr, key, lr, mid, r);
+        l = join(tl, t, lr);
+    } else {
+        t->left = t->right = nullptr;
+        update_height(t);
+        l = tl;
+        mid = t;
+        r = tr;
+    }
+    }
+
+    //shared state of one set operation, whose halves may run on several threads
+    struct set_op {
+        int fork_depth;           //recursion levels that may still start a thread
+        std::atomic<bool> failed; //a combiner threw: keep this tree's info from then on
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        explicit set_op(int levels) : fork_depth(levels), failed(false) {}
+    };
+
+    //subproblems smaller than this (in nodes) are not worth a thread
+    static const int parallel_cutoff = 1 << 14;
+
+    //thread levels for a set operation; nodes are freed from the threads, which is only
+    //safe with a stateless allocator (pool arenas are single threaded)
+    static int fork_levels(unsigned threads) {
+    if (!node_traits::is_always_equal::value)
+        return 0;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    int levels = 0;
+    while ((1u << levels) < threads)
+        ++levels;
+    return levels;
+    }
+
+    //a() on a new thread when fork is set and a thread can be had, b() here, then both done;
+    //the set operation steps do not throw
+    template <typename A, typename B>
+    static void fork_join(bool fork, A& a, B& b) {
+    std::thread worker;
+    if (fork) {
+        try {
+            worker = std::thread(std::ref(a));
+        } catch (const std::system_error&) {
+            //no thread now, a() runs here
+        }
+    }
+    if (!worker.joinable())
+        a();
+    b();
+    if (worker.joinable())
+        worker.join();
+    }
+
+    template <typename Combiner>
+    void combine_into(set_op& op, node* keep, node* other, Combiner& combine) {
+    if (!op.failed.load(std::memory_order_relaxed)) {
+        try {
+            keep->info = combine(static_cast<const Info&>(keep->info), static_cast<const Info&>(other->info));
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(op.error_mutex);
+            if (!op.error)
+                op.error = std::current_exception();
+            op.failed.store(true, std::memory_order_relaxed);
+        }
+    }
+    destroy_node(other);
+    }
+
+    template <typename Combiner>
+    node* unite(node* a, node* b, set_op& op, Combiner& combine, int depth) {
+    if (a == nullptr)
+        return b;
+    if (b == nullptr)
+        return a;
+    bool fork = depth < op.fork_depth && count(a) + count(b) >= parallel_cutoff;
+    node *l, *m, *r;
+    split(b, a->key, l, m, r);
+    node *al = a->left, *ar = a->right, *left, *right;
+    auto do_left = [&]() { left = unite(al, l, op, combine, depth + 1); };
+    auto do_right = [&]() { right = unite(ar, r, op, combine, depth + 1); };
+    fork_join(fork, do_left, do_right);
+    if (m)
+        combine_into(op, a, m, combine);
+    return join(left, a, right);
+    }
+
+    node* intersect(node* a, node* b, set_op& op, int depth) {
+    if (a == nullptr || b == nullptr) {
+        clear(a);
+        clear(b);
+        return nullptr;
+    }
+    bool fork = depth < op.fork_depth && count(a) + count(b) >= parallel_cutoff;
+    node *l, *m, *r;
+    split(b, a->key, l, m, r);
+    node *al = a->left, *ar = a->right, *left, *right;
+    auto do_left = [&]() { left = intersect(al, l, op, depth + 1); };
+    auto do_right = [&]() { right = intersect(ar, r, op, depth + 1); };
+    fork_join(fork, do_left, do_right);
+    if (m) {
+        destroy_node(m);
+        return join(left, a, right);
+    }
+    destroy_node(a);
+    return join2(left, right);
+    }
+
+    //a without the keys of b; a is split by the keys of b, the smaller tree in the reduce
+    //step, so the cost follows b's size
+    node* difference(node* a, node* b, set_op& op, int depth) {
+    if (a == nullptr || b == nullptr) {
+        clear(b);
+        return a;
+    }
+    bool fork = depth < op.fork_depth && count(a) + count(b) >= parallel_cutoff;
+    node *l, *m, *r;
+    split(a, b->key, l, m, r);
+    node *bl = b->left, *br = b->right, *left, *right;
+    auto do_left = [&]() { left = difference(l, bl, op, depth + 1); };
+    auto do_right = [&]() { right = difference(r, br, op, depth + 1); };
+    fork_join(fork, do_left, do_right);
+    destroy_node(b);
+    if (m)
+        destroy_node(m);
+    return join2(left, right);
+    }
+
+    //the nodes of other, ready to be linked into this tree: taken over when the allocators
+    //are equal, otherwise rebuilt from our allocator (O(m))
+    node* take_nodes(avl_tree& other) {
+    node* n;
+    if (alloc == other.alloc) {
+        n = other.root;
+    } else {
+        std::vector<std::pair<Key, Info>> entries;
+        other.to_vector(entries);
+        auto first = std::make_move_iterator(entries.begin());
+        n = build_sorted(first, std::make_move_iterator(entries.end()), static_cast<int>(entries.size()));
+        other.clear();
+    }
+    other.root = nullptr;
+    return n;
+    }
+
+public:
+    //an AVL tree of height h holds at least F(h+2)-1 nodes (F = Fibonacci), so with an int
+    //node count the height never exceeds 45; iterators keep their root-to-node path in a
+    //fixed array of this capacity instead of allocating
+    static const int max_height = 48;
+
+private:
+    //root-to-node path, the last entry is the current node, an empty path is end()
+    struct path {
+        node* nodes[max_height];
+        int depth;
+
+        path() : depth(0) {}
+        node* top() const { return depth ? nodes[depth - 1] : nullptr; }
+        void push(node* n) { nodes[depth++] = n; }
+        void descend_min(node* n) {
+        for (; n != nullptr; n = n->left) push(n);
+        }
+        void descend_max(node* n) {
+        for (; n != nullptr; n = n->right) push(n);
+        }
+        //in-order successor, O(1) amortized
+        void next() {
+        node* n = top();
+        if (n->right) {
+            descend_min(n->right);
+            return;
+        }
+        node* child;
+        do {
+            child = nodes[--depth];
+        } while (depth > 0 && top()->right == child);
+        }
+        //in-order predecessor, from end() this is the maximum of the tree
+        void prev(node* root) {
+        node* n = top();
+        if (n == nullptr) {
+            descend_max(root);
+            return;
+        }
+        if (n->left) {
+            descend_max(n->left);
+            return;
+        }
+        node* child;
+        do {
+            child = nodes[--depth];
+        } while (depth > 0 && top()->left == child);
+        }
+    };
+
+    //path to the first node whose key is >= key (strict: > key)
+    path bound(const Key& key, bool strict) const {
+    path p;
+    int found = 0; //depth just past the best candidate so far
+    node* current = root;
+    while (current != nullptr) {
+        p.push(current);
+        if (!strict && key == current->key) {
+            found = p.depth;
+            break;
+        } else if (key < current->key) {
+            found = p.depth;
+            current = current->left;
+        } else {
+            current = current->right;
+        }
+    }
+    p.depth = found;
+    return p;
     }
 
 public:
+    class const_iterator;
+
+    //bidirectional in-order iterator, invalidated by insert/remove
+    class iterator {
+        friend class avl_tree;
+        friend class const_iterator;
+        private:
+            path p;
+            node* root;
+            iterator(const path& pth, node* r) : p(pth), root(r) {}
+        public:
+            const Key& key() const { return p.top()->key; }
+            Info& info() const { return p.top()->info; }
+            iterator& operator++() { p.next(); return *this; }
+            iterator operator++(int) { iterator temp = *this; p.next(); return temp; }
+            iterator& operator--() { p.prev(root); return *this; }
+            iterator operator--(int) { iterator temp = *this; p.prev(root); return temp; }
+            bool operator==(const iterator& other) const { return p.top() == other.p.top(); }
+            bool operator!=(const iterator& other) const { return p.top() != other.p.top(); }
+    };
+
+    class const_iterator {
+        friend class avl_tree;
+        private:
+            path p;
+            node* root;
+            const_iterator(const path& pth, node* r) : p(pth), root(r) {}
+        public:
+            const_iterator(const iterator& other) : p(other.p), root(other.root) {}
+            const Key& key() const { return p.top()->key; }
+            const Info& info() const { return p.top()->info; }
+            const_iterator& operator++() { p.next(); return *this; }
+            const_iterator operator++(int) { const_iterator temp = *this; p.next(); return temp; }
+            const_iterator& operator--() { p.prev(root); return *this; }
+            const_iterator operator--(int) { const_iterator temp = *this; p.prev(root); return temp; }
+            bool operator==(const const_iterator& other) const { return p.top() == other.p.top(); }
+            bool operator!=(const const_iterator& other) const { return p.top() != other.p.top(); }
+    };
+
+    typedef Key key_type;
+    typedef Info mapped_type;
+    typedef Alloc allocator_type;
+
     avl_tree();
+    explicit avl_tree(const Alloc& a);
     avl_tree(const avl_tree& src);
+    avl_tree(avl_tree&& src) noexcept;
     ~avl_tree();
     avl_tree& operator=(const avl_tree& src);
+    avl_tree& operator=(avl_tree&& src);
+    template <typename It>
+    static avl_tree build_from_sorted(It first, It last); //O(n) from (key, info) pairs sorted by key
+    template <typename It>
+    avl_tree& assign_sorted(It first, It last); //replace contents, O(n)
     Info& operator[](const Key& key); //permitting updates
     const Info& operator[](const Key& key) const; //indexing without updates
     bool search(const Key& key, Info& info) const;
+    template <typename K, typename L = typename transparent_key<Key, K>::type>
+    Info& operator[](const K& key); //e.g. std::string_view for std::string keys, a Key is built only on a miss
+    template <typename K, typename L = typename transparent_key<Key, K>::type>
+    const Info& operator[](const K& key) const;
+    template <typename K, typename L = typename transparent_key<Key, K>::type>
+    bool search(const K& key, Info& info) const;
+    std::size_t search_batch(const Key* keys, std::size_t n, const Info** out) const; //out[i]: info of keys[i] or nullptr
+    std::size_t search_batch(const std::vector<Key>& keys, std::vector<const Info*>& out) const;
     avl_tree& insert(const Key& key, const Info& info);
+    avl_tree& insert(Key&& key, Info&& info);
+    template <typename It>
+    avl_tree& insert_batch(It first, It last); //insert or assign (key, info) pairs, the last of equal keys wins
+    template <typename K, typename I>
+    avl_tree& emplace(K&& key, I&& info); //insert or assign, built in place
+    template <typename... Args>
+    bool try_emplace(const Key& key, Args&&... args); //insert only if absent
+    template <typename... Args>
+    bool try_emplace(Key&& key, Args&&... args);
     avl_tree& remove(const Key& key);
     void clear();
     void print() const;
     void to_vector(std::vector<std::pair<Key, Info>>& vec) const;
+    void save(const std::string& path) const; //binary snapshot, see snapshot.hpp
+    avl_tree& load(const std::string& path); //replace contents from a snapshot, O(n)
     int size() const;
     bool empty() const;
+    bool select(int k, Key& key, Info& info) const; //k-th smallest, 0-based
+    int rank(const Key& key) const; //number of keys smaller than key
+
+    iterator begin() { path p; p.descend_min(root); return iterator(p, root); }
+    iterator end() { return iterator(path(), root); }
+    const_iterator begin() const { path p; p.descend_min(root); return const_iterator(p, root); }
+    const_iterator end() const { return const_iterator(path(), root); }
+    iterator lower_bound(const Key& key) { return iterator(bound(key, false), root); } //first key >= key
+    iterator upper_bound(const Key& key) { return iterator(bound(key, true), root); } //first key > key
+    const_iterator lower_bound(const Key& key) const { return const_iterator(bound(key, false), root); }
+    const_iterator upper_bound(const Key& key) const { return const_iterator(bound(key, true), root); }
+    template <typename Visitor>
+    void range(const Key& lo, const Key& hi, Visitor visit) const; //visit(key, info) for lo <= key <= hi
+    avl_tree split(const Key& key); //moves the keys >= key into the returned tree, O(log n)
+    static avl_tree join(avl_tree left, const Key& key, const Info& info, avl_tree right); //keys of left < key < keys of right, O(log n)
+    template <typename Combiner>
+    avl_tree& merge_with(avl_tree other, Combiner combine, unsigned threads = 0); //union, combine(info, other_info) for common keys
+    avl_tree& intersect(avl_tree other, unsigned threads = 0); //keep the keys that are in other too
+    avl_tree& difference(avl_tree other, unsigned threads = 0); //drop the keys that are in other
+    allocator_type get_allocator() const;
+    container_stats stats() const { return counters.snapshot(); } //all zeros for no_stats
+    void reset_stats() { counters.reset(); }
 };
 
-template <typename Key, typename Info>
-avl_tree<Key, Info>::avl_tree() : root(nullptr) {}
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>::avl_tree() : root(nullptr), alloc() {}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>::avl_tree(const Alloc& a) : root(nullptr), alloc(a) {}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>::avl_tree(const avl_tree& src)
+    : root(nullptr), alloc(node_traits::select_on_container_copy_construction(src.alloc)) {
+    root = clone(src.root);
+}
 
-template <typename Key, typename Info>
-avl_tree<Key, Info>::avl_tree(const avl_tree& src) : root(clone(src.root)) {}
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>::avl_tree(avl_tree&& src) noexcept : root(src.root), alloc(src.alloc) {
+    src.root = nullptr;
+}
 
-template <typename Key, typename Info>
-avl_tree<Key, Info>::~avl_tree() {
-    clear(root);
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>::~avl_tree() {
+    release_nodes();
 }
 
-template <typename Key, typename Info>
-avl_tree<Key, Info>& avl_tree<Key, Info>::operator=(const avl_tree& src) {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::operator=(const avl_tree& src) {
     if (this != &src) {
         clear();
         root = clone(src.root);
@@ -238,19 +886,64 @@ avl_tree<Key, Info>& avl_tree<Key, Info>::operator=(const avl_tree& src) {
     return *this;
 }
 
-template <typename Key, typename Info>
-Info& avl_tree<Key, Info>::operator[](const Key& key) {
-    node* n = find(key);
-    if (!n) {
-        root = insert(root, key, Info{});
-        n = find(key);
+//adopts the nodes when the allocator propagates or both are equal, otherwise clones them
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::operator=(avl_tree&& src) {
+    if (this != &src) {
+        clear();
+        bool propagate = node_traits::propagate_on_container_move_assignment::value;
+        if (propagate || alloc == src.alloc) {
+            if (propagate) alloc = src.alloc;
+            root = src.root;
+            src.root = nullptr;
+        } else {
+            root = clone(src.root);
+            src.clear();
+        }
+    }
+    return *this;
+}
+
+//the range holds pair-like (key, info) entries sorted by key; for equal keys the last one
+//wins, like repeated insert(); pass move iterators to move the entries into the tree
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename It>
+avl_tree<Key, Info, Alloc, Stats> avl_tree<Key, Info, Alloc, Stats>::build_from_sorted(It first, It last) {
+    avl_tree tree;
+    tree.assign_sorted(first, last);
+    return tree;
+}
+
+//one pass counts the distinct keys (and checks the order), a second builds the tree
+//bottom-up in in-order, so no comparisons against the tree and no rotations are needed
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename It>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::assign_sorted(It first, It last) {
+    int distinct = 0;
+    if (first != last) {
+        distinct = 1;
+        It prev = first;
+        for (It it = std::next(first); it != last; prev = it, ++it) {
+            if ((*it).first < (*prev).first)
+                throw std::invalid_argument("Input is not sorted by key");
+            if ((*prev).first < (*it).first)
+                ++distinct;
+        }
     }
-    return n->info;
+    clear();
+    root = build_sorted(first, last, distinct);
+    return *this;
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+Info& avl_tree<Key, Info, Alloc, Stats>::operator[](const Key& key) {
+    bool inserted;
+    return emplace_at(inserted, key)->info; //single descent, Info value-initialized on a miss
 }
 
 
-template <typename Key, typename Info>
-const Info& avl_tree<Key, Info>::operator[](const Key& key) const {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+const Info& avl_tree<Key, Info, Alloc, Stats>::operator[](const Key& key) const {
     const node* result = find(key); //type node is not revealed outside the interface, so encapsulation is preserved
     if (result) {
         return result->info;
@@ -259,8 +952,8 @@ const Info& avl_tree<Key, Info>::operator[](const Key& key) const {
     return dummy;
 }
 
-template <typename Key, typename Info>
-bool avl_tree<Key, Info>::search(const Key& key, Info& info) const {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+bool avl_tree<Key, Info, Alloc, Stats>::search(const Key& key, Info& info) const {
     const node* result = find(key);
     if (result) {
         info = result->info;
@@ -269,75 +962,476 @@ bool avl_tree<Key, Info>::search(const Key& key, Info& info) const {
     return false;
 }
 
-template <typename Key, typename Info>
-avl_tree<Key, Info>& avl_tree<Key, Info>::insert(const Key& key, const Info& info) {
-    root = insert(root, key, info);
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename K, typename L>
+Info& avl_tree<Key, Info, Alloc, Stats>::operator[](const K& key) {
+    bool inserted;
+    return emplace_at(inserted, L(key))->info;
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename K, typename L>
+const Info& avl_tree<Key, Info, Alloc, Stats>::operator[](const K& key) const {
+    const node* result = find(L(key));
+    if (result) {
+        return result->info;
+    }
+    static Info dummy;
+    return dummy;
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename K, typename L>
+bool avl_tree<Key, Info, Alloc, Stats>::search(const K& key, Info& info) const {
+    const node* result = find(L(key));
+    if (result) {
+        info = result->info;
+        return true;
+    }
+    return false;
+}
+
+//the batch is sorted first (through an index array), so neighbouring lanes share most of
+//their path and the upper levels stay in cache, then looked up batch_lanes keys at a time;
+//returns the number of keys found. The pointers are valid until the tree changes
+template <typename Key, typename Info, typename Alloc, typename Stats>
+std::size_t avl_tree<Key, Info, Alloc, Stats>::search_batch(const Key* keys, std::size_t n, const Info** out) const {
+    std::vector<std::size_t> order(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        order[i] = i;
+        out[i] = nullptr;
+    }
+    std::sort(order.begin(), order.end(), [keys](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < n; i += batch_lanes)
+        found += find_lanes(keys, order.data() + i, static_cast<int>(std::min<std::size_t>(batch_lanes, n - i)), out);
+    return found;
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+std::size_t avl_tree<Key, Info, Alloc, Stats>::search_batch(const std::vector<Key>& keys, std::vector<const Info*>& out) const {
+    out.resize(keys.size());
+    return search_batch(keys.data(), keys.size(), out.data());
+}
+
+//the batch is sorted (stably, so the last of equal keys wins as with repeated insert()),
+//built into a tree in O(m) and united with this one, O(m log(n/m + 1)) instead of m
+//separate descents
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename It>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::insert_batch(It first, It last) {
+    std::vector<std::pair<Key, Info>> batch;
+    for (; first != last; ++first)
+        batch.emplace_back((*first).first, (*first).second);
+    std::stable_sort(batch.begin(), batch.end(),
+                     [](const std::pair<Key, Info>& a, const std::pair<Key, Info>& b) { return a.first < b.first; });
+    avl_tree added(get_allocator());
+    added.assign_sorted(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+    return merge_with(std::move(added), [](const Info&, const Info& info) { return info; }, 1);
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::insert(const Key& key, const Info& info) {
+    bool inserted;
+    node* n = emplace_at(inserted, key, info);
+    if (!inserted)
+        n->info = info; //update existing key
     return *this;
 }
 
-template <typename Key, typename Info>
-avl_tree<Key, Info>& avl_tree<Key, Info>::remove(const Key& key) {
-    root = remove(root, key);
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::insert(Key&& key, Info&& info) {
+    return emplace(std::move(key), std::move(info));
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename K, typename I>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::emplace(K&& key, I&& info) {
+    bool inserted;
+    node* n = emplace_at(inserted, std::forward<K>(key), std::forward<I>(info));
+    if (!inserted)
+        n->info = std::forward<I>(info); //update existing key
     return *this;
 }
 
-template <typename Key, typename Info>
-void avl_tree<Key, Info>::clear() {
-    clear(root);
-    root = nullptr;
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename... Args>
+bool avl_tree<Key, Info, Alloc, Stats>::try_emplace(const Key& key, Args&&... args) {
+    bool inserted;
+    emplace_at(inserted, key, std::forward<Args>(args)...);
+    return inserted;
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename... Args>
+bool avl_tree<Key, Info, Alloc, Stats>::try_emplace(Key&& key, Args&&... args) {
+    bool inserted;
+    emplace_at(inserted, std::move(key), std::forward<Args>(args)...);
+    return inserted;
 }
 
-template <typename Key, typename Info>
-void avl_tree<Key, Info>::print() const {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::remove(const Key& key) {
+    unlink(key);
+    return *this;
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void avl_tree<Key, Info, Alloc, Stats>::clear() {
+    release_nodes();
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void avl_tree<Key, Info, Alloc, Stats>::print() const {
     print(root, 0);
 }
 
-template <typename Key, typename Info>
-void avl_tree<Key, Info>::to_vector(std::vector<std::pair<Key, Info>>& vec) const {
-    to_vector(root, vec);
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void avl_tree<Key, Info, Alloc, Stats>::to_vector(std::vector<std::pair<Key, Info>>& vec) const {
+    vec.reserve(vec.size() + static_cast<std::size_t>(size()));
+    for (const_iterator it = begin(), last = end(); it != last; ++it)
+        vec.emplace_back(it.key(), it.info());
+}
+
+//keys and infos in order; Key and Info must have a snapshot_codec (arithmetic types and
+//std::string)
+template <typename Key, typename Info, typename Alloc, typename Stats>
+void avl_tree<Key, Info, Alloc, Stats>::save(const std::string& path) const {
+    snapshot_write<Key, Info>(path, begin(), end(), static_cast<std::size_t>(size()));
+}
+
+//the file is mapped and validated, then its entries go straight into the bottom-up build
+//of assign_sorted; strings are copied once, from the mapping into the nodes
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::load(const std::string& path) {
+    mapped_file file(path);
+    snapshot_reader<Key, Info> reader(file.data(), file.size());
+    return assign_sorted(reader.begin(), reader.end());
 }
 
-template <typename Key, typename Info>
-int avl_tree<Key, Info>::size() const {
-    std::vector<std::pair<Key, Info>> vec;
-    to_vector(vec);
-    return static_cast<int>(vec.size());
+template <typename Key, typename Info, typename Alloc, typename Stats>
+int avl_tree<Key, Info, Alloc, Stats>::size() const {
+    return count(root); //subtree sizes are maintained, no traversal needed
 }
 
-template <typename Key, typename Info>
-bool avl_tree<Key, Info>::empty() const {
+template <typename Key, typename Info, typename Alloc, typename Stats>
+bool avl_tree<Key, Info, Alloc, Stats>::empty() const {
     return root == nullptr;
 }
 
-template <typename Key, typename Info>
-std::vector<std::pair<Key, Info>> maxinfo_selector(const avl_tree<Key, Info>& tree, unsigned cnt) {
-    std::vector<std::pair<Key, Info>> v;
-    tree.to_vector(v);
+//walks down using the subtree sizes, O(log n)
+template <typename Key, typename Info, typename Alloc, typename Stats>
+bool avl_tree<Key, Info, Alloc, Stats>::select(int k, Key& key, Info& info) const {
+    if (k < 0 || k >= size())
+        return false;
+    const node* current = root;
+    while (current != nullptr) {
+        int left = count(current->left);
+        if (k < left) {
+            current = current->left;
+        } else if (k > left) {
+            k -= left + 1;
+            current = current->right;
+        } else {
+            key = current->key;
+            info = current->info;
+            return true;
+        }
+    }
+    return false;
+}
+
+//also the in-order position of key when it is present, O(log n)
+template <typename Key, typename Info, typename Alloc, typename Stats>
+int avl_tree<Key, Info, Alloc, Stats>::rank(const Key& key) const {
+    int smaller = 0;
+    const node* current = root;
+    while (current != nullptr) {
+        if (key == current->key) {
+            return smaller + count(current->left);
+        } else if (key < current->key) {
+            current = current->left;
+        } else {
+            smaller += count(current->left) + 1;
+            current = current->right;
+        }
+    }
+    return smaller;
+}
 
-    std::sort(v.begin(), v.end(), [](auto& a, auto& b) { return a.second > b.second; });
+//in-order scan of [lo, hi] without temporary allocation, O(log n + k)
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename Visitor>
+void avl_tree<Key, Info, Alloc, Stats>::range(const Key& lo, const Key& hi, Visitor visit) const {
+    const_iterator last = end();
+    for (const_iterator it = lower_bound(lo); it != last && !(hi < it.key()); ++it)
+        visit(it.key(), it.info());
+}
 
-    if (cnt < v.size())
-        v.resize(cnt);
+//the returned tree shares this tree's allocator, its nodes are relinked
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats> avl_tree<Key, Info, Alloc, Stats>::split(const Key& key) {
+    node *l, *m, *r;
+    split(root, key, l, m, r);
+    root = l;
+    avl_tree right(get_allocator());
+    right.root = m ? join(nullptr, m, r) : r;
+    return right;
+}
 
-    return v;
+//the result uses left's allocator; right's nodes are relinked when the allocators are equal
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats> avl_tree<Key, Info, Alloc, Stats>::join(avl_tree left, const Key& key, const Info& info, avl_tree right) {
+    const node* n = left.root;
+    while (n && n->right)
+        n = n->right;
+    if (n && !(n->key < key))
+        throw std::invalid_argument("Left tree has keys not below the join key");
+    n = right.root;
+    while (n && n->left)
+        n = n->left;
+    if (n && !(key < n->key))
+        throw std::invalid_argument("Right tree has keys not above the join key");
+    node* k = left.create_node(key, info);
+    node* r = left.take_nodes(right);
+    left.root = left.join(left.root, k, r);
+    return left;
 }
 
-avl_tree<std::string, int> count_words(std::istream& is) {
-    avl_tree<std::string, int> word_count;
-    std::string word;
+//other's nodes are relinked into this tree (pass std::move(other) to avoid copying it
+//first); the halves run on up to `threads` threads (0: one per core) for large inputs
+//with a stateless allocator, so combine may be called concurrently. If combine throws,
+//the union still completes (common keys not combined yet keep this tree's info) and the
+//exception is rethrown afterwards
+template <typename Key, typename Info, typename Alloc, typename Stats>
+template <typename Combiner>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::merge_with(avl_tree other, Combiner combine, unsigned threads) {
+    node* b = take_nodes(other);
+    set_op op(fork_levels(threads));
+    root = unite(root, b, op, combine, 0);
+    if (op.error)
+        std::rethrow_exception(op.error);
+    return *this;
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::intersect(avl_tree other, unsigned threads) {
+    node* b = take_nodes(other);
+    set_op op(fork_levels(threads));
+    root = intersect(root, b, op, 0);
+    return *this;
+}
+
+template <typename Key, typename Info, typename Alloc, typename Stats>
+avl_tree<Key, Info, Alloc, Stats>& avl_tree<Key, Info, Alloc, Stats>::difference(avl_tree other, unsigned threads) {
+    node* b = take_nodes(other);
+    set_op op(fork_levels(threads));
+    root = difference(root, b, op, 0);
+    return *this;
+}
 
-    while (is >> word) {
-        std::string cleaned_word;
-        for (char c : word) {
-            if (std::isalnum(static_cast<unsigned char>(c))) {
-                cleaned_word += std::tolower(static_cast<unsigned char>(c));
+template <typename Key, typename Info, typename Alloc, typename Stats>
+typename avl_tree<Key, Info, Alloc, Stats>::allocator_type avl_tree<Key, Info, Alloc, Stats>::get_allocator() const {
+    return allocator_type(alloc);
+}
+
+//the cnt entries with the largest info, in descending info order (equal infos: smaller key
+//first); a bounded min-heap of pointers into the tree is kept during one in-order scan, so
+//this is O(n log cnt) time and O(cnt) memory, only the selected entries are copied.
+//Works with any ordered map with in-order key()/info() iterators (btree_map, frozen_map)
+template <typename Map>
+std::vector<std::pair<typename Map::key_type, typename Map::mapped_type>> maxinfo_selector(const Map& tree, unsigned cnt) {
+    typedef typename Map::key_type Key;
+    typedef typename Map::mapped_type Info;
+    typedef std::pair<const Key*, const Info*> entry;
+    //"a ranks below b": smaller info, or equal info and larger key
+    auto below = [](const entry& a, const entry& b) {
+        return *a.second < *b.second || (!(*b.second < *a.second) && *b.first < *a.first);
+    };
+    //std heaps keep the largest element on top, so comparing with reversed ranks keeps
+    //the lowest-ranked selected entry at heap.front()
+    auto heap_cmp = [&](const entry& a, const entry& b) { return below(b, a); };
+
+    std::vector<entry> heap;
+    heap.reserve(std::min<std::size_t>(cnt, static_cast<std::size_t>(tree.size())));
+    if (cnt > 0) {
+        for (auto it = tree.begin(); it != tree.end(); ++it) {
+            entry e(&it.key(), &it.info());
+            if (heap.size() < cnt) {
+                heap.push_back(e);
+                std::push_heap(heap.begin(), heap.end(), heap_cmp);
+            } else if (*heap.front().second < *e.second) { //keys arrive ascending, so ties never displace
+                std::pop_heap(heap.begin(), heap.end(), heap_cmp);
+                heap.back() = e;
+                std::push_heap(heap.begin(), heap.end(), heap_cmp);
             }
         }
+    }
+    std::sort_heap(heap.begin(), heap.end(), heap_cmp); //best first
+
+    std::vector<std::pair<Key, Info>> v;
+    v.reserve(heap.size());
+    for (const entry& e : heap)
+        v.emplace_back(*e.first, *e.second);
+    return v;
+}
+
+//byte classes for the word tokenizer, matching the "C" locale: 0 = dropped, 1 = separator
+//(isspace), anything else is the lowercased alphanumeric character itself
+struct word_char_table {
+    unsigned char cls[256];
+    constexpr word_char_table() : cls() {
+        for (int c = 0; c < 256; ++c) {
+            if (c == ' ' || (c >= '\t' && c <= '\r'))
+                cls[c] = 1;
+            else if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z'))
+                cls[c] = static_cast<unsigned char>(c);
+            else if (c >= 'A' && c <= 'Z')
+                cls[c] = static_cast<unsigned char>(c - 'A' + 'a');
+        }
+    }
+};
 
-        if (!cleaned_word.empty()) {
-            word_count[cleaned_word]++;
+//tokenizes [p, end) into `word`, a buffer reused across tokens and chunks; a word that
+//runs past `end` stays in the buffer until the next chunk (or the final flush). The
+//count_words functions fill an avl_tree by default, or any map with operator[] (btree_map)
+template <typename Map>
+void count_words_chunk(const char* p, const char* end, std::string& word, Map& word_count) {
+    static constexpr word_char_table table{};
+    for (; p != end; ++p) {
+        unsigned char c = table.cls[static_cast<unsigned char>(*p)];
+        if (c > 1) {
+            word.push_back(static_cast<char>(c));
+        } else if (c == 1 && !word.empty()) {
+            word_count[word]++; //single descent, the key is copied only on a miss
+            word.clear();
         }
     }
+}
+
+//words in a memory buffer, same rules as count_words(std::istream&)
+template <typename Map = avl_tree<std::string, int>>
+Map count_words(const char* data, std::size_t len) {
+    Map word_count;
+    std::string word;
+    count_words_chunk(data, data + len, word, word_count);
+    if (!word.empty())
+        word_count[word]++;
+    return word_count;
+}
 
+//reads the stream in chunk_size blocks instead of token by token
+template <typename Map = avl_tree<std::string, int>>
+Map count_words(std::istream& is, std::size_t chunk_size) {
+    Map word_count;
+    std::string word;
+    std::vector<char> buffer(chunk_size ? chunk_size : 1);
+    while (is) {
+        is.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        std::streamsize got = is.gcount();
+        if (got <= 0)
+            break;
+        count_words_chunk(buffer.data(), buffer.data() + got, word, word_count);
+    }
+    if (!word.empty())
+        word_count[word]++;
     return word_count;
+}
+
+//a token is a whitespace-separated run; its alphanumeric characters, lowercased, form the word
+template <typename Map = avl_tree<std::string, int>>
+Map count_words(std::istream& is) {
+    return count_words<Map>(is, 1 << 16);
+}
+
+//sums the word counts of several trees: a k-way merge of their in-order sequences followed
+//by the O(n) bulk build, so the result has the same contents as a serial count
+inline avl_tree<std::string, int> merge_word_counts(const std::vector<avl_tree<std::string, int>>& parts) {
+    typedef avl_tree<std::string, int>::const_iterator iter;
+    std::vector<iter> cur, last;
+    std::size_t total = 0;
+    for (const auto& part : parts) {
+        if (part.empty())
+            continue;
+        cur.push_back(part.begin());
+        last.push_back(part.end());
+        total += static_cast<std::size_t>(part.size());
+    }
+    //min-heap of part indices ordered by their current key
+    std::vector<std::size_t> heap;
+    for (std::size_t i = 0; i < cur.size(); ++i)
+        heap.push_back(i);
+    auto greater_key = [&](std::size_t a, std::size_t b) { return cur[b].key() < cur[a].key(); };
+    std::make_heap(heap.begin(), heap.end(), greater_key);
+
+    std::vector<std::pair<std::string, int>> merged;
+    merged.reserve(total);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater_key);
+        std::size_t i = heap.back();
+        if (!merged.empty() && merged.back().first == cur[i].key())
+            merged.back().second += cur[i].info();
+        else
+            merged.emplace_back(cur[i].key(), cur[i].info());
+        if (++cur[i] != last[i])
+            std::push_heap(heap.begin(), heap.end(), greater_key);
+        else
+            heap.pop_back();
+    }
+    return avl_tree<std::string, int>::build_from_sorted(
+        std::make_move_iterator(merged.begin()), std::make_move_iterator(merged.end()));
+}
+
+//splits the buffer into `threads` shards at whitespace, counts every shard into its own
+//tree on its own thread and merges the trees; threads == 0 uses every hardware thread
+inline avl_tree<std::string, int> count_words_parallel(const char* data, std::size_t len, unsigned threads = 0) {
+    static constexpr word_char_table table{};
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads == 1 || len < threads)
+        return count_words(data, len);
+
+    //shard borders are moved forward to the next separator so no word is cut in two
+    std::vector<std::size_t> border(threads + 1, len);
+    border[0] = 0;
+    for (unsigned t = 1; t < threads; ++t) {
+        std::size_t pos = std::max(border[t - 1], len / threads * t);
+        while (pos < len && table.cls[static_cast<unsigned char>(data[pos])] != 1)
+            ++pos;
+        border[t] = pos;
+    }
+
+    std::vector<avl_tree<std::string, int>> parts(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            try {
+                parts[t] = count_words(data + border[t], border[t + 1] - border[t]);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    for (auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+    return merge_word_counts(parts);
+}
+
+//reads the whole stream, then counts it in parallel
+inline avl_tree<std::string, int> count_words_parallel(std::istream& is, unsigned threads = 0) {
+    std::string text((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    return count_words_parallel(text.data(), text.size(), threads);
+}
+
+//maps the file where mmap is available, otherwise reads it in (see mapped_file);
+//threads != 1 counts the contents with count_words_parallel
+inline avl_tree<std::string, int> count_words_file(const std::string& path, unsigned threads = 1) {
+    mapped_file file(path);
+    file.advise_sequential();
+    return threads == 1 ? count_words(file.data(), file.size())
+                        : count_words_parallel(file.data(), file.size(), threads);
 }
\ No newline at end of file
@@ -3,6 +3,14 @@
 #include <cassert>
 #include <sstream>
 #include "avl_tree.hpp"
+#include "concurrent_avl_tree.hpp"
+#include "btree_map.hpp"
+#include "frozen_map.hpp"
+#include "persistent_avl_tree.hpp"
+#include "interned_avl_tree.hpp"
+#include <atomic>
+#include <map>
+#include <cmath>
 
 // --- simple test framework ---
 void run_test(const std::string& name, void (*test_func)()) {
@@ -289,6 +297,926 @@ void test_other_functions() {
     assert_equal(tree.size(), 2, "Tree size should be 2 after inserts");
 }
 
+void test_pool_allocator() {
+    typedef avl_tree<int, std::string, pool_allocator<std::pair<const int, std::string>>> pooled_tree;
+    pooled_tree tree;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 500; ++i) tree.insert(i, std::to_string(i));
+        for (int i = 0; i < 500; i += 2) tree.remove(i);
+        assert_equal(tree.size(), 250, "Pooled tree size after removals");
+        tree.clear(); // pool released in bulk
+        assert_true(tree.empty(), "Pooled tree should be empty after clear");
+    }
+    tree.insert(1, "one").insert(2, "two");
+    pooled_tree copy = tree;
+    tree.remove(1);
+    std::string val;
+    assert_true(copy.search(1, val) && val == "one", "Copy of pooled tree should be independent");
+
+    avl_tree<int, int, pool_allocator<std::pair<const int, int>>> trivial;
+    for (int i = 0; i < 1000; ++i) trivial[i] = i;
+    trivial.clear();
+    trivial[7] = 7;
+    assert_equal(trivial[7], 7, "Pooled tree reuse after bulk release");
+}
+
+void test_move_and_emplace() {
+    avl_tree<std::string, std::string> tree;
+    std::string key = "alpha";
+    std::string value(64, 'a');
+    tree.insert(std::move(key), std::move(value));
+    tree.emplace("beta", "b");
+    tree.emplace("beta", "bb"); // assigns existing key
+
+    assert_true(tree.try_emplace("gamma", 3, 'g'), "try_emplace should insert a missing key");
+    assert_true(!tree.try_emplace("gamma", "other"), "try_emplace should not overwrite");
+
+    std::string val;
+    assert_true(tree.search("alpha", val) && val == std::string(64, 'a'), "Moved insert value incorrect");
+    assert_true(tree.search("beta", val) && val == "bb", "emplace should assign existing key");
+    assert_true(tree.search("gamma", val) && val == "ggg", "try_emplace should build Info in place");
+
+    avl_tree<std::string, std::string> moved(std::move(tree));
+    assert_true(tree.empty(), "Moved-from tree should be empty");
+    assert_equal(moved.size(), 3, "Moved tree size incorrect");
+
+    avl_tree<std::string, std::string> assigned;
+    assigned.insert("x", "y");
+    assigned = std::move(moved);
+    assert_true(moved.empty(), "Move-assigned-from tree should be empty");
+    assert_equal(assigned.size(), 3, "Move-assigned tree size incorrect");
+    tree["reuse"] = "ok";
+    assert_true(tree["reuse"] == "ok", "Moved-from tree should stay usable");
+}
+
+void test_order_statistics() {
+    avl_tree<int, int> tree;
+    // insert 0, 3, 6, ... in a scrambled order
+    for (int i = 0; i < 300; ++i) tree.insert((i * 37) % 300 * 3, i);
+    assert_equal(tree.size(), 300, "Size with subtree counts");
+
+    int key = -1, info = -1;
+    for (int k = 0; k < 300; ++k) {
+        assert_true(tree.select(k, key, info), "select should succeed in range");
+        assert_equal(key, k * 3, "select returned wrong key");
+        assert_equal(tree.rank(k * 3), k, "rank of present key");
+        assert_equal(tree.rank(k * 3 + 1), k + 1, "rank of absent key");
+    }
+    assert_true(!tree.select(300, key, info), "select out of range");
+    assert_true(!tree.select(-1, key, info), "select negative");
+
+    for (int k = 0; k < 300; k += 2) tree.remove(k * 3);
+    tree[1] = 1; // insert through operator[]
+    tree.insert(1, 2); // update must not change sizes
+    assert_equal(tree.size(), 151, "Size after removes");
+    assert_true(tree.select(0, key, info) && key == 1, "select after changes");
+    assert_true(tree.select(1, key, info) && key == 3, "select after changes 2");
+    assert_equal(tree.rank(9), 2, "rank after removes");
+
+    avl_tree<int, int> copy = tree;
+    assert_equal(copy.size(), 151, "Copy keeps subtree counts");
+    assert_true(copy.select(150, key, info) && key == 897, "select on copy");
+}
+
+void test_iterators_and_ranges() {
+    avl_tree<int, int> tree;
+    for (int i = 0; i < 200; ++i) tree.insert((i * 71) % 200 * 2, i); // even keys 0..398
+
+    int expected = 0, visited = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        assert_equal(it.key(), expected, "Forward iteration order");
+        expected += 2;
+        ++visited;
+    }
+    assert_equal(visited, 200, "Forward iteration count");
+
+    expected = 398;
+    auto it = tree.end();
+    do {
+        --it;
+        assert_equal(it.key(), expected, "Backward iteration order");
+        expected -= 2;
+    } while (it != tree.begin());
+
+    assert_equal(tree.lower_bound(10).key(), 10, "lower_bound on present key");
+    assert_equal(tree.lower_bound(11).key(), 12, "lower_bound on absent key");
+    assert_equal(tree.upper_bound(10).key(), 12, "upper_bound on present key");
+    assert_true(tree.lower_bound(399) == tree.end(), "lower_bound past the end");
+    assert_true(tree.upper_bound(398) == tree.end(), "upper_bound past the end");
+    assert_equal(tree.lower_bound(-5).key(), 0, "lower_bound before the start");
+
+    tree.lower_bound(20).info() = -1; // iterator allows updates
+    int val;
+    assert_true(tree.search(20, val) && val == -1, "Update through iterator");
+
+    int sum = 0, cnt = 0;
+    const avl_tree<int, int>& c_tree = tree;
+    c_tree.range(15, 31, [&](const int& k, const int&) { sum += k; ++cnt; });
+    assert_equal(cnt, 8, "range count");
+    assert_equal(sum, 16 + 18 + 20 + 22 + 24 + 26 + 28 + 30, "range sum");
+    cnt = 0;
+    c_tree.range(401, 500, [&](const int&, const int&) { ++cnt; });
+    assert_equal(cnt, 0, "empty range");
+
+    avl_tree<int, int> empty;
+    assert_true(empty.begin() == empty.end(), "Empty tree begin == end");
+}
+
+void test_build_from_sorted() {
+    std::vector<std::pair<int, std::string>> input;
+    for (int i = 0; i < 1000; ++i) input.push_back({i * 2, std::to_string(i)});
+    auto tree = avl_tree<int, std::string>::build_from_sorted(input.begin(), input.end());
+
+    assert_equal(tree.size(), 1000, "Bulk build size");
+    int k = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++k)
+        assert_equal(it.key(), k * 2, "Bulk build order");
+    std::string val;
+    assert_true(tree.search(998, val) && val == "499", "Bulk build search");
+
+    // the built tree behaves like any other
+    tree.insert(1, "one");
+    tree.remove(0);
+    assert_equal(tree.size(), 1000, "Bulk build then modify");
+    int key = 0;
+    assert_true(tree.select(0, key, val) && key == 1, "Bulk build then select");
+
+    // equal keys keep the last entry, like repeated insert
+    std::vector<std::pair<int, int>> dups = {{1, 1}, {1, 2}, {2, 3}, {3, 4}, {3, 5}, {3, 6}};
+    avl_tree<int, int> dtree;
+    dtree.insert(99, 99);
+    dtree.assign_sorted(dups.begin(), dups.end());
+    assert_equal(dtree.size(), 3, "Duplicates collapse");
+    assert_equal(dtree[1], 2, "Last duplicate wins (1)");
+    assert_equal(dtree[3], 6, "Last duplicate wins (3)");
+    int dummy;
+    assert_true(!dtree.search(99, dummy), "assign_sorted replaces contents");
+
+    // unsorted input is rejected
+    std::vector<std::pair<int, int>> unsorted = {{2, 0}, {1, 0}};
+    bool thrown = false;
+    try {
+        dtree.assign_sorted(unsorted.begin(), unsorted.end());
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert_true(thrown, "Unsorted input should throw");
+
+    // move iterators move the payloads in
+    auto moved = avl_tree<int, std::string>::build_from_sorted(
+        std::make_move_iterator(input.begin()), std::make_move_iterator(input.end()));
+    assert_equal(moved.size(), 1000, "Bulk build from move iterators");
+    assert_true(moved.search(10, val) && val == "5", "Moved payload present");
+
+    std::vector<std::pair<int, int>> none;
+    auto empty = avl_tree<int, int>::build_from_sorted(none.begin(), none.end());
+    assert_true(empty.empty(), "Bulk build from an empty range");
+}
+
+// counts copies and assignments, which remove() must not need
+struct counted_info {
+    static int copies;
+    int value;
+    counted_info(int v = 0) : value(v) {}
+    counted_info(const counted_info& other) : value(other.value) { ++copies; }
+    counted_info& operator=(const counted_info& other) { value = other.value; ++copies; return *this; }
+};
+int counted_info::copies = 0;
+
+void test_iterative_updates() {
+    avl_tree<int, int> tree;
+    std::map<int, int> reference;
+    unsigned int state = 7;
+    for (int step = 0; step < 20000; ++step) {
+        state = state * 1103515245u + 12345u;
+        int key = (state >> 8) % 500;
+        if ((state >> 20) % 3 == 0) {
+            tree.remove(key);
+            reference.erase(key);
+        } else {
+            tree.insert(key, step);
+            reference[key] = step;
+        }
+        if (step % 1000 == 0) {
+            // select() walks the subtree counts, so this checks every count on the way
+            int k = 0;
+            for (const auto& entry : reference) {
+                int key_at = 0, info_at = 0;
+                assert_true(tree.select(k, key_at, info_at) && key_at == entry.first && info_at == entry.second,
+                            "select should see the same entries as std::map");
+                ++k;
+            }
+            assert_equal(tree.size(), (int)reference.size(), "size after mixed updates");
+        }
+    }
+    std::vector<std::pair<int, int>> got;
+    tree.to_vector(got);
+    assert_true(got == std::vector<std::pair<int, int>>(reference.begin(), reference.end()),
+                "contents after mixed updates");
+
+    avl_tree<int, counted_info> counted;
+    for (int i = 0; i < 100; ++i) counted.emplace(i, counted_info(i));
+    counted_info::copies = 0;
+    for (int i = 0; i < 100; i += 2) counted.remove(i); // inner nodes are relinked, not overwritten
+    assert_equal(counted_info::copies, 0, "remove should not copy or assign Info");
+    assert_equal(counted.size(), 50, "size after removing the even keys");
+
+    // a sorted insert sequence builds a tree far larger than any recursion would like to walk
+    avl_tree<int, int> big;
+    const int n = 200000;
+    for (int i = 0; i < n; ++i) big.insert(i, i);
+    avl_tree<int, int> big_copy(big);
+    big.clear();
+    assert_true(big.empty() && big_copy.size() == n && big_copy.rank(n - 1) == n - 1, "copy and clear of a large tree");
+}
+
+// Info whose copies can be made to fail, to check that a failed write changes nothing
+struct fragile_info {
+    static int copies_left; // -1: never fail
+    int value;
+    fragile_info(int v = 0) : value(v) {}
+    fragile_info(const fragile_info& other) : value(other.value) {
+        if (copies_left == 0) throw std::runtime_error("copy failed");
+        if (copies_left > 0) --copies_left;
+    }
+    fragile_info& operator=(const fragile_info& other) { value = other.value; return *this; }
+};
+int fragile_info::copies_left = -1;
+
+void test_concurrent_tree_single_thread() {
+    concurrent_avl_tree<int, int> tree;
+    avl_tree<int, int> reference;
+    unsigned int state = 99;
+    for (int step = 0; step < 5000; ++step) {
+        state = state * 1103515245u + 12345u;
+        int key = (state >> 8) % 700;
+        if ((state >> 20) % 3 == 0) {
+            int dummy;
+            bool present = reference.search(key, dummy);
+            assert_true(tree.remove(key) == present, "remove should report whether the key was present");
+            reference.remove(key);
+        } else {
+            tree.insert(key, step);
+            reference.insert(key, step);
+        }
+    }
+    std::vector<std::pair<int, int>> got, expected;
+    tree.to_vector(got);
+    reference.to_vector(expected);
+    assert_true(got == expected, "concurrent tree should hold the same pairs as avl_tree");
+    assert_equal(tree.size(), reference.size(), "concurrent tree size");
+    int val = 0;
+    assert_true(tree.search(expected[0].first, val) && val == expected[0].second, "search existing");
+    assert_true(!tree.contains(-1), "contains missing");
+
+    concurrent_avl_tree<int, int> copy(tree);
+    tree.clear();
+    assert_true(tree.empty() && copy.size() == reference.size(), "copy should survive clear of the source");
+    tree = copy;
+    copy.insert(-5, 5);
+    assert_true(!tree.contains(-5) && tree.size() == reference.size(), "assigned copy should be independent");
+
+    // a write that throws halfway leaves the published tree as it was
+    concurrent_avl_tree<int, fragile_info> fragile;
+    for (int i = 0; i < 64; ++i) fragile.insert(i, fragile_info(i));
+    bool thrown = false;
+    fragile_info::copies_left = 2; // the path copy of the third node fails
+    try {
+        fragile.insert(1000, fragile_info(1000));
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    fragile_info::copies_left = -1;
+    assert_true(thrown, "failing copy should propagate");
+    assert_equal(fragile.size(), 64, "failed insert should not change the size");
+    int expected_key = 0;
+    bool in_order = true;
+    fragile.for_each([&](int k, const fragile_info& info) { in_order = in_order && k == expected_key++ && info.value == k; });
+    assert_true(in_order && !fragile.contains(1000), "failed insert should not change the contents");
+    fragile.insert(1000, fragile_info(1000));
+    assert_true(fragile.contains(1000), "writes should work after a failed one");
+}
+
+void test_concurrent_tree_readers() {
+    // even keys never change; odd keys are inserted and removed by the writers, always with info == 2 * key
+    concurrent_avl_tree<int, int> tree;
+    const int keys = 2000;
+    for (int k = 0; k < keys; k += 2) tree.insert(k, 2 * k);
+    std::atomic<bool> done(false);
+    std::atomic<int> errors(0);
+    std::atomic<long> reads(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < 4; ++r) {
+        threads.emplace_back([&, r] {
+            unsigned int state = 17 + r;
+            long local = 0;
+            while (!done.load()) {
+                state = state * 1103515245u + 12345u;
+                int key = (state >> 8) % keys;
+                int val = -1;
+                bool found = tree.search(key, val);
+                if ((key % 2 == 0 && !found) || (found && val != 2 * key)) errors++;
+                if (++local % 512 == 0) {
+                    int prev = -1;
+                    bool sorted = true;
+                    tree.for_each([&](int k, int) { sorted = sorted && k > prev; prev = k; });
+                    if (!sorted) errors++;
+                }
+            }
+            reads += local;
+        });
+    }
+    for (int w = 0; w < 2; ++w) {
+        threads.emplace_back([&, w] {
+            for (int round = 0; round < 3; ++round) {
+                for (int k = 1 + 2 * w; k < keys; k += 4) tree.insert(k, 2 * k);
+                for (int k = 1 + 2 * w; k < keys; k += 4) tree.remove(k);
+            }
+        });
+    }
+    for (std::size_t t = 4; t < threads.size(); ++t) threads[t].join();
+    done = true;
+    for (std::size_t t = 0; t < 4; ++t) threads[t].join();
+
+    assert_equal(errors.load(), 0, "readers should only see consistent versions");
+    assert_true(reads.load() > 0, "readers should have run");
+    assert_equal(tree.size(), keys / 2, "only the stable keys should remain");
+}
+
+void test_btree_map() {
+    btree_map<int, int> tree;
+    avl_tree<int, int> reference;
+    unsigned int state = 11;
+    for (int step = 0; step < 30000; ++step) {
+        state = state * 1103515245u + 12345u;
+        int key = (state >> 8) % 2000;
+        switch ((state >> 20) % 4) {
+        case 0:
+            tree.remove(key);
+            reference.remove(key);
+            break;
+        case 1:
+            tree[key] += step;
+            reference[key] += step;
+            break;
+        default:
+            tree.insert(key, step);
+            reference.insert(key, step);
+        }
+    }
+    std::vector<std::pair<int, int>> got, expected;
+    tree.to_vector(got);
+    reference.to_vector(expected);
+    assert_true(got == expected, "btree_map should hold the same pairs as avl_tree");
+    assert_equal(tree.size(), reference.size(), "btree_map size");
+    int val = 0, missing = 0;
+    for (const auto& entry : expected)
+        missing += tree.search(entry.first, val) && val == entry.second ? 0 : 1;
+    assert_equal(missing, 0, "search should find every entry");
+    assert_true(!tree.contains(-1) && !tree.try_emplace(expected[0].first, 0), "missing key and present key");
+
+    btree_map<int, int> copy(tree);
+    tree.clear();
+    btree_map<int, int> moved(std::move(copy));
+    got.clear();
+    moved.to_vector(got);
+    assert_true(tree.empty() && copy.empty() && got == expected, "copy and move keep the entries");
+
+    std::vector<std::pair<int, int>> sorted = {{1, 1}, {2, 2}, {2, 3}, {5, 5}};
+    auto built = btree_map<int, int>::build_from_sorted(sorted.begin(), sorted.end());
+    assert_true(built.size() == 3 && built[2] == 3 && built[5] == 5, "build_from_sorted keeps the last duplicate");
+
+    // large keys give the smallest nodes, so splits and merges happen on every few updates
+    btree_map<std::string, fragile_info> fragile;
+    for (int i = 0; i < 300; ++i) fragile.insert("key" + std::to_string(1000 + i), fragile_info(i));
+    bool thrown = false;
+    fragile_info::copies_left = 0;
+    try {
+        fragile.insert("key1150x", fragile_info(-1));
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    fragile_info::copies_left = -1;
+    int expected_value = 0;
+    bool in_order = true;
+    for (auto it = fragile.begin(); it != fragile.end(); ++it)
+        in_order = in_order && it.info().value == expected_value++;
+    assert_true(thrown && in_order && fragile.size() == 300, "failed insert should not change the map");
+    for (int i = 0; i < 300; i += 2) fragile.remove("key" + std::to_string(1000 + i));
+    assert_true(fragile.size() == 150 && fragile.contains("key1001") && !fragile.contains("key1000"), "removes on small nodes");
+}
+
+void test_frozen_map() {
+    avl_tree<int, int> tree;
+    for (int i = 0; i < 1000; ++i) tree.insert(i * 3, i);
+    frozen_map<int, int> frozen(tree);
+    std::vector<std::pair<int, int>> got, expected;
+    frozen.to_vector(got);
+    tree.to_vector(expected);
+    assert_true(got == expected && frozen.size() == 1000, "frozen_map should iterate in key order");
+    int found = 0, val = 0;
+    for (int k = -1; k < 3001; ++k)
+        found += frozen.search(k, val) && val == k / 3 ? 1 : 0;
+    assert_equal(found, 1000, "frozen_map should find exactly the stored keys");
+    assert_equal(frozen[2997], 999, "indexing the last key");
+
+    // every size up to a few full levels, so the walk ends on both sides of incomplete levels
+    bool all = true;
+    for (int n = 0; n < 70; ++n) {
+        btree_map<int, int> small;
+        for (int i = 0; i < n; ++i) small.insert(2 * i, i);
+        frozen_map<int, int> snapshot(small);
+        std::vector<std::pair<int, int>> a, b;
+        snapshot.to_vector(a);
+        small.to_vector(b);
+        all = all && a == b;
+        for (int k = -1; k <= 2 * n; ++k)
+            all = all && snapshot.contains(k) == (k >= 0 && k % 2 == 0 && k < 2 * n);
+    }
+    assert_true(all, "frozen_map of every small size");
+}
+
+void test_helpers_on_other_maps() {
+    avl_tree<int, int> tree;
+    btree_map<int, int> btree;
+    for (int i = 0; i < 500; ++i) {
+        tree.insert(i, (i * 37) % 101);
+        btree.insert(i, (i * 37) % 101);
+    }
+    auto expected = maxinfo_selector(tree, 25);
+    assert_true(maxinfo_selector(btree, 25) == expected, "maxinfo_selector on btree_map");
+    assert_true(maxinfo_selector(frozen_map<int, int>(btree), 25) == expected, "maxinfo_selector on frozen_map");
+
+    std::string text = "The quick brown fox. the LAZY dog; the end, fox!";
+    std::istringstream in1(text), in2(text);
+    auto words = count_words(in1);
+    auto btree_words = count_words<btree_map<std::string, int>>(in2);
+    std::vector<std::pair<std::string, int>> a, b;
+    words.to_vector(a);
+    btree_words.to_vector(b);
+    assert_true(a == b && btree_words["the"] == 3 && btree_words["fox"] == 2, "count_words into btree_map");
+}
+
+void test_stats_policy() {
+    typedef avl_tree<int, int, std::allocator<std::pair<const int, int>>, atomic_stats> counted_tree;
+    counted_tree tree;
+    tree.insert(1, 1).insert(2, 2).insert(3, 3); //one left rotation at the root
+    container_stats s = tree.stats();
+    assert_true(s.allocations == 3 && s.rotations == 1, "inserts and rotation counted");
+
+    int info = 0;
+    assert_true(tree.search(2, info) && info == 2, "search root");
+    assert_true(!tree.search(4, info), "search missing key");
+    s = tree.stats();
+    assert_true(s.searches == 2 && s.search_steps == 1 + 2 && s.max_search_steps == 2, "search path lengths");
+
+    for (int i = 4; i <= 1000; ++i)
+        tree.insert(i, i);
+    s = tree.stats();
+    assert_true(s.allocations == 1000 && s.rotations > 900, "sequential inserts rotate");
+    tree.reset_stats();
+    for (int i = 1; i <= 1000; ++i)
+        tree.search(i, info);
+    s = tree.stats();
+    assert_true(s.searches == 1000 && s.max_search_steps <= 10 && s.rotations == 0, "balanced lookups");
+
+    counted_tree copy(tree); //counters start at zero, the clone allocates
+    assert_true(copy.stats().allocations == 1000 && copy.stats().searches == 0, "copy counters");
+    tree.remove(500);
+    tree.clear();
+    assert_true(tree.stats().frees == 1000, "remove and clear counted");
+
+    //bulk release of an exclusive pool still reports every node
+    avl_tree<int, int, pool_allocator<std::pair<const int, int>>, atomic_stats> pooled;
+    for (int i = 0; i < 100; ++i)
+        pooled.insert(i, i);
+    pooled.clear();
+    assert_true(pooled.stats().frees == 100, "pool release counted");
+
+    avl_tree<int, int> plain;
+    plain.insert(1, 1).insert(2, 2).insert(3, 3);
+    assert_true(plain.stats().rotations == 0 && plain.stats().allocations == 0, "default policy keeps nothing");
+}
+
+//entry range for snapshot_write whose info() throws once the entries are being written
+struct throwing_snapshot_it {
+    int i;
+    int* calls;
+    int key() const { return i; }
+    int info() const {
+        if (++*calls > 12) //the sizing pass makes 10 calls
+            throw std::length_error("entry too long");
+        return i;
+    }
+    throwing_snapshot_it& operator++() { ++i; return *this; }
+    bool operator!=(const throwing_snapshot_it& other) const { return i != other.i; }
+};
+
+void test_snapshot_save_load() {
+    bool thrown = false;
+    const std::string path = "avl_snapshot_test.bin";
+    std::istringstream text("the quick brown fox jumps over the lazy dog the end");
+    avl_tree<std::string, int> words = count_words(text);
+    words.insert("", 7); //empty strings survive too
+    words.save(path);
+
+    avl_tree<std::string, int> loaded;
+    loaded.insert("stale", 1);
+    loaded.load(path);
+    std::vector<std::pair<std::string, int>> a, b;
+    words.to_vector(a);
+    loaded.to_vector(b);
+    assert_true(a == b, "load restores every entry");
+    assert_true(loaded.size() == words.size() && !loaded.empty(), "size after load");
+
+    { //views are closed before the file is replaced: Windows cannot replace a mapped file
+        snapshot_view<std::string, int> view(path);
+        int info = 0;
+        assert_true(view.size() == words.size(), "view size");
+        assert_true(view.search("the", info) && info == 3, "view finds a key");
+        assert_true(view.search("", info) && info == 7, "view finds the empty key");
+        assert_true(!view.search("cat", info) && !view.contains("zzz") && view.contains("dog"), "view misses");
+    }
+
+    //numeric keys, an empty tree and a large one
+    avl_tree<int, double> numbers;
+    numbers.save(path);
+    numbers.insert(1, 1.0);
+    numbers.load(path);
+    assert_true(numbers.empty(), "empty snapshot");
+    for (int i = 0; i < 100000; ++i)
+        numbers.insert(i * 3, i * 0.5);
+    numbers.save(path);
+    avl_tree<int, double> big;
+    big.load(path);
+    {
+        snapshot_view<int, double> big_view(path);
+        bool same = big.size() == 100000 && big_view.size() == 100000;
+        for (int i = 0; same && i < 300000; i += 7) {
+            double x = -1, y = -1;
+            bool in_tree = big.search(i, x);
+            same = in_tree == (i % 3 == 0) && big_view.search(i, y) == in_tree && x == y;
+        }
+        assert_true(same, "large snapshot round trip");
+    }
+
+    //an encoder that throws halfway leaves the old snapshot in place and no temporary file
+    int calls = 0;
+    thrown = false;
+    try {
+        snapshot_write<int, int>(path, throwing_snapshot_it{0, &calls}, throwing_snapshot_it{10, &calls}, 10);
+    } catch (const std::length_error&) { thrown = true; }
+    assert_true(thrown && !std::ifstream(path + ".tmp"), "temporary file removed");
+    avl_tree<int, double> kept;
+    kept.load(path);
+    assert_true(kept.size() == 100000, "old snapshot kept");
+
+    //mismatched types and damaged files are rejected
+    thrown = false;
+    try { avl_tree<std::string, int>().load(path); } catch (const std::runtime_error&) { thrown = true; }
+    assert_true(thrown, "type tags checked");
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(1000);
+        f.put('\x55');
+    }
+    thrown = false;
+    try { big.load(path); } catch (const std::runtime_error&) { thrown = true; }
+    assert_true(thrown && big.size() == 100000, "checksum checked, tree kept");
+    thrown = false;
+    try { snapshot_view<int, double> broken(path); } catch (const std::runtime_error&) { thrown = true; }
+    assert_true(thrown, "view checks the checksum");
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f << "AVLSNAP";
+    }
+    thrown = false;
+    try { big.load(path); } catch (const std::runtime_error&) { thrown = true; }
+    assert_true(thrown, "truncated file rejected");
+    std::remove(path.c_str());
+}
+
+void test_persistent_avl_tree() {
+    typedef persistent_avl_tree<int, int, std::allocator<std::pair<const int, int>>, atomic_stats> ptree;
+    ptree base;
+    for (int i = 0; i < 10000; ++i)
+        base.insert(i * 2, i);
+    assert_true(base.stats().allocations == 10000, "an unshared tree updates in place");
+    assert_true(base.size() == 10000 && base[198] == 99, "contents");
+
+    //20 versions, each a copy of the previous one plus a few changes
+    std::vector<ptree> versions;
+    std::vector<std::map<int, int>> expected;
+    std::map<int, int> model;
+    for (int i = 0; i < 10000; ++i)
+        model[i * 2] = i;
+    ptree current = base;
+    std::uint64_t seed = 7;
+    for (int v = 0; v < 20; ++v) {
+        for (int k = 0; k < 5; ++k) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            int key = static_cast<int>((seed >> 33) % 20000);
+            if ((seed >> 20) & 1) {
+                current.insert(key, v);
+                model[key] = v;
+            } else {
+                current.remove(key);
+                model.erase(key);
+            }
+        }
+        versions.push_back(current);
+        expected.push_back(model);
+    }
+    assert_true(versions[3].same_version(versions[3]) && !versions[3].same_version(versions[4]), "versions differ");
+    std::uint64_t nodes = base.stats().allocations + current.stats().allocations;
+    assert_true(nodes < 10000 + 20 * 5 * 2 * 20, "versions share their nodes");
+
+    bool same = true;
+    for (std::size_t v = 0; v < versions.size(); ++v) {
+        std::vector<std::pair<int, int>> got;
+        versions[v].to_vector(got);
+        same = same && got == std::vector<std::pair<int, int>>(expected[v].begin(), expected[v].end());
+    }
+    std::vector<std::pair<int, int>> original;
+    base.to_vector(original);
+    same = same && original.size() == 10000 && original[5000].first == 10000;
+    assert_true(same, "every version keeps its contents");
+
+    //a remove of a missing key copies nothing
+    ptree copy = versions[0];
+    copy.reset_stats();
+    copy.remove(-1);
+    assert_true(copy.stats().allocations == 0 && copy.same_version(versions[0]), "missing key");
+    copy.remove(0).insert(20001, 1);
+    assert_true(copy.stats().allocations > 0 && !copy.contains(0) && versions[0].contains(0), "copy on write");
+
+    //versions dropped on other threads
+    std::vector<std::thread> workers;
+    std::atomic<int> found(0);
+    for (int t = 0; t < 4; ++t) {
+        ptree mine = versions[t];
+        workers.emplace_back([mine, &found]() mutable {
+            int info = 0;
+            if (mine.search(2, info)) found.fetch_add(1);
+            mine.insert(-5, 5);
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    versions.clear();
+    current.clear();
+    assert_true(found.load() == 4 && base.size() == 10000 && !base.contains(-5), "threads share versions");
+
+    //built from another map
+    avl_tree<int, int> tree;
+    for (int i = 0; i < 100; ++i)
+        tree.insert(i, i * i);
+    persistent_avl_tree<int, int> built(tree);
+    std::vector<std::pair<int, int>> a, b;
+    tree.to_vector(a);
+    built.to_vector(b);
+    assert_true(a == b && built[9] == 81, "built from avl_tree");
+    static_assert(!std::is_constructible<persistent_avl_tree<int, int>, int>::value &&
+                  !std::is_constructible<persistent_avl_tree<int, int>, std::vector<int>>::value,
+                  "only maps build a persistent_avl_tree");
+}
+
+//entries, order statistics and the AVL height bound (seen through the longest lookup path)
+template <typename Tree>
+bool matches_model(const Tree& tree, const std::map<int, int>& model) {
+    std::vector<std::pair<int, int>> got;
+    tree.to_vector(got);
+    if (got != std::vector<std::pair<int, int>>(model.begin(), model.end()) || tree.size() != static_cast<int>(model.size()))
+        return false;
+    int key = 0, info = 0, k = 0;
+    for (const auto& entry : model) {
+        if (!tree.select(k++, key, info) || key != entry.first || tree.rank(entry.first) != k - 1)
+            return false;
+        tree.search(entry.first, info);
+    }
+    double bound = 1.45 * std::log2(model.size() + 2.0) + 1;
+    return model.empty() || tree.stats().max_search_steps <= bound;
+}
+
+void test_set_operations() {
+    typedef avl_tree<int, int, std::allocator<std::pair<const int, int>>, atomic_stats> tree_type;
+    std::uint64_t seed = 12345;
+    auto next = [&seed](int range) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<int>((seed >> 33) % static_cast<std::uint64_t>(range));
+    };
+    //sizes from empty to very unequal, so join walks long spines
+    const int sizes[][2] = {{0, 0}, {0, 50}, {50, 0}, {1, 1000}, {1000, 3}, {200, 200}, {5000, 40}, {3000, 3000}};
+    bool ok = true;
+    for (const auto& sz : sizes) {
+        tree_type a, b;
+        std::map<int, int> ma, mb;
+        for (int i = 0; i < sz[0]; ++i) { int k = next(4 * (sz[0] + sz[1]) + 1); a.insert(k, i); ma[k] = i; }
+        for (int i = 0; i < sz[1]; ++i) { int k = next(4 * (sz[0] + sz[1]) + 1); b.insert(k, i); mb[k] = i; }
+
+        tree_type u(a);
+        u.merge_with(tree_type(b), [](int x, int y) { return x + y; });
+        std::map<int, int> mu = ma;
+        for (const auto& e : mb)
+            mu[e.first] = ma.count(e.first) ? ma[e.first] + e.second : e.second;
+        ok = ok && matches_model(u, mu);
+
+        tree_type in(a);
+        in.intersect(tree_type(b));
+        std::map<int, int> mi;
+        for (const auto& e : ma)
+            if (mb.count(e.first)) mi.insert(e);
+        ok = ok && matches_model(in, mi);
+
+        tree_type d(a);
+        d.difference(tree_type(b));
+        std::map<int, int> md;
+        for (const auto& e : ma)
+            if (!mb.count(e.first)) md.insert(e);
+        ok = ok && matches_model(d, md);
+
+        //split at every tenth key and join back
+        for (int cut = -1; cut <= 4 * (sz[0] + sz[1]) + 1; cut += 1 + (sz[0] + sz[1]) / 3) {
+            tree_type left(a);
+            tree_type right = left.split(cut);
+            std::map<int, int> ml(ma.begin(), ma.lower_bound(cut)), mr(ma.lower_bound(cut), ma.end());
+            ok = ok && matches_model(left, ml) && matches_model(right, mr);
+            if (!mr.empty() && mr.begin()->first == cut)
+                right.remove(cut);
+            tree_type joined = tree_type::join(std::move(left), cut, -7, std::move(right));
+            std::map<int, int> mj = ma;
+            mj[cut] = -7;
+            ok = ok && matches_model(joined, mj) && left.empty() && right.empty();
+        }
+    }
+    assert_true(ok, "set operations match std::map");
+
+    bool thrown = false;
+    tree_type low, high;
+    low.insert(5, 5);
+    high.insert(3, 3);
+    try { tree_type::join(low, 4, 4, high); } catch (const std::invalid_argument&) { thrown = true; }
+    assert_true(thrown, "join checks the key order");
+
+    //large inputs on several threads give the same result
+    tree_type big_a, big_b;
+    std::map<int, int> m;
+    for (int i = 0; i < 200000; ++i) { big_a.insert(i * 2, 1); m[i * 2] = 1; }
+    for (int i = 0; i < 100000; ++i) { big_b.insert(i * 3, 1); m[i * 3] += 1; }
+    tree_type big_i(big_a), big_d(big_a);
+    big_i.intersect(big_b, 4);
+    big_d.difference(big_b, 4);
+    big_a.merge_with(std::move(big_b), [](int x, int y) { return x + y; }, 4);
+    assert_true(big_b.empty() && matches_model(big_a, m), "parallel union");
+    assert_true(big_i.size() == 50000 && big_d.size() == 150000, "parallel intersect and difference");
+
+    //pool trees with separate arenas: other's entries are copied into this tree's pool
+    typedef avl_tree<int, int, pool_allocator<std::pair<const int, int>>> pool_tree;
+    pool_tree pa, pb;
+    for (int i = 0; i < 100; ++i) { pa.insert(i, 1); pb.insert(i + 50, 1); }
+    pa.merge_with(std::move(pb), [](int x, int y) { return x + y; });
+    int info = 0;
+    assert_true(pa.size() == 150 && pa.search(60, info) && info == 2 && pb.empty(), "union across pools");
+
+    //a throwing combiner: the union completes, then the exception comes out
+    tree_type x, y;
+    for (int i = 0; i < 100; ++i) { x.insert(i, 1); y.insert(i + 50, 10); }
+    thrown = false;
+    try {
+        x.merge_with(std::move(y), [](int a, int b) { if (b == 10 && a == 1) throw std::runtime_error("combine"); return a + b; });
+    } catch (const std::runtime_error&) { thrown = true; }
+    assert_true(thrown && x.size() == 150 && x.search(75, info) && info == 1 && x.search(120, info) && info == 10, "throwing combiner");
+}
+
+void test_batch_operations() {
+    avl_tree<int, int> tree;
+    std::map<int, int> model;
+    for (int i = 0; i < 5000; ++i) {
+        tree.insert(i * 3, i);
+        model[i * 3] = i;
+    }
+    //batches of every size around the lane count, with repeats and misses
+    bool ok = true;
+    for (std::size_t n : {0, 1, 15, 16, 17, 64, 255, 256}) {
+        std::vector<int> keys;
+        for (std::size_t i = 0; i < n; ++i)
+            keys.push_back(static_cast<int>((i * 7919) % 16000) - 100);
+        if (n > 2)
+            keys[n - 1] = keys[0];
+        std::vector<const int*> out(3, nullptr);
+        std::size_t found = tree.search_batch(keys, out);
+        std::size_t expected = 0;
+        ok = ok && out.size() == n;
+        for (std::size_t i = 0; i < n; ++i) {
+            auto it = model.find(keys[i]);
+            expected += it != model.end();
+            ok = ok && (it == model.end() ? out[i] == nullptr : out[i] && *out[i] == it->second);
+        }
+        ok = ok && found == expected;
+    }
+    assert_true(ok, "search_batch matches search");
+
+    //statistics see one lookup per key as with search()
+    avl_tree<int, int, std::allocator<std::pair<const int, int>>, atomic_stats> counted;
+    for (int i = 0; i < 100; ++i)
+        counted.insert(i, i);
+    std::vector<int> probe = {5, 50, 500, -1};
+    std::vector<const int*> out;
+    assert_true(counted.search_batch(probe, out) == 2 && counted.stats().searches == 4, "batched lookups counted");
+
+    //insert_batch: new keys, updates and repeats where the last one wins
+    std::vector<std::pair<int, int>> batch = {{1, 10}, {3, 30}, {1, 11}, {-5, 5}, {15000, 1}, {3, 33}};
+    tree.insert_batch(batch.begin(), batch.end());
+    for (const auto& e : batch)
+        model[e.first] = e.second;
+    std::vector<std::pair<int, int>> got;
+    tree.to_vector(got);
+    assert_true(got == std::vector<std::pair<int, int>>(model.begin(), model.end()), "insert_batch contents");
+    int info = 0;
+    assert_true(tree.search(1, info) && info == 11 && tree.search(3, info) && info == 33, "last entry wins");
+    tree.insert_batch(batch.end(), batch.end());
+    assert_true(tree.size() == static_cast<int>(model.size()), "empty batch");
+}
+
+void test_transparent_lookup_and_interning() {
+    //std::string keys looked up through std::string_view and string literals
+    avl_tree<std::string, int> tree;
+    tree.insert("apple", 1);
+    tree.insert("banana", 2);
+    std::string text = "cherry banana apple";
+    std::string_view banana(text.data() + 7, 6);
+    int info = 0;
+    assert_true(tree.search(banana, info) && info == 2, "search by string_view");
+    assert_true(!tree.search(std::string_view(text.data(), 6), info), "missing string_view");
+    const avl_tree<std::string, int>& ctree = tree;
+    assert_true(ctree[banana] == 2 && ctree["apple"] == 1 && ctree["zzz"] == 0 && tree.size() == 2, "const lookups");
+    tree[std::string_view(text.data(), 6)] += 5;
+    tree[banana] += 1;
+    assert_true(tree.size() == 3 && tree["cherry"] == 5 && tree["banana"] == 3, "operator[] inserts on a miss");
+
+    //interned keys: compare with the plain std::string tree
+    std::string words = "the quick brown fox the lazy dog the end fox supercalifragilisticexpialidocious";
+    interned_avl_tree<int> interned(16); //small chunks, so the long word gets its own one
+    std::istringstream in1(words), in2(words);
+    std::string w;
+    while (in1 >> w)
+        interned[w]++;
+    auto plain = count_words(in2);
+    std::vector<std::pair<std::string, int>> a, b;
+    interned.to_vector(a);
+    plain.to_vector(b);
+    assert_true(a == b && interned["the"] == 3 && interned["fox"] == 2, "interned contents");
+    std::size_t distinct_bytes = 0;
+    for (const auto& e : b)
+        distinct_bytes += e.first.size();
+    assert_true(interned.key_bytes() == distinct_bytes, "each key copied once");
+    w = "overwritten";
+    assert_true(interned.search("quick", info) && info == 1, "keys do not refer to the input");
+
+    //copies have their own arena, moves keep the views valid
+    interned_avl_tree<int> copy = interned;
+    interned.clear();
+    interned["new"] = 7;
+    std::vector<std::pair<std::string, int>> c;
+    copy.to_vector(c);
+    assert_true(c == b && interned.size() == 1, "copy independent of the source arena");
+    interned_avl_tree<int> moved = std::move(copy);
+    moved["dog"] += 10;
+    assert_true(moved["dog"] == 11 && moved.size() == static_cast<int>(b.size()), "moved tree");
+    copy = moved;
+    assert_true(copy.size() == moved.size() && copy["dog"] == 11, "copy assignment");
+
+    auto counted = count_words<interned_avl_tree<int>>(words.data(), words.size());
+    std::vector<std::pair<std::string, int>> d;
+    counted.to_vector(d);
+    assert_true(d == b, "count_words into interned_avl_tree");
+    auto top = maxinfo_selector(counted, 2);
+    assert_true(top.size() == 2 && top[0].first == "the" && top[1].first == "fox", "maxinfo_selector on interned keys");
+}
+
+void test_maxinfo_selector_top_k() {
+    avl_tree<int, int> tree;
+    for (int i = 0; i < 1000; ++i) tree.insert(i, (i * 7919) % 1000); // infos are a permutation of 0..999
+    for (int i = 1000; i < 1010; ++i) tree.insert(i, 995); // ties with an existing info
+
+    auto result = maxinfo_selector(tree, 10);
+    assert_equal(result.size(), 10, "Top-k size");
+    assert_equal(result[0].second, 999, "Top-k first info");
+    assert_equal(result[1].second, 998, "Top-k second info");
+    for (size_t i = 1; i < result.size(); ++i)
+        assert_true(result[i - 1].second >= result[i].second, "Top-k descending order");
+    // info 995 appears for key (995 * 7919^-1 mod 1000) and keys 1000..1009; smaller keys win ties
+    assert_equal(result[4].second, 995, "Tie group starts at rank 5");
+    for (size_t i = 5; i < 10; ++i)
+        assert_true(result[i].second == 995 && result[i - 1].first < result[i].first, "Ties ordered by key");
+
+    assert_equal(maxinfo_selector(tree, 0).size(), 0, "Top-0 is empty");
+    assert_equal(maxinfo_selector(tree, 5000).size(), 1010, "Top-k larger than tree");
+    avl_tree<int, int> empty;
+    assert_equal(maxinfo_selector(empty, 3).size(), 0, "Top-k of empty tree");
+}
+
 void test_count_words_empty() {
     std::istringstream iss("");
     avl_tree<std::string, int> result = count_words(iss);
@@ -402,6 +1330,89 @@ void test_count_words_mixed_whitespace() {
     assert_equal(count, 1, "'four' should appear 1 time");
 }
 
+// reference implementation of the original token-by-token count_words
+avl_tree<std::string, int> count_words_reference(std::istream& is) {
+    avl_tree<std::string, int> word_count;
+    std::string word;
+    while (is >> word) {
+        std::string cleaned_word;
+        for (char c : word)
+            if (std::isalnum(static_cast<unsigned char>(c)))
+                cleaned_word += std::tolower(static_cast<unsigned char>(c));
+        if (!cleaned_word.empty())
+            word_count[cleaned_word]++;
+    }
+    return word_count;
+}
+
+void assert_same_counts(const avl_tree<std::string, int>& a, const avl_tree<std::string, int>& b, const std::string& msg) {
+    std::vector<std::pair<std::string, int>> va, vb;
+    a.to_vector(va);
+    b.to_vector(vb);
+    assert_true(va == vb, msg);
+}
+
+void test_count_words_streaming() {
+    const std::string text = "Hello, world!\tWORLD... hello!\n\nit's 42 x-ray X-RAY \x01\xff caf\xc3\xa9 ,,, end";
+    std::istringstream ref_in(text);
+    auto expected = count_words_reference(ref_in);
+
+    assert_same_counts(count_words(text.data(), text.size()), expected, "Buffer overload");
+    for (std::size_t chunk = 1; chunk < 20; ++chunk) {
+        std::istringstream in(text);
+        assert_same_counts(count_words(in, chunk), expected, "Chunked overload, words across chunk borders");
+    }
+
+    // random bytes against the reference tokenizer
+    std::string noise;
+    unsigned seed = 12345;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const char alphabet[] = "aAbB09 \t\n.,!-Zz\x80";
+        noise += alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+    std::istringstream noise_ref(noise), noise_in(noise);
+    assert_same_counts(count_words(noise_in), count_words_reference(noise_ref), "Random input matches reference");
+
+    const char* path = "count_words_test.tmp";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+    assert_same_counts(count_words_file(path), expected, "File overload");
+    std::remove(path);
+}
+
+void test_count_words_parallel() {
+    std::string text;
+    unsigned seed = 777;
+    for (int i = 0; i < 50000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        text += "Word" + std::to_string((seed >> 16) % 3000);
+        text += (seed & 3) == 0 ? ",\n" : " ";
+    }
+    std::istringstream ref_in(text);
+    auto expected = count_words_reference(ref_in);
+
+    for (unsigned threads : {1u, 2u, 3u, 8u, 0u})
+        assert_same_counts(count_words_parallel(text.data(), text.size(), threads), expected, "Parallel count matches serial");
+
+    // more threads than words, and shards made only of separators
+    std::string tiny = "a   b";
+    std::istringstream tiny_ref(tiny);
+    assert_same_counts(count_words_parallel(tiny.data(), tiny.size(), 5), count_words_reference(tiny_ref), "Tiny input");
+    std::istringstream in(text);
+    assert_same_counts(count_words_parallel(in, 4), expected, "Parallel stream overload");
+
+    const char* path = "count_words_parallel_test.tmp";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+    assert_same_counts(count_words_file(path, 4), expected, "Parallel file overload");
+    std::remove(path);
+}
+
 void test_count_words_special_chars_only() {
     std::istringstream iss("!!! ??? ... ,,, ---");
     avl_tree<std::string, int> result = count_words(iss);
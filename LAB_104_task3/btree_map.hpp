@@ -0,0 +1,823 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//ordered map with the interface of avl_tree, stored as a B+-tree: every node holds up to
+//`slots` sorted keys in one array (about four cache lines), so a lookup touches one node
+//per level of a tree that is a few levels deep instead of one node per key. Entries live
+//in the leaves, which are linked in key order for the iterators; inner nodes hold copies
+//of separator keys.
+//
+//Entries are moved when a node is split, merged or shifted, so Key and Info should be
+//nothrow move constructible; with that, a throwing copy or a failed allocation leaves the
+//map as it was. Iterators are forward only and invalidated by insert/remove.
+template <typename Key, typename Info, typename Alloc = std::allocator<std::pair<const Key, Info>>>
+class btree_map {
+public:
+    typedef Key key_type;
+    typedef Info mapped_type;
+    typedef Alloc allocator_type;
+
+    //keys per node, a node is split when it would get more and merged below half
+    static const int slots = 256 / sizeof(Key) < 4 ? 4 : (256 / sizeof(Key) > 64 ? 64 : static_cast<int>(256 / sizeof(Key)));
+
+private:
+    static const int min_slots = slots / 2;
+    //non-root inner nodes have at least 3 children, so 2^31 entries never need more levels
+    static const int max_depth = 32;
+
+    typedef typename std::aligned_storage<sizeof(Key), alignof(Key)>::type key_slot;
+    typedef typename std::aligned_storage<sizeof(Info), alignof(Info)>::type info_slot;
+
+    struct node {
+        int count; //keys in use, the first `count` slots hold live keys
+        bool leaf;
+        key_slot keys[slots];
+        Key* key_data() { return reinterpret_cast<Key*>(keys); }
+        const Key* key_data() const { return reinterpret_cast<const Key*>(keys); }
+        Key& key(int i) { return key_data()[i]; }
+        const Key& key(int i) const { return key_data()[i]; }
+    };
+    struct leaf_node : node {
+        info_slot infos[slots];
+        leaf_node* next; //next leaf in key order
+        Info& info(int i) { return reinterpret_cast<Info*>(infos)[i]; }
+        const Info& info(int i) const { return reinterpret_cast<const Info*>(infos)[i]; }
+    };
+    struct inner_node : node {
+        node* children[slots + 1]; //children[i] holds the keys between key(i - 1) and key(i)
+    };
+
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<leaf_node> leaf_allocator;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<inner_node> inner_allocator;
+    typedef std::allocator_traits<leaf_allocator> leaf_traits;
+    typedef std::allocator_traits<inner_allocator> inner_traits;
+
+    node* root;
+    leaf_node* first_leaf;
+    int entries;
+    leaf_allocator leaf_alloc;
+    inner_allocator inner_alloc;
+
+    leaf_node* new_leaf() {
+    leaf_node* n = leaf_traits::allocate(leaf_alloc, 1);
+    n->count = 0;
+    n->leaf = true;
+    n->next = nullptr;
+    return n;
+    }
+
+    inner_node* new_inner() {
+    inner_node* n = inner_traits::allocate(inner_alloc, 1);
+    n->count = 0;
+    n->leaf = false;
+    return n;
+    }
+
+    //destroy the live keys (and infos) of one node and free it, children are left alone
+    void free_node(node* n) {
+    for (int i = 0; i < n->count; ++i)
+        n->key(i).~Key();
+    if (n->leaf) {
+        leaf_node* l = static_cast<leaf_node*>(n);
+        for (int i = 0; i < l->count; ++i)
+            l->info(i).~Info();
+        leaf_traits::deallocate(leaf_alloc, l, 1);
+    } else {
+        inner_traits::deallocate(inner_alloc, static_cast<inner_node*>(n), 1);
+    }
+    }
+
+    //free a subtree, the recursion is as deep as the tree (a handful of levels)
+    void clear(node* n) {
+    if (n == nullptr)
+        return;
+    if (!n->leaf) {
+        inner_node* in = static_cast<inner_node*>(n);
+        for (int i = 0; i <= in->count; ++i)
+            clear(in->children[i]);
+    }
+    free_node(n);
+    }
+
+    //move-construct `to` from `from` and end the lifetime of `from`
+    template <typename T>
+    static void relocate(T& from, T* to) {
+    ::new (static_cast<void*>(to)) T(std::move(from));
+    from.~T();
+    }
+
+    static void relocate_entry(leaf_node* from, int i, leaf_node* to, int j) {
+    relocate(from->key(i), &to->key(j));
+    relocate(from->info(i), &to->info(j));
+    }
+
+    //first key of the node that is not less than (lower) / greater than (upper) key;
+    //arithmetic keys are counted in a loop the compiler vectorizes, other keys bisected
+    //with conditional moves instead of data dependent branches
+    static int lower(const node* n, const Key& key) {
+    const Key* k = n->key_data();
+    if (std::is_arithmetic<Key>::value) {
+        int c = 0;
+        for (int i = 0; i < n->count; ++i)
+            c += k[i] < key ? 1 : 0;
+        return c;
+    }
+    const Key* base = k;
+    int len = n->count;
+    while (len > 1) {
+        int half = len / 2;
+        base += base[half - 1] < key ? half : 0;
+        len -= half;
+    }
+    return static_cast<int>(base - k) + (len == 1 && *base < key ? 1 : 0);
+    }
+
+    static int upper(const node* n, const Key& key) {
+    const Key* k = n->key_data();
+    if (std::is_arithmetic<Key>::value) {
+        int c = 0;
+        for (int i = 0; i < n->count; ++i)
+            c += key < k[i] ? 0 : 1;
+        return c;
+    }
+    const Key* base = k;
+    int len = n->count;
+    while (len > 1) {
+        int half = len / 2;
+        base += key < base[half - 1] ? 0 : half;
+        len -= half;
+    }
+    return static_cast<int>(base - k) + (len == 1 && !(key < *base) ? 1 : 0);
+    }
+
+    //ask for every cache line of a node's key array at once, so the bisection waits for
+    //one memory round trip instead of one per line it touches
+    static void prefetch_keys(const node* n) {
+#if defined(__GNUC__)
+    const char* p = reinterpret_cast<const char*>(n);
+    for (std::size_t offset = 0; offset < sizeof(node); offset += 64)
+        __builtin_prefetch(p + offset);
+#else
+    (void)n;
+#endif
+    }
+
+    //leaf holding key if it is present
+    const leaf_node* find_leaf(const Key& key) const {
+    const node* n = root;
+    while (n != nullptr && !n->leaf) {
+        const inner_node* in = static_cast<const inner_node*>(n);
+        n = in->children[upper(in, key)];
+        prefetch_keys(n);
+    }
+    return static_cast<const leaf_node*>(n);
+    }
+
+    const Info* find(const Key& key) const {
+    const leaf_node* l = find_leaf(key);
+    if (l == nullptr)
+        return nullptr;
+    int pos = lower(l, key);
+    return pos < l->count && key == l->key(pos) ? &l->info(pos) : nullptr;
+    }
+
+    //split `left`, whose slots are all in use, around the insertion of (k, v) at pos; the
+    //upper half goes to `right`, the separator (first key of `right`) to `sep`, and the
+    //slot of the new entry is returned
+    static std::pair<leaf_node*, int> split_leaf(leaf_node* left, leaf_node* right, int pos, Key& k, Info& v) {
+    const int half = (slots + 1) / 2; //entries kept by left
+    for (int j = slots; j >= half; --j) {
+        if (j > pos)
+            relocate_entry(left, j - 1, right, j - half);
+        else if (j == pos) {
+            ::new (static_cast<void*>(&right->key(j - half))) Key(std::move(k));
+            ::new (static_cast<void*>(&right->info(j - half))) Info(std::move(v));
+        } else
+            relocate_entry(left, j, right, j - half);
+    }
+    if (pos < half) {
+        for (int j = half - 1; j > pos; --j)
+            relocate_entry(left, j - 1, left, j);
+        ::new (static_cast<void*>(&left->key(pos))) Key(std::move(k));
+        ::new (static_cast<void*>(&left->info(pos))) Info(std::move(v));
+    }
+    left->count = half;
+    right->count = slots + 1 - half;
+    right->next = left->next;
+    left->next = right;
+    return pos < half ? std::make_pair(left, pos) : std::make_pair(right, pos - half);
+    }
+
+    //split `left`, whose slots are all in use, around the insertion of separator `sep` at
+    //key index i with `child` to its right; the middle key is left in `sep` for the parent
+    static void split_inner(inner_node* left, inner_node* right, int i, Key& sep, node* child) {
+    const int half = slots / 2; //keys kept by left
+    const int total = slots + 1;
+    for (int j = total - 1; j > half; --j) {
+        Key* to = &right->key(j - half - 1);
+        if (j > i)
+            relocate(left->key(j - 1), to);
+        else if (j == i)
+            ::new (static_cast<void*>(to)) Key(std::move(sep));
+        else
+            relocate(left->key(j), to);
+    }
+    for (int j = total; j > half; --j)
+        right->children[j - half - 1] = j > i + 1 ? left->children[j - 1] : (j == i + 1 ? child : left->children[j]);
+    if (half > i) {
+        Key up(std::move(left->key(half - 1)));
+        left->key(half - 1).~Key();
+        for (int j = half - 1; j > i; --j)
+            relocate(left->key(j - 1), &left->key(j));
+        ::new (static_cast<void*>(&left->key(i))) Key(std::move(sep));
+        for (int j = half; j > i + 1; --j)
+            left->children[j] = left->children[j - 1];
+        left->children[i + 1] = child;
+        sep = std::move(up);
+    } else if (half < i) {
+        Key up(std::move(left->key(half)));
+        left->key(half).~Key();
+        sep = std::move(up);
+    } //half == i: sep itself moves up
+    left->count = half;
+    right->count = total - 1 - half;
+    }
+
+    //insert if absent in a single descent, returns the leaf and slot holding key; `inserted`
+    //tells whether it was created (args are only consumed in that case)
+    template <typename K, typename... Args>
+    std::pair<leaf_node*, int> emplace_at(bool& inserted, K&& key, Args&&... args) {
+    inserted = false;
+    if (root == nullptr) {
+        leaf_node* l = new_leaf();
+        try {
+            ::new (static_cast<void*>(&l->key(0))) Key(std::forward<K>(key));
+        } catch (...) {
+            leaf_traits::deallocate(leaf_alloc, l, 1);
+            throw;
+        }
+        try {
+            ::new (static_cast<void*>(&l->info(0))) Info(std::forward<Args>(args)...);
+        } catch (...) {
+            l->key(0).~Key();
+            leaf_traits::deallocate(leaf_alloc, l, 1);
+            throw;
+        }
+        l->count = 1;
+        root = first_leaf = l;
+        entries = 1;
+        inserted = true;
+        return std::make_pair(l, 0);
+    }
+
+    inner_node* path[max_depth];
+    int at[max_depth];
+    int depth = 0;
+    node* n = root;
+    while (!n->leaf) {
+        inner_node* in = static_cast<inner_node*>(n);
+        path[depth] = in;
+        at[depth] = upper(in, key);
+        n = in->children[at[depth++]];
+    }
+    leaf_node* l = static_cast<leaf_node*>(n);
+    int pos = lower(l, key);
+    if (pos < l->count && key == l->key(pos))
+        return std::make_pair(l, pos);
+
+    if (l->count < slots) {
+        for (int j = l->count; j > pos; --j)
+            relocate_entry(l, j - 1, l, j);
+        try {
+            ::new (static_cast<void*>(&l->key(pos))) Key(std::forward<K>(key));
+            try {
+                ::new (static_cast<void*>(&l->info(pos))) Info(std::forward<Args>(args)...);
+            } catch (...) {
+                l->key(pos).~Key();
+                throw;
+            }
+        } catch (...) {
+            for (int j = pos; j < l->count; ++j)
+                relocate_entry(l, j + 1, l, j);
+            throw;
+        }
+        ++l->count;
+        ++entries;
+        inserted = true;
+        return std::make_pair(l, pos);
+    }
+
+    //the leaf splits: build the entry and the separator, then get every node the splits
+    //up the path need, before anything is changed
+    Key k(std::forward<K>(key));
+    Info v(std::forward<Args>(args)...);
+    const int half = (slots + 1) / 2;
+    Key sep(pos == half ? k : l->key(pos < half ? half - 1 : half));
+    int splits = 0; //inner nodes that split as well
+    while (splits < depth && path[depth - 1 - splits]->count == slots)
+        ++splits;
+    inner_node* spare[max_depth + 1];
+    int spares = 0;
+    leaf_node* right = new_leaf();
+    try {
+        for (; spares < splits + (splits == depth ? 1 : 0); ++spares)
+            spare[spares] = new_inner();
+    } catch (...) {
+        while (spares > 0)
+            inner_traits::deallocate(inner_alloc, spare[--spares], 1);
+        leaf_traits::deallocate(leaf_alloc, right, 1);
+        throw;
+    }
+
+    std::pair<leaf_node*, int> where = split_leaf(l, right, pos, k, v);
+    node* child = right;
+    int d = depth;
+    while (d > 0) {
+        inner_node* in = path[--d];
+        int i = at[d];
+        if (in->count < slots) {
+            for (int j = in->count; j > i; --j) {
+                relocate(in->key(j - 1), &in->key(j));
+                in->children[j + 1] = in->children[j];
+            }
+            ::new (static_cast<void*>(&in->key(i))) Key(std::move(sep));
+            in->children[i + 1] = child;
+            ++in->count;
+            child = nullptr;
+            break;
+        }
+        inner_node* r = spare[--spares];
+        split_inner(in, r, i, sep, child);
+        child = r;
+    }
+    if (child != nullptr) { //the root split
+        inner_node* top = spare[--spares];
+        ::new (static_cast<void*>(&top->key(0))) Key(std::move(sep));
+        top->children[0] = root;
+        top->children[1] = child;
+        top->count = 1;
+        root = top;
+    }
+    ++entries;
+    inserted = true;
+    return where;
+    }
+
+    //remove entry pos of leaf l, shifting the rest down
+    static void erase_entry(leaf_node* l, int pos) {
+    l->key(pos).~Key();
+    l->info(pos).~Info();
+    for (int j = pos + 1; j < l->count; ++j)
+        relocate_entry(l, j, l, j - 1);
+    --l->count;
+    }
+
+    //drop key i, already destroyed or moved out, and the child to its right from an inner node
+    static void close_separator(inner_node* in, int i) {
+    for (int j = i + 1; j < in->count; ++j) {
+        relocate(in->key(j), &in->key(j - 1));
+        in->children[j] = in->children[j + 1];
+    }
+    --in->count;
+    }
+
+    //an inner node one key short of half full borrows from a sibling (rotating a key through
+    //the parent) or merges with one; returns true when the parent may be short now
+    bool fix_inner(inner_node* in, inner_node* parent, int ci) {
+    inner_node* left = ci > 0 ? static_cast<inner_node*>(parent->children[ci - 1]) : nullptr;
+    inner_node* right = ci < parent->count ? static_cast<inner_node*>(parent->children[ci + 1]) : nullptr;
+    if (left && left->count > min_slots) {
+        for (int j = in->count; j > 0; --j)
+            relocate(in->key(j - 1), &in->key(j));
+        for (int j = in->count + 1; j > 0; --j)
+            in->children[j] = in->children[j - 1];
+        relocate(parent->key(ci - 1), &in->key(0));
+        in->children[0] = left->children[left->count];
+        relocate(left->key(left->count - 1), &parent->key(ci - 1));
+        --left->count;
+        ++in->count;
+        return false;
+    }
+    if (right && right->count > min_slots) {
+        relocate(parent->key(ci), &in->key(in->count));
+        in->children[in->count + 1] = right->children[0];
+        ++in->count;
+        relocate(right->key(0), &parent->key(ci));
+        for (int j = 1; j < right->count; ++j)
+            relocate(right->key(j), &right->key(j - 1));
+        for (int j = 1; j <= right->count; ++j)
+            right->children[j - 1] = right->children[j];
+        --right->count;
+        return false;
+    }
+    if (left == nullptr) { //merge the right sibling into this node instead
+        left = in;
+        in = right;
+        ++ci;
+    }
+    relocate(parent->key(ci - 1), &left->key(left->count));
+    for (int j = 0; j < in->count; ++j)
+        relocate(in->key(j), &left->key(left->count + 1 + j));
+    for (int j = 0; j <= in->count; ++j)
+        left->children[left->count + 1 + j] = in->children[j];
+    left->count += 1 + in->count;
+    in->count = 0;
+    free_node(in);
+    close_separator(parent, ci - 1);
+    return parent->count < min_slots;
+    }
+
+    //remove in a single descent, rebalancing up the path only while nodes get short
+    bool unlink(const Key& key) {
+    if (root == nullptr)
+        return false;
+    inner_node* path[max_depth];
+    int at[max_depth];
+    int depth = 0;
+    node* n = root;
+    while (!n->leaf) {
+        inner_node* in = static_cast<inner_node*>(n);
+        path[depth] = in;
+        at[depth] = upper(in, key);
+        n = in->children[at[depth++]];
+    }
+    leaf_node* l = static_cast<leaf_node*>(n);
+    int pos = lower(l, key);
+    if (pos >= l->count || !(key == l->key(pos)))
+        return false;
+
+    if (depth == 0 || l->count > min_slots) {
+        erase_entry(l, pos);
+        --entries;
+        if (l->count == 0) {
+            free_node(l);
+            root = first_leaf = nullptr;
+        }
+        return true;
+    }
+
+    inner_node* parent = path[depth - 1];
+    int ci = at[depth - 1];
+    leaf_node* left = ci > 0 ? static_cast<leaf_node*>(parent->children[ci - 1]) : nullptr;
+    leaf_node* right = ci < parent->count ? static_cast<leaf_node*>(parent->children[ci + 1]) : nullptr;
+    if (left && left->count > min_slots) {
+        Key sep(left->key(left->count - 1)); //the only copy, made before anything changes
+        erase_entry(l, pos);
+        for (int j = l->count; j > 0; --j)
+            relocate_entry(l, j - 1, l, j);
+        relocate_entry(left, left->count - 1, l, 0);
+        --left->count;
+        ++l->count;
+        parent->key(ci - 1) = std::move(sep);
+        --entries;
+        return true;
+    }
+    if (right && right->count > min_slots) {
+        Key sep(right->key(1));
+        erase_entry(l, pos);
+        relocate_entry(right, 0, l, l->count);
+        ++l->count;
+        for (int j = 1; j < right->count; ++j)
+            relocate_entry(right, j, right, j - 1);
+        --right->count;
+        parent->key(ci) = std::move(sep);
+        --entries;
+        return true;
+    }
+
+    erase_entry(l, pos);
+    --entries;
+    if (left == nullptr) { //merge the right sibling into this leaf instead
+        left = l;
+        l = right;
+        ++ci;
+    }
+    for (int j = 0; j < l->count; ++j)
+        relocate_entry(l, j, left, left->count + j);
+    left->count += l->count;
+    l->count = 0;
+    left->next = l->next;
+    free_node(l);
+    parent->key(ci - 1).~Key();
+    close_separator(parent, ci - 1);
+
+    bool short_node = parent->count < min_slots;
+    for (int d = depth - 1; short_node && d > 0; --d)
+        short_node = fix_inner(path[d], path[d - 1], at[d - 1]);
+    if (!root->leaf && root->count == 0) {
+        inner_node* old = static_cast<inner_node*>(root);
+        root = old->children[0];
+        free_node(old);
+    }
+    return true;
+    }
+
+    //bottom-up build from the next n distinct entries of [it, last), the last entry of a run
+    //of equal keys wins; nodes are filled evenly so none is below half full
+    template <typename It>
+    void build_sorted(It it, It last, int n) {
+    std::vector<node*> built; //every node created so far, freed one by one on failure
+    std::vector<node*> level;
+    std::vector<const Key*> low; //smallest key below each node of `level`
+    try {
+        int leaves = (n + slots - 1) / slots;
+        built.reserve(static_cast<std::size_t>(leaves) * 2);
+        leaf_node* prev = nullptr;
+        for (int b = 0; b < leaves; ++b) {
+            leaf_node* l = new_leaf();
+            built.push_back(l);
+            int fill = n / leaves + (b < n % leaves ? 1 : 0);
+            for (int i = 0; i < fill; ++i) {
+                It cur = it;
+                for (++it; it != last && !((*cur).first < (*it).first); ++it)
+                    cur = it;
+                ::new (static_cast<void*>(&l->key(i))) Key((*cur).first);
+                try {
+                    ::new (static_cast<void*>(&l->info(i))) Info((*cur).second);
+                } catch (...) {
+                    l->key(i).~Key();
+                    throw;
+                }
+                ++l->count;
+            }
+            if (prev)
+                prev->next = l;
+            prev = l;
+            level.push_back(l);
+            low.push_back(&l->key(0));
+        }
+        while (level.size() > 1) {
+            std::size_t count = level.size();
+            std::size_t groups = (count + slots) / (slots + 1);
+            std::vector<node*> up;
+            std::vector<const Key*> up_low;
+            std::size_t next = 0;
+            for (std::size_t g = 0; g < groups; ++g) {
+                inner_node* in = new_inner();
+                built.push_back(in);
+                std::size_t fill = count / groups + (g < count % groups ? 1 : 0);
+                in->children[0] = level[next];
+                for (std::size_t c = 1; c < fill; ++c) {
+                    ::new (static_cast<void*>(&in->key(in->count))) Key(*low[next + c]);
+                    in->children[++in->count] = level[next + c];
+                }
+                up.push_back(in);
+                up_low.push_back(low[next]);
+                next += fill;
+            }
+            level.swap(up);
+            low.swap(up_low);
+        }
+    } catch (...) {
+        for (node* b : built)
+            free_node(b);
+        throw;
+    }
+    root = level.empty() ? nullptr : level[0];
+    first_leaf = level.empty() ? nullptr : static_cast<leaf_node*>(built[0]);
+    entries = n;
+    }
+
+    //yields the entries of another map as (first, second) pairs for build_sorted
+    struct entry_source {
+        const leaf_node* l;
+        int i;
+        struct entry {
+            const Key& first;
+            const Info& second;
+        };
+        entry operator*() const { return entry{l->key(i), l->info(i)}; }
+        entry_source& operator++() {
+        if (++i == l->count) {
+            l = l->next;
+            i = 0;
+        }
+        return *this;
+        }
+        bool operator!=(const entry_source& other) const { return l != other.l || i != other.i; }
+    };
+
+    void copy_from(const btree_map& src) {
+    build_sorted(entry_source{src.first_leaf, 0}, entry_source{nullptr, 0}, src.entries);
+    }
+
+public:
+    class const_iterator;
+
+    //forward in-order iterator, invalidated by insert/remove
+    class iterator {
+        friend class btree_map;
+        friend class const_iterator;
+        private:
+            leaf_node* l;
+            int i;
+            iterator(leaf_node* leaf, int index) : l(leaf), i(index) {}
+        public:
+            const Key& key() const { return l->key(i); }
+            Info& info() const { return l->info(i); }
+            iterator& operator++() { if (++i == l->count) { l = l->next; i = 0; } return *this; }
+            iterator operator++(int) { iterator temp = *this; ++*this; return temp; }
+            bool operator==(const iterator& other) const { return l == other.l && i == other.i; }
+            bool operator!=(const iterator& other) const { return !(*this == other); }
+    };
+
+    class const_iterator {
+        friend class btree_map;
+        private:
+            const leaf_node* l;
+            int i;
+            const_iterator(const leaf_node* leaf, int index) : l(leaf), i(index) {}
+        public:
+            const_iterator(const iterator& other) : l(other.l), i(other.i) {}
+            const Key& key() const { return l->key(i); }
+            const Info& info() const { return l->info(i); }
+            const_iterator& operator++() { if (++i == l->count) { l = l->next; i = 0; } return *this; }
+            const_iterator operator++(int) { const_iterator temp = *this; ++*this; return temp; }
+            bool operator==(const const_iterator& other) const { return l == other.l && i == other.i; }
+            bool operator!=(const const_iterator& other) const { return !(*this == other); }
+    };
+
+    btree_map() : root(nullptr), first_leaf(nullptr), entries(0), leaf_alloc(), inner_alloc() {}
+
+    explicit btree_map(const Alloc& a) : root(nullptr), first_leaf(nullptr), entries(0), leaf_alloc(a), inner_alloc(a) {}
+
+    btree_map(const btree_map& src)
+        : root(nullptr), first_leaf(nullptr), entries(0),
+          leaf_alloc(leaf_traits::select_on_container_copy_construction(src.leaf_alloc)), inner_alloc(leaf_alloc) {
+    copy_from(src);
+    }
+
+    btree_map(btree_map&& src) noexcept
+        : root(src.root), first_leaf(src.first_leaf), entries(src.entries), leaf_alloc(src.leaf_alloc), inner_alloc(src.inner_alloc) {
+    src.root = nullptr;
+    src.first_leaf = nullptr;
+    src.entries = 0;
+    }
+
+    ~btree_map() {
+    clear(root);
+    }
+
+    btree_map& operator=(const btree_map& src) {
+    if (this != &src) {
+        clear();
+        copy_from(src);
+    }
+    return *this;
+    }
+
+    //adopts the nodes when the allocator propagates or both are equal, otherwise copies them
+    btree_map& operator=(btree_map&& src) {
+    if (this != &src) {
+        clear();
+        bool propagate = leaf_traits::propagate_on_container_move_assignment::value;
+        if (propagate || leaf_alloc == src.leaf_alloc) {
+            if (propagate) {
+                leaf_alloc = src.leaf_alloc;
+                inner_alloc = src.inner_alloc;
+            }
+            root = src.root;
+            first_leaf = src.first_leaf;
+            entries = src.entries;
+            src.root = nullptr;
+            src.first_leaf = nullptr;
+            src.entries = 0;
+        } else {
+            copy_from(src);
+            src.clear();
+        }
+    }
+    return *this;
+    }
+
+    //O(n) from (key, info) pairs sorted by key, see assign_sorted
+    template <typename It>
+    static btree_map build_from_sorted(It first, It last) {
+    btree_map tree;
+    tree.assign_sorted(first, last);
+    return tree;
+    }
+
+    //replace the contents with a sorted range of pair-like entries; for equal keys the last
+    //one wins, like repeated insert(); pass move iterators to move the entries in
+    template <typename It>
+    btree_map& assign_sorted(It first, It last) {
+    int distinct = 0;
+    if (first != last) {
+        distinct = 1;
+        It prev = first;
+        for (It it = std::next(first); it != last; prev = it, ++it) {
+            if ((*it).first < (*prev).first)
+                throw std::invalid_argument("Input is not sorted by key");
+            if ((*prev).first < (*it).first)
+                ++distinct;
+        }
+    }
+    clear();
+    build_sorted(first, last, distinct);
+    return *this;
+    }
+
+    //permitting updates, Info is value-initialized on a miss
+    Info& operator[](const Key& key) {
+    bool inserted;
+    std::pair<leaf_node*, int> at = emplace_at(inserted, key);
+    return at.first->info(at.second);
+    }
+
+    //indexing without updates
+    const Info& operator[](const Key& key) const {
+    const Info* info = find(key);
+    if (info)
+        return *info;
+    static Info dummy;
+    return dummy;
+    }
+
+    bool search(const Key& key, Info& info) const {
+    const Info* found = find(key);
+    if (found) {
+        info = *found;
+        return true;
+    }
+    return false;
+    }
+
+    bool contains(const Key& key) const {
+    return find(key) != nullptr;
+    }
+
+    btree_map& insert(const Key& key, const Info& info) {
+    bool inserted;
+    std::pair<leaf_node*, int> at = emplace_at(inserted, key, info);
+    if (!inserted)
+        at.first->info(at.second) = info; //update existing key
+    return *this;
+    }
+
+    btree_map& insert(Key&& key, Info&& info) {
+    return emplace(std::move(key), std::move(info));
+    }
+
+    //insert or assign, built in place
+    template <typename K, typename I>
+    btree_map& emplace(K&& key, I&& info) {
+    bool inserted;
+    std::pair<leaf_node*, int> at = emplace_at(inserted, std::forward<K>(key), std::forward<I>(info));
+    if (!inserted)
+        at.first->info(at.second) = std::forward<I>(info);
+    return *this;
+    }
+
+    //insert only if absent
+    template <typename... Args>
+    bool try_emplace(const Key& key, Args&&... args) {
+    bool inserted;
+    emplace_at(inserted, key, std::forward<Args>(args)...);
+    return inserted;
+    }
+
+    btree_map& remove(const Key& key) {
+    unlink(key);
+    return *this;
+    }
+
+    void clear() {
+    clear(root);
+    root = nullptr;
+    first_leaf = nullptr;
+    entries = 0;
+    }
+
+    void to_vector(std::vector<std::pair<Key, Info>>& vec) const {
+    vec.reserve(vec.size() + static_cast<std::size_t>(entries));
+    for (const leaf_node* l = first_leaf; l != nullptr; l = l->next)
+        for (int i = 0; i < l->count; ++i)
+            vec.emplace_back(l->key(i), l->info(i));
+    }
+
+    int size() const {
+    return entries;
+    }
+
+    bool empty() const {
+    return entries == 0;
+    }
+
+    iterator begin() { return iterator(first_leaf, 0); }
+    iterator end() { return iterator(nullptr, 0); }
+    const_iterator begin() const { return const_iterator(first_leaf, 0); }
+    const_iterator end() const { return const_iterator(nullptr, 0); }
+
+    allocator_type get_allocator() const {
+    return allocator_type(leaf_alloc);
+    }
+};
@@ -0,0 +1,515 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//AVL tree shared between threads: any number of readers run lock-free next to writers.
+//
+//Published nodes are never modified. A writer (writers are serialized by a mutex) copies
+//the nodes on its search path and the nodes its rotations touch, links the copies into a
+//new version of the tree and publishes it with one atomic store of the root, so a reader
+//always walks one consistent version. Replaced nodes are retired and freed by epoch-based
+//reclamation once no reader that could still see them is active.
+//
+//Readers announce themselves in one of reader_slots cache-line sized slots; with more
+//simultaneous readers than slots the extra ones wait for a free slot. A write that throws
+//leaves the published version untouched. The destructor and assignment to the tree must
+//not run while other threads use it (the source of a copy may be in use).
+template <typename Key, typename Info, typename Alloc = std::allocator<std::pair<const Key, Info>>>
+class concurrent_avl_tree {
+private:
+    struct node {
+        Key key;
+        Info info;
+        node* left;
+        node* right;
+        int height;
+        int count; //number of nodes in the subtree rooted here
+        std::uint64_t version; //write that created the node; only that write may modify it
+        template <typename K, typename I>
+        node(K&& k, I&& i, std::uint64_t v)
+            : key(std::forward<K>(k)), info(std::forward<I>(i)), left(nullptr), right(nullptr), height(1), count(1), version(v) {}
+    };
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<node> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
+    struct alignas(64) reader_slot {
+        std::atomic<std::uint64_t> epoch; //epoch announced by the reader using the slot, 0 = free
+        reader_slot() : epoch(0) {}
+    };
+    struct retired_node {
+        node* n;
+        std::uint64_t epoch; //epoch of the write that unlinked it
+    };
+
+public:
+    static const int reader_slots = 64;
+
+private:
+    alignas(64) std::atomic<node*> root;
+    alignas(64) std::atomic<std::uint64_t> epoch; //starts at 1, advanced after every write
+    mutable reader_slot slots[reader_slots];
+
+    std::mutex write_mutex;
+    std::uint64_t write_version; //version of the write in progress
+    std::vector<node*> fresh;     //nodes created by the write in progress
+    std::vector<node*> replaced;  //published nodes the write in progress unlinked
+    std::vector<retired_node> retired;
+    node_allocator alloc;
+
+    //reader side
+
+    class read_guard {
+        reader_slot* slot;
+    public:
+        explicit read_guard(const concurrent_avl_tree& t) : slot(t.enter()) {}
+        ~read_guard() { slot->epoch.store(0, std::memory_order_release); }
+        read_guard(const read_guard&) = delete;
+        read_guard& operator=(const read_guard&) = delete;
+    };
+
+    //claim a free slot and announce the current epoch; the search starts at a slot picked
+    //from the thread id so threads rarely meet on one slot
+    reader_slot* enter() const {
+    static thread_local std::size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for (;;) {
+        for (int i = 0; i < reader_slots; ++i) {
+            reader_slot& s = slots[(start + i) % reader_slots];
+            std::uint64_t free_slot = 0;
+            std::uint64_t e = epoch.load(std::memory_order_seq_cst);
+            if (s.epoch.load(std::memory_order_relaxed) == 0 &&
+                s.epoch.compare_exchange_strong(free_slot, e, std::memory_order_seq_cst))
+                return &s;
+        }
+        std::this_thread::yield();
+    }
+    }
+
+    node* snapshot() const {
+    return root.load(std::memory_order_seq_cst);
+    }
+
+    static const node* find(const node* n, const Key& key) {
+    while (n != nullptr) {
+        if (key < n->key)
+            n = n->left;
+        else if (key > n->key)
+            n = n->right;
+        else
+            return n;
+    }
+    return nullptr;
+    }
+
+    template <typename Visitor>
+    static void in_order(const node* n, Visitor& visit) {
+    if (n != nullptr) {
+        in_order(n->left, visit);
+        visit(n->key, n->info);
+        in_order(n->right, visit);
+    }
+    }
+
+    //writer side, all called with write_mutex held
+
+    template <typename K, typename I>
+    node* create_node(K&& k, I&& i) {
+    node* n = node_traits::allocate(alloc, 1);
+    try {
+        node_traits::construct(alloc, n, std::forward<K>(k), std::forward<I>(i), write_version);
+    } catch (...) {
+        node_traits::deallocate(alloc, n, 1);
+        throw;
+    }
+    return n;
+    }
+
+    void destroy_node(node* n) {
+    node_traits::destroy(alloc, n);
+    node_traits::deallocate(alloc, n, 1);
+    }
+
+    void destroy_all(node* n) {
+    if (n != nullptr) {
+        destroy_all(n->left);
+        destroy_all(n->right);
+        destroy_node(n);
+    }
+    }
+
+    //node of the write in progress, destroyed again if the write fails
+    template <typename K, typename I>
+    node* fresh_node(K&& k, I&& i) {
+    node* n = create_node(std::forward<K>(k), std::forward<I>(i));
+    try {
+        fresh.push_back(n);
+    } catch (...) {
+        destroy_node(n);
+        throw;
+    }
+    return n;
+    }
+
+    //unlinked from the version being built; freed by reclaim() once no reader can hold it
+    void retire(node* n) {
+    replaced.push_back(n);
+    }
+
+    //a node this write may modify: n itself if the write created it, otherwise a copy
+    node* own(node* n) {
+    if (n->version == write_version)
+        return n;
+    node* copy = fresh_node(n->key, n->info);
+    copy->left = n->left;
+    copy->right = n->right;
+    copy->height = n->height;
+    copy->count = n->count;
+    retire(n);
+    return copy;
+    }
+
+    static int height(const node* n) {
+    return n ? n->height : 0;
+    }
+
+    static int count(const node* n) {
+    return n ? n->count : 0;
+    }
+
+    static void update_height(node* n) {
+    n->height = 1 + std::max(height(n->left), height(n->right));
+    n->count = 1 + count(n->left) + count(n->right);
+    }
+
+    static int balance_factor(const node* n) {
+    return height(n->left) - height(n->right);
+    }
+
+    //rotations of avl_tree, on owned nodes: y is owned, its child is copied first
+    node* rotate_right(node* y) {
+    node* x = own(y->left);
+    y->left = x->right;
+    x->right = y;
+    update_height(y);
+    update_height(x);
+    return x;
+    }
+
+    node* rotate_left(node* x) {
+    node* y = own(x->right);
+    x->right = y->left;
+    y->left = x;
+    update_height(x);
+    update_height(y);
+    return y;
+    }
+
+    node* rebalance(node* n) {
+    update_height(n);
+    int balance = balance_factor(n);
+
+    if (balance > 1 && balance_factor(n->left) >= 0)
+        return rotate_right(n);
+
+    if (balance < -1 && balance_factor(n->right) <= 0)
+        return rotate_left(n);
+
+    if (balance > 1 && balance_factor(n->left) < 0) {
+        n->left = rotate_left(own(n->left));
+        return rotate_right(n);
+    }
+
+    if (balance < -1 && balance_factor(n->right) > 0) {
+        n->right = rotate_right(own(n->right));
+        return rotate_left(n);
+    }
+
+    return n;
+    }
+
+    template <typename I>
+    node* insert(node* n, const Key& key, I&& info) {
+    if (n == nullptr)
+        return fresh_node(key, std::forward<I>(info));
+    if (key < n->key) {
+        node* left = insert(n->left, key, std::forward<I>(info));
+        n = own(n);
+        n->left = left;
+    } else if (key > n->key) {
+        node* right = insert(n->right, key, std::forward<I>(info));
+        n = own(n);
+        n->right = right;
+    } else {
+        n = own(n);
+        n->info = std::forward<I>(info); //update existing key
+        return n;
+    }
+    return rebalance(n);
+    }
+
+    //detach the minimum of a non-empty subtree; `min` receives it (already retired)
+    node* remove_min(node* n, node*& min) {
+    if (n->left == nullptr) {
+        min = n;
+        node* right = n->right;
+        retire(n);
+        return right;
+    }
+    node* left = remove_min(n->left, min);
+    n = own(n);
+    n->left = left;
+    return rebalance(n);
+    }
+
+    //key must be present
+    node* remove(node* n, const Key& key) {
+    if (key < n->key) {
+        node* left = remove(n->left, key);
+        n = own(n);
+        n->left = left;
+    } else if (key > n->key) {
+        node* right = remove(n->right, key);
+        n = own(n);
+        n->right = right;
+    } else {
+        node* left = n->left;
+        node* right = n->right;
+        if (left == nullptr || right == nullptr) {
+            retire(n);
+            return left ? left : right;
+        }
+        //the successor takes the place of n as a fresh node
+        node* succ = min_node(right);
+        node* replacement = fresh_node(succ->key, succ->info);
+        node* min = nullptr;
+        replacement->right = remove_min(right, min);
+        replacement->left = left;
+        retire(n);
+        n = replacement;
+    }
+    return rebalance(n);
+    }
+
+    static node* min_node(node* n) {
+    while (n->left != nullptr)
+        n = n->left;
+    return n;
+    }
+
+    //run one write: build the new version from the current root, then publish it, retire
+    //the nodes it replaced and free what no reader can see any more
+    template <typename Build>
+    void write(Build build) {
+    ++write_version; //every node created from now on belongs to this write
+    fresh.clear();
+    replaced.clear();
+    node* new_root;
+    try {
+        new_root = build(root.load(std::memory_order_relaxed));
+        retired.reserve(retired.size() + replaced.size()); //publishing below cannot throw
+    } catch (...) {
+        for (std::size_t i = 0; i < fresh.size(); ++i)
+            destroy_node(fresh[i]);
+        fresh.clear();
+        replaced.clear();
+        throw;
+    }
+    root.store(new_root, std::memory_order_seq_cst);
+    std::uint64_t e = epoch.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < replaced.size(); ++i)
+        retired.push_back(retired_node{replaced[i], e});
+    epoch.store(e + 1, std::memory_order_seq_cst);
+    fresh.clear();
+    replaced.clear();
+    if (retired.size() >= reclaim_batch)
+        reclaim();
+    }
+
+    void retire_all(node* n) {
+    if (n != nullptr) {
+        retire_all(n->left);
+        retire_all(n->right);
+        retire(n);
+    }
+    }
+
+    //a node retired at epoch r is unreachable for every reader that announced an epoch
+    //above r; readers that announced r or less may still hold it
+    void reclaim() {
+    std::uint64_t oldest = epoch.load(std::memory_order_seq_cst);
+    for (int i = 0; i < reader_slots; ++i) {
+        std::uint64_t e = slots[i].epoch.load(std::memory_order_seq_cst);
+        if (e != 0 && e < oldest)
+            oldest = e;
+    }
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < retired.size(); ++i) {
+        if (retired[i].epoch < oldest)
+            destroy_node(retired[i].n);
+        else
+            retired[kept++] = retired[i];
+    }
+    retired.resize(kept);
+    }
+
+    static const std::size_t reclaim_batch = 64;
+
+    //single threaded teardown
+    void release_all() {
+    for (std::size_t i = 0; i < retired.size(); ++i)
+        destroy_node(retired[i].n);
+    retired.clear();
+    destroy_all(root.load(std::memory_order_relaxed));
+    root.store(nullptr, std::memory_order_relaxed);
+    }
+
+    node* clone(const node* n) {
+    if (n == nullptr)
+        return nullptr;
+    node* copy = create_node(n->key, n->info);
+    try {
+        copy->left = clone(n->left);
+        copy->right = clone(n->right);
+    } catch (...) {
+        destroy_all(copy);
+        throw;
+    }
+    copy->height = n->height;
+    copy->count = n->count;
+    return copy;
+    }
+
+public:
+    concurrent_avl_tree();
+    explicit concurrent_avl_tree(const Alloc& a);
+    concurrent_avl_tree(const concurrent_avl_tree& src); //src may be in use by readers and writers
+    ~concurrent_avl_tree();
+    concurrent_avl_tree& operator=(const concurrent_avl_tree& src);
+
+    //lock-free readers
+    bool search(const Key& key, Info& info) const;
+    bool contains(const Key& key) const;
+    int size() const;
+    bool empty() const;
+    void to_vector(std::vector<std::pair<Key, Info>>& vec) const;
+    template <typename Visitor>
+    void for_each(Visitor visit) const; //visit(key, info) in key order, on one consistent version
+
+    //writers, serialized
+    concurrent_avl_tree& insert(const Key& key, const Info& info); //insert or assign
+    concurrent_avl_tree& insert(const Key& key, Info&& info);
+    bool remove(const Key& key); //false when key was absent
+    void clear(); //readers still walking the old version finish on it
+};
+
+template <typename Key, typename Info, typename Alloc>
+concurrent_avl_tree<Key, Info, Alloc>::concurrent_avl_tree()
+    : root(nullptr), epoch(1), write_version(0), alloc() {}
+
+template <typename Key, typename Info, typename Alloc>
+concurrent_avl_tree<Key, Info, Alloc>::concurrent_avl_tree(const Alloc& a)
+    : root(nullptr), epoch(1), write_version(0), alloc(a) {}
+
+template <typename Key, typename Info, typename Alloc>
+concurrent_avl_tree<Key, Info, Alloc>::concurrent_avl_tree(const concurrent_avl_tree& src)
+    : root(nullptr), epoch(1), write_version(0), alloc(node_traits::select_on_container_copy_construction(src.alloc)) {
+    read_guard guard(src);
+    root.store(clone(src.snapshot()), std::memory_order_relaxed); //frozen: every write uses a newer version
+}
+
+template <typename Key, typename Info, typename Alloc>
+concurrent_avl_tree<Key, Info, Alloc>::~concurrent_avl_tree() {
+    release_all();
+}
+
+template <typename Key, typename Info, typename Alloc>
+concurrent_avl_tree<Key, Info, Alloc>& concurrent_avl_tree<Key, Info, Alloc>::operator=(const concurrent_avl_tree& src) {
+    if (this != &src) {
+        node* copy;
+        {
+            read_guard guard(src);
+            copy = clone(src.snapshot());
+        }
+        release_all();
+        root.store(copy, std::memory_order_seq_cst);
+    }
+    return *this;
+}
+
+template <typename Key, typename Info, typename Alloc>
+bool concurrent_avl_tree<Key, Info, Alloc>::search(const Key& key, Info& info) const {
+    read_guard guard(*this);
+    const node* n = find(snapshot(), key);
+    if (n) {
+        info = n->info;
+        return true;
+    }
+    return false;
+}
+
+template <typename Key, typename Info, typename Alloc>
+bool concurrent_avl_tree<Key, Info, Alloc>::contains(const Key& key) const {
+    read_guard guard(*this);
+    return find(snapshot(), key) != nullptr;
+}
+
+template <typename Key, typename Info, typename Alloc>
+int concurrent_avl_tree<Key, Info, Alloc>::size() const {
+    read_guard guard(*this);
+    return count(snapshot());
+}
+
+template <typename Key, typename Info, typename Alloc>
+bool concurrent_avl_tree<Key, Info, Alloc>::empty() const {
+    return size() == 0;
+}
+
+template <typename Key, typename Info, typename Alloc>
+void concurrent_avl_tree<Key, Info, Alloc>::to_vector(std::vector<std::pair<Key, Info>>& vec) const {
+    for_each([&vec](const Key& key, const Info& info) { vec.emplace_back(key, info); });
+}
+
+template <typename Key, typename Info, typename Alloc>
+template <typename Visitor>
+void concurrent_avl_tree<Key, Info, Alloc>::for_each(Visitor visit) const {
+    read_guard guard(*this);
+    in_order(snapshot(), visit);
+}
+
+template <typename Key, typename Info, typename Alloc>
+concurrent_avl_tree<Key, Info, Alloc>& concurrent_avl_tree<Key, Info, Alloc>::insert(const Key& key, const Info& info) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    write([&](node* current) { return insert(current, key, info); });
+    return *this;
+}
+
+template <typename Key, typename Info, typename Alloc>
+concurrent_avl_tree<Key, Info, Alloc>& concurrent_avl_tree<Key, Info, Alloc>::insert(const Key& key, Info&& info) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    write([&](node* current) { return insert(current, key, std::move(info)); });
+    return *this;
+}
+
+template <typename Key, typename Info, typename Alloc>
+bool concurrent_avl_tree<Key, Info, Alloc>::remove(const Key& key) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (find(root.load(std::memory_order_relaxed), key) == nullptr)
+        return false;
+    write([&](node* current) { return remove(current, key); });
+    return true;
+}
+
+template <typename Key, typename Info, typename Alloc>
+void concurrent_avl_tree<Key, Info, Alloc>::clear() {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    write([this](node* current) {
+        retire_all(current);
+        return static_cast<node*>(nullptr);
+    });
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//read-only snapshot of an ordered map for lookup-heavy phases, built from avl_tree,
+//btree_map or anything else with in-order key()/info() iterators and size().
+//
+//The keys are stored in one array in Eytzinger (breadth-first) order: the children of
+//position i are 2i and 2i + 1 (1-based), so a lookup walks a complete binary tree without
+//any pointers, the first levels share a few cache lines that stay hot, and the position
+//four levels down can be prefetched while the current one is compared. The infos are kept
+//apart in the same order, so only the key array is touched during the descent.
+template <typename Key, typename Info>
+class frozen_map {
+public:
+    typedef Key key_type;
+    typedef Info mapped_type;
+
+private:
+    std::vector<Key> keys;
+    std::vector<Info> infos;
+
+    //1-based position of the first key not less than key, 0 when there is none
+    std::size_t lower(const Key& key) const {
+    std::size_t n = keys.size();
+    std::size_t j = 1;
+    while (j <= n) {
+#if defined(__GNUC__)
+        if (16 * j <= n)
+            __builtin_prefetch(keys.data() + 16 * j - 1);
+#endif
+        j = 2 * j + (keys[j - 1] < key ? 1 : 0);
+    }
+    //the walk ended below a missing child; strip the right turns taken after the last left one
+#if defined(__GNUC__)
+    j >>= __builtin_ctzll(~static_cast<unsigned long long>(j)) + 1;
+#else
+    while (j & 1)
+        j >>= 1;
+    j >>= 1;
+#endif
+    return j;
+    }
+
+    const Info* find(const Key& key) const {
+    std::size_t j = lower(key);
+    return j != 0 && keys[j - 1] == key ? &infos[j - 1] : nullptr;
+    }
+
+    //in-order neighbours of a 1-based position, 0 past the ends
+    static std::size_t first(std::size_t n) {
+    std::size_t j = n ? 1 : 0;
+    while (j && 2 * j <= n)
+        j *= 2;
+    return j;
+    }
+
+    static std::size_t next(std::size_t j, std::size_t n) {
+    if (2 * j + 1 <= n) {
+        j = 2 * j + 1;
+        while (2 * j <= n)
+            j *= 2;
+        return j;
+    }
+    while (j & 1)
+        j >>= 1;
+    return j >> 1;
+    }
+
+public:
+    //in-order iterator over the snapshot
+    class const_iterator {
+        friend class frozen_map;
+        private:
+            const frozen_map* map;
+            std::size_t j;
+            const_iterator(const frozen_map* m, std::size_t pos) : map(m), j(pos) {}
+        public:
+            const Key& key() const { return map->keys[j - 1]; }
+            const Info& info() const { return map->infos[j - 1]; }
+            const_iterator& operator++() { j = next(j, map->keys.size()); return *this; }
+            const_iterator operator++(int) { const_iterator temp = *this; ++*this; return temp; }
+            bool operator==(const const_iterator& other) const { return j == other.j; }
+            bool operator!=(const const_iterator& other) const { return j != other.j; }
+    };
+    typedef const_iterator iterator;
+
+    frozen_map() {}
+
+    //copies the entries of map; the in-order walk of the Eytzinger positions visits them in
+    //key order, so one pass over map fills both arrays
+    template <typename Map>
+    explicit frozen_map(const Map& map) {
+    std::size_t n = static_cast<std::size_t>(map.size());
+    std::vector<std::size_t> pos(n); //in-order rank -> Eytzinger position
+    for (std::size_t j = first(n), rank = 0; j != 0; j = next(j, n))
+        pos[rank++] = j - 1;
+    std::vector<std::pair<const Key*, const Info*>> order(n); //Eytzinger position -> entry
+    std::size_t rank = 0;
+    for (auto it = map.begin(); it != map.end(); ++it)
+        order[pos[rank++]] = std::make_pair(&it.key(), &it.info());
+    keys.reserve(n);
+    infos.reserve(n);
+    for (const auto& entry : order) {
+        keys.push_back(*entry.first);
+        infos.push_back(*entry.second);
+    }
+    }
+
+    //indexing without updates, a missing key gives a value-initialized Info
+    const Info& operator[](const Key& key) const {
+    const Info* info = find(key);
+    if (info)
+        return *info;
+    static Info dummy;
+    return dummy;
+    }
+
+    bool search(const Key& key, Info& info) const {
+    const Info* found = find(key);
+    if (found) {
+        info = *found;
+        return true;
+    }
+    return false;
+    }
+
+    bool contains(const Key& key) const {
+    return find(key) != nullptr;
+    }
+
+    void to_vector(std::vector<std::pair<Key, Info>>& vec) const {
+    vec.reserve(vec.size() + keys.size());
+    for (const_iterator it = begin(); it != end(); ++it)
+        vec.emplace_back(it.key(), it.info());
+    }
+
+    int size() const {
+    return static_cast<int>(keys.size());
+    }
+
+    bool empty() const {
+    return keys.empty();
+    }
+
+    const_iterator begin() const { return const_iterator(this, first(keys.size())); }
+    const_iterator end() const { return const_iterator(this, 0); }
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "../common/string_arena.hpp"
+#include "avl_tree.hpp"
+
+//lookup key that compares as `word` and, when avl_tree<std::string_view, ...> builds a
+//key from it (only on a miss), copies the word into `arena` first
+struct interned_key {
+    std::string_view word;
+    string_arena* arena;
+    explicit operator std::string_view() const { return arena->intern(word); }
+    friend bool operator==(const interned_key& a, std::string_view b) { return a.word == b; }
+    friend bool operator<(const interned_key& a, std::string_view b) { return a.word < b; }
+    friend bool operator>(const interned_key& a, std::string_view b) { return a.word > b; }
+};
+
+template <>
+struct transparent_key<std::string_view, interned_key> {
+    typedef interned_key type;
+};
+
+//avl_tree keyed by strings whose characters live in one string_arena: each node holds a
+//16-byte std::string_view instead of a std::string, and the keys take one allocation per
+//arena chunk instead of one per long word. Works as the Map of count_words and with
+//maxinfo_selector. Keys are views into the arena, valid while the tree holds them;
+//removing a key does not give its characters back until clear()
+template <typename Info, typename Alloc = std::allocator<std::pair<const std::string_view, Info>>,
+          typename Stats = no_stats>
+class interned_avl_tree {
+public:
+    typedef avl_tree<std::string_view, Info, Alloc, Stats> tree_type;
+    typedef std::string_view key_type;
+    typedef Info mapped_type;
+    typedef typename tree_type::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+private:
+    string_arena arena; //outlives the tree's views, it is destroyed last
+    tree_type map;
+
+public:
+    interned_avl_tree() {}
+
+    explicit interned_avl_tree(std::size_t chunk_size) : arena(chunk_size) {}
+
+    //the keys are copied into an arena of the copy's own, O(n)
+    interned_avl_tree(const interned_avl_tree& src) : map(src.map.get_allocator()) {
+    std::vector<std::pair<std::string_view, Info>> entries;
+    entries.reserve(static_cast<std::size_t>(src.size()));
+    for (const_iterator it = src.begin(), last = src.end(); it != last; ++it)
+        entries.emplace_back(arena.intern(it.key()), it.info());
+    map.assign_sorted(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+    }
+
+    interned_avl_tree(interned_avl_tree&&) = default;
+
+    interned_avl_tree& operator=(const interned_avl_tree& src) {
+    if (this != &src)
+        *this = interned_avl_tree(src);
+    return *this;
+    }
+
+    //the arena and the nodes move together, so the views stay valid
+    interned_avl_tree& operator=(interned_avl_tree&& src) {
+    if (this != &src) {
+        map = std::move(src.map);
+        arena = std::move(src.arena);
+    }
+    return *this;
+    }
+
+    //single descent; the word is copied into the arena only when it is new
+    Info& operator[](std::string_view word) {
+    return map[interned_key{word, &arena}];
+    }
+
+    const Info& operator[](std::string_view word) const {
+    return map[word];
+    }
+
+    bool search(std::string_view word, Info& info) const {
+    return map.search(word, info);
+    }
+
+    interned_avl_tree& remove(std::string_view word) {
+    map.remove(word);
+    return *this;
+    }
+
+    void clear() {
+    map.clear();
+    arena.clear();
+    }
+
+    //copies the keys into std::strings, so the result does not depend on the tree
+    void to_vector(std::vector<std::pair<std::string, Info>>& vec) const {
+    vec.reserve(vec.size() + static_cast<std::size_t>(size()));
+    for (const_iterator it = begin(), last = end(); it != last; ++it)
+        vec.emplace_back(std::string(it.key()), it.info());
+    }
+
+    int size() const { return map.size(); }
+    bool empty() const { return map.empty(); }
+    const_iterator begin() const { return map.begin(); }
+    const_iterator end() const { return map.end(); }
+    const tree_type& tree() const { return map; }
+    std::size_t key_bytes() const { return arena.size(); } //characters held by the arena
+    container_stats stats() const { return map.stats(); }
+    void reset_stats() { map.reset_stats(); }
+};
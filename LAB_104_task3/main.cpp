@@ -11,12 +11,30 @@ int main() {
     run_test("Deep Copy", test_copy_constructor);
     run_test("Helper: Max Info Selector", test_maxinfo_selector);
     run_test("Helper: Max Info Selector Again", test_maxinfo_selector_again);
+    run_test("Helper: Max Info Selector Top-k", test_maxinfo_selector_top_k);
     run_test("Stress Test: Insert and Remove", test_stress_insert_remove);
     run_test("Clear Logic", test_clear_logic);
     run_test("Double Types", test_double_types);
     run_test("Complex Rotations", test_complex_rotations);
     run_test("Empty Edge Cases", test_empty_edge_cases);
     run_test("Other Functions", test_other_functions);
+    run_test("Pool Allocator", test_pool_allocator);
+    run_test("Move and Emplace", test_move_and_emplace);
+    run_test("Order Statistics", test_order_statistics);
+    run_test("Iterators and Ranges", test_iterators_and_ranges);
+    run_test("Build From Sorted", test_build_from_sorted);
+    run_test("Iterative Updates", test_iterative_updates);
+    run_test("Concurrent Tree - Single Thread", test_concurrent_tree_single_thread);
+    run_test("Concurrent Tree - Readers and Writers", test_concurrent_tree_readers);
+    run_test("B+-Tree Map", test_btree_map);
+    run_test("Frozen Map", test_frozen_map);
+    run_test("Helpers on Other Maps", test_helpers_on_other_maps);
+    run_test("Stats Policy", test_stats_policy);
+    run_test("Snapshot Save and Load", test_snapshot_save_load);
+    run_test("Persistent Tree", test_persistent_avl_tree);
+    run_test("Set Operations", test_set_operations);
+    run_test("Batched Search and Insert", test_batch_operations);
+    run_test("Transparent Lookup and Interned Keys", test_transparent_lookup_and_interning);
     run_test("Count Words - Empty Input", test_count_words_empty);
     run_test("Count Words - Single Word", test_count_words_single_word);
     run_test("Count Words - Multiple Words", test_count_words_multiple_same_word);
@@ -24,6 +42,8 @@ int main() {
     run_test("Count Words - Case Insensitive", test_count_words_case_insensitive);
     run_test("Count Words - With Punctuation", test_count_words_with_punctuation);
     run_test("Count Words - Numbers", test_count_words_numbers);
+    run_test("Count Words - Streaming", test_count_words_streaming);
+    run_test("Count Words - Parallel", test_count_words_parallel);
 
 
     std::cout << "--- ALL TESTS FINISHED ---" << std::endl;
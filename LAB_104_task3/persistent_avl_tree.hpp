@@ -0,0 +1,383 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../common/container_stats.hpp"
+
+//AVL tree whose copies share structure: copying is O(1) and an update copies only the
+//nodes it changes (the search path and the nodes its rotations touch), so many versions
+//cost one tree plus their differences.
+//
+//Every node counts the trees and parent nodes that refer to it. An update makes each node
+//it is about to change exclusive first: a node only this tree refers to is changed in
+//place, a shared one is replaced by a copy that shares its children. A tree that was never
+//copied therefore updates like avl_tree, without copying anything.
+//
+//The counts are atomic, so versions sharing nodes may be used and destroyed on different
+//threads (one tree object still needs one thread at a time, and the allocator must be
+//safe for that, which pool_allocator is not). A throwing copy or allocation leaves a valid
+//tree; a remove may then have taken place with a rotation skipped, which later updates on
+//that path make up for. Iterators are forward only and invalidated by updates of the tree.
+template <typename Key, typename Info, typename Alloc = std::allocator<std::pair<const Key, Info>>,
+          typename Stats = no_stats>
+class persistent_avl_tree {
+public:
+    typedef Key key_type;
+    typedef Info mapped_type;
+    typedef Alloc allocator_type;
+
+private:
+    struct node {
+        Key key;
+        Info info;
+        node* left;
+        node* right;
+        int height;
+        int count; //number of nodes in the subtree rooted here
+        std::atomic<int> refs; //trees and nodes referring to this node
+        template <typename K, typename I>
+        node(K&& k, I&& i)
+            : key(std::forward<K>(k)), info(std::forward<I>(i)), left(nullptr), right(nullptr), height(1), count(1), refs(1) {}
+    };
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<node> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
+    static const int max_height = 48; //an AVL tree of 2^31 nodes is at most 45 levels high
+
+    node* root;
+    node_allocator alloc;
+    mutable Stats counters;
+
+    template <typename K, typename I>
+    node* create_node(K&& k, I&& i) {
+    node* n = node_traits::allocate(alloc, 1);
+    try {
+        node_traits::construct(alloc, n, std::forward<K>(k), std::forward<I>(i));
+    } catch (...) {
+        node_traits::deallocate(alloc, n, 1);
+        throw;
+    }
+    counters.allocation();
+    return n;
+    }
+
+    void destroy_node(node* n) {
+    node_traits::destroy(alloc, n);
+    node_traits::deallocate(alloc, n, 1);
+    counters.frees(1);
+    }
+
+    static node* retain(node* n) {
+    if (n)
+        n->refs.fetch_add(1, std::memory_order_relaxed);
+    return n;
+    }
+
+    //drop one reference to n, freeing the nodes nobody refers to any more
+    void release(node* n) {
+    node* pending[max_height];
+    int depth = 0;
+    while (n != nullptr || depth > 0) {
+        if (n == nullptr)
+            n = pending[--depth];
+        if (n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            n = nullptr;
+            continue;
+        }
+        node* left = n->left;
+        node* right = n->right;
+        destroy_node(n);
+        if (right)
+            pending[depth++] = right;
+        n = left;
+    }
+    }
+
+    //exclusive version of n, taking over the caller's reference: n itself when nothing
+    //else refers to it, otherwise a copy sharing n's children
+    node* own(node* n) {
+    if (n->refs.load(std::memory_order_acquire) == 1)
+        return n;
+    node* copy = create_node(n->key, n->info);
+    copy->left = retain(n->left);
+    copy->right = retain(n->right);
+    copy->height = n->height;
+    copy->count = n->count;
+    release(n);
+    return copy;
+    }
+
+    static int height(const node* n) { return n ? n->height : 0; }
+    static int count(const node* n) { return n ? n->count : 0; }
+    static int balance_factor(const node* n) { return height(n->left) - height(n->right); }
+
+    static void update_height(node* n) {
+    n->height = 1 + std::max(height(n->left), height(n->right));
+    n->count = 1 + count(n->left) + count(n->right);
+    }
+
+    //rotations on an exclusive node; the child moving up is made exclusive first
+    node* rotate_right(node* y) {
+    node* x = own(y->left);
+    y->left = x->right;
+    x->right = y;
+    update_height(y);
+    update_height(x);
+    counters.rotation();
+    return x;
+    }
+
+    node* rotate_left(node* x) {
+    node* y = own(x->right);
+    x->right = y->left;
+    y->left = x;
+    update_height(x);
+    update_height(y);
+    counters.rotation();
+    return y;
+    }
+
+    node* rebalance(node* n) {
+    update_height(n);
+    int balance = balance_factor(n);
+    if (balance > 1) {
+        if (balance_factor(n->left) < 0) {
+            n->left = own(n->left);
+            n->left = rotate_left(n->left);
+        }
+        return rotate_right(n);
+    }
+    if (balance < -1) {
+        if (balance_factor(n->right) > 0) {
+            n->right = own(n->right);
+            n->right = rotate_right(n->right);
+        }
+        return rotate_left(n);
+    }
+    return n;
+    }
+
+    const node* find(const Key& key) const {
+    const node* current = root;
+    unsigned int steps = 0;
+    while (current != nullptr) {
+        ++steps;
+        if (key == current->key)
+            break;
+        else if (key < current->key)
+            current = current->left;
+        else
+            current = current->right;
+    }
+    counters.search(steps);
+    return current;
+    }
+
+    //insert or assign below link, copying the shared nodes on the way; returns true when a
+    //node was added. Each level changes its node only after the levels below succeeded
+    template <typename K, typename I>
+    bool insert_at(node*& link, K&& key, I&& info) {
+    if (link == nullptr) {
+        link = create_node(std::forward<K>(key), std::forward<I>(info));
+        return true;
+    }
+    node* n = link = own(link);
+    if (key == n->key) {
+        n->info = std::forward<I>(info);
+        return false;
+    }
+    bool added = key < n->key ? insert_at(n->left, std::forward<K>(key), std::forward<I>(info))
+                              : insert_at(n->right, std::forward<K>(key), std::forward<I>(info));
+    if (added)
+        link = rebalance(n);
+    return added;
+    }
+
+    //remove key, which is known to be below link; a node with two children takes over the
+    //key and info of its in-order successor, which is then removed from the right subtree
+    void remove_at(node*& link, const Key& key) {
+    node* n = link = own(link);
+    if (key < n->key) {
+        remove_at(n->left, key);
+    } else if (key > n->key) {
+        remove_at(n->right, key);
+    } else if (n->left == nullptr || n->right == nullptr) {
+        link = n->left ? n->left : n->right;
+        n->left = n->right = nullptr;
+        release(n);
+        return;
+    } else {
+        const node* succ = n->right;
+        while (succ->left != nullptr)
+            succ = succ->left;
+        n->key = succ->key;
+        n->info = succ->info;
+        remove_at(n->right, n->key);
+    }
+    link = rebalance(n);
+    }
+
+    //balanced subtree from the next n entries of an in-order walk
+    template <typename It>
+    node* build(It& it, int n) {
+    if (n == 0)
+        return nullptr;
+    int left_n = (n - 1) / 2;
+    node* left = build(it, left_n);
+    node* new_node;
+    try {
+        new_node = create_node(it.key(), it.info());
+    } catch (...) {
+        release(left);
+        throw;
+    }
+    ++it;
+    new_node->left = left;
+    try {
+        new_node->right = build(it, n - 1 - left_n);
+    } catch (...) {
+        release(new_node);
+        throw;
+    }
+    update_height(new_node);
+    return new_node;
+    }
+
+public:
+    //in-order iterator over one version of the tree
+    class const_iterator {
+        friend class persistent_avl_tree;
+        private:
+            const node* stack[max_height];
+            int depth;
+            explicit const_iterator(const node* n) : depth(0) { descend(n); }
+            void descend(const node* n) {
+                for (; n != nullptr; n = n->left)
+                    stack[depth++] = n;
+            }
+        public:
+            const Key& key() const { return stack[depth - 1]->key; }
+            const Info& info() const { return stack[depth - 1]->info; }
+            const_iterator& operator++() { const node* n = stack[--depth]; descend(n->right); return *this; }
+            const_iterator operator++(int) { const_iterator temp = *this; ++*this; return temp; }
+            bool operator==(const const_iterator& other) const {
+                return depth == other.depth && (depth == 0 || stack[depth - 1] == other.stack[depth - 1]);
+            }
+            bool operator!=(const const_iterator& other) const { return !(*this == other); }
+    };
+    typedef const_iterator iterator;
+
+    persistent_avl_tree() : root(nullptr), alloc() {}
+
+    explicit persistent_avl_tree(const Alloc& a) : root(nullptr), alloc(a) {}
+
+    //O(1): both trees refer to the same nodes, which is why the allocator is shared too
+    persistent_avl_tree(const persistent_avl_tree& src) : root(retain(src.root)), alloc(src.alloc) {}
+
+    persistent_avl_tree(persistent_avl_tree&& src) noexcept : root(src.root), alloc(src.alloc) {
+    src.root = nullptr;
+    }
+
+    //copies the entries of any map with in-order key()/info() iterators and size(), O(n);
+    //only types naming key_type and mapped_type take part, so an allocator never reaches it
+    template <typename Map, typename = typename std::enable_if<!std::is_convertible<const Map&, Alloc>::value,
+                                                               std::pair<typename Map::key_type, typename Map::mapped_type>>::type>
+    explicit persistent_avl_tree(const Map& map) : root(nullptr), alloc() {
+    auto it = map.begin();
+    root = build(it, static_cast<int>(map.size()));
+    }
+
+    ~persistent_avl_tree() {
+    release(root);
+    }
+
+    //nodes may only be shared between trees using equal allocators, so the allocator
+    //always follows the nodes
+    persistent_avl_tree& operator=(const persistent_avl_tree& src) {
+    node* old = root;
+    root = retain(src.root);
+    release(old);
+    alloc = src.alloc;
+    return *this;
+    }
+
+    persistent_avl_tree& operator=(persistent_avl_tree&& src) {
+    if (this != &src) {
+        release(root);
+        root = src.root;
+        alloc = src.alloc;
+        src.root = nullptr;
+    }
+    return *this;
+    }
+
+    //indexing without updates, a missing key gives a value-initialized Info
+    const Info& operator[](const Key& key) const {
+    const node* n = find(key);
+    if (n)
+        return n->info;
+    static Info dummy;
+    return dummy;
+    }
+
+    bool search(const Key& key, Info& info) const {
+    const node* n = find(key);
+    if (n == nullptr)
+        return false;
+    info = n->info;
+    return true;
+    }
+
+    bool contains(const Key& key) const {
+    return find(key) != nullptr;
+    }
+
+    //insert or assign; copies the shared nodes on the search path
+    template <typename K, typename I>
+    persistent_avl_tree& insert(K&& key, I&& info) {
+    insert_at(root, std::forward<K>(key), std::forward<I>(info));
+    return *this;
+    }
+
+    //nothing is copied when the key is missing
+    persistent_avl_tree& remove(const Key& key) {
+    if (find(key) != nullptr)
+        remove_at(root, key);
+    return *this;
+    }
+
+    void clear() {
+    release(root);
+    root = nullptr;
+    }
+
+    void to_vector(std::vector<std::pair<Key, Info>>& vec) const {
+    vec.reserve(vec.size() + static_cast<std::size_t>(size()));
+    for (const_iterator it = begin(), last = end(); it != last; ++it)
+        vec.emplace_back(it.key(), it.info());
+    }
+
+    int size() const {
+    return count(root);
+    }
+
+    bool empty() const {
+    return root == nullptr;
+    }
+
+    //true when both trees are the same version (no update since one was copied from the other)
+    bool same_version(const persistent_avl_tree& other) const {
+    return root == other.root;
+    }
+
+    const_iterator begin() const { return const_iterator(root); }
+    const_iterator end() const { return const_iterator(nullptr); }
+
+    allocator_type get_allocator() const { return allocator_type(alloc); }
+    container_stats stats() const { return counters.snapshot(); } //all zeros for no_stats
+    void reset_stats() { counters.reset(); }
+};
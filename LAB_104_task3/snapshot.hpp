@@ -0,0 +1,442 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SNAPSHOT_HAVE_MMAP 1
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define SNAPSHOT_HAVE_WIN32 1
+#endif
+
+//binary snapshots of a sorted map, written by avl_tree::save and read back by
+//avl_tree::load (an O(n) bulk build) or answered in place by snapshot_view.
+//
+//Layout (native byte order, checked on load):
+//  snapshot_header  48 bytes: magic, version, byte order mark, key/info type tags,
+//                   entry count, payload size and an FNV-1a checksum of everything after
+//                   the header
+//  offset table     count + 1 uint64 offsets of the entries inside the payload, so a
+//                   lookup can bisect the mapped file without decoding every entry
+//  payload          the entries in increasing key order, key then info; arithmetic types
+//                   as their raw bytes, std::string as a uint32 length and the characters
+//
+//A file is validated completely before it is used: header, checksum, offsets, that every
+//entry decodes within its bounds and that the keys strictly increase.
+
+static const std::uint32_t snapshot_version = 1;
+
+struct snapshot_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t key_tag;
+    std::uint32_t info_tag;
+    std::uint64_t count;
+    std::uint64_t payload_size;
+    std::uint64_t checksum;
+};
+
+//encoding of one value; view_type is what a mapped entry decodes to without allocating
+template <typename T, typename = void>
+struct snapshot_codec; //not defined: the type cannot be stored in a snapshot
+
+template <typename T>
+struct snapshot_codec<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+    typedef T view_type;
+    static const std::uint32_t tag = (std::is_floating_point<T>::value ? 3u : std::is_signed<T>::value ? 1u : 2u) << 8 | sizeof(T);
+
+    static std::size_t size(const T&) { return sizeof(T); }
+    static char* write(char* out, const T& value) {
+    std::memcpy(out, &value, sizeof(T));
+    return out + sizeof(T);
+    }
+    //nullptr when the value does not fit before end
+    static const char* read(const char* p, const char* end, view_type& value) {
+    if (static_cast<std::size_t>(end - p) < sizeof(T))
+        return nullptr;
+    std::memcpy(&value, p, sizeof(T));
+    return p + sizeof(T);
+    }
+    static view_type view(const T& value) { return value; }
+};
+
+template <>
+struct snapshot_codec<std::string> {
+    typedef std::string_view view_type;
+    static const std::uint32_t tag = 4u << 8;
+
+    static std::size_t size(const std::string& value) { return sizeof(std::uint32_t) + value.size(); }
+    static char* write(char* out, const std::string& value) {
+    if (value.size() > UINT32_MAX)
+        throw std::length_error("String too long for a snapshot");
+    std::uint32_t len = static_cast<std::uint32_t>(value.size());
+    std::memcpy(out, &len, sizeof(len));
+    std::memcpy(out + sizeof(len), value.data(), value.size());
+    return out + sizeof(len) + value.size();
+    }
+    static const char* read(const char* p, const char* end, view_type& value) {
+    std::uint32_t len;
+    if (static_cast<std::size_t>(end - p) < sizeof(len))
+        return nullptr;
+    std::memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    if (static_cast<std::size_t>(end - p) < len)
+        return nullptr;
+    value = view_type(p, len);
+    return p + len;
+    }
+    static view_type view(const std::string& value) { return value; }
+};
+
+//FNV-1a, continued from h
+inline std::uint64_t snapshot_checksum(const char* p, std::size_t len, std::uint64_t h = 14695981039346656037ull) {
+    for (std::size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(p[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+//moves the file at from to to, replacing whatever is there; std::rename fails on
+//Windows when to exists
+inline bool snapshot_replace(const std::string& from, const std::string& to) {
+#ifdef SNAPSHOT_HAVE_WIN32
+    return ::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+//writes the (key, info) entries of the in-order range [first, last), count of them, to
+//path; the file is written next to it and renamed over it once complete
+template <typename Key, typename Info, typename It>
+void snapshot_write(const std::string& path, It first, It last, std::size_t count) {
+    typedef snapshot_codec<Key> key_codec;
+    typedef snapshot_codec<Info> info_codec;
+    std::vector<std::uint64_t> offsets;
+    offsets.reserve(count + 1);
+    std::uint64_t pos = 0;
+    for (It it = first; it != last; ++it) {
+        offsets.push_back(pos);
+        pos += key_codec::size(it.key()) + info_codec::size(it.info());
+    }
+    offsets.push_back(pos);
+    if (offsets.size() != count + 1)
+        throw std::logic_error("Snapshot entry count mismatch");
+
+    snapshot_header header;
+    std::memcpy(header.magic, "AVLSNAP", 8);
+    header.version = snapshot_version;
+    header.byte_order = 0x01020304;
+    header.key_tag = key_codec::tag;
+    header.info_tag = info_codec::tag;
+    header.count = count;
+    header.payload_size = pos;
+    const char* table = reinterpret_cast<const char*>(offsets.data());
+    std::size_t table_size = offsets.size() * sizeof(std::uint64_t);
+    header.checksum = snapshot_checksum(table, table_size);
+
+    std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Cannot create " + tmp);
+    try {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header)); //rewritten at the end
+        out.write(table, static_cast<std::streamsize>(table_size));
+        std::vector<char> buffer(1 << 16);
+        std::size_t used = 0;
+        for (It it = first; it != last; ++it) {
+            std::size_t need = key_codec::size(it.key()) + info_codec::size(it.info());
+            if (buffer.size() - used < need) {
+                header.checksum = snapshot_checksum(buffer.data(), used, header.checksum);
+                out.write(buffer.data(), static_cast<std::streamsize>(used));
+                used = 0;
+                if (buffer.size() < need)
+                    buffer.resize(need);
+            }
+            char* p = info_codec::write(key_codec::write(buffer.data() + used, it.key()), it.info());
+            used = static_cast<std::size_t>(p - buffer.data());
+        }
+        header.checksum = snapshot_checksum(buffer.data(), used, header.checksum);
+        out.write(buffer.data(), static_cast<std::streamsize>(used));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out)
+            throw std::runtime_error("Cannot write " + tmp);
+        if (!snapshot_replace(tmp, path))
+            throw std::runtime_error("Cannot replace " + path);
+    } catch (...) {
+        //whatever failed (an encoder, the disk, the rename), no half-written file is left behind
+        out.close();
+        std::remove(tmp.c_str());
+        throw;
+    }
+}
+
+//read-only contents of a file, mapped with mmap or MapViewOfFile and read in where neither
+//exists; holds snapshots for snapshot_view and the text count_words_file counts. Windows
+//does not let a mapped file be replaced or truncated, so save over a snapshot only once
+//the views of it are gone
+class mapped_file {
+public:
+    explicit mapped_file(const std::string& path) : bytes(nullptr), len(0), mapped(false) {
+#ifdef SNAPSHOT_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path);
+    }
+    len = static_cast<std::size_t>(st.st_size);
+    if (len != 0) {
+        void* data = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("Cannot map " + path);
+        bytes = static_cast<const char*>(data);
+        mapped = true;
+    } else {
+        ::close(fd);
+    }
+#elif defined(SNAPSHOT_HAVE_WIN32)
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Cannot open " + path);
+    LARGE_INTEGER file_size;
+    if (!::GetFileSizeEx(file, &file_size)) {
+        ::CloseHandle(file);
+        throw std::runtime_error("Cannot stat " + path);
+    }
+    len = static_cast<std::size_t>(file_size.QuadPart);
+    if (len != 0) { //an empty file cannot be mapped
+        HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        ::CloseHandle(file);
+        void* data = mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (mapping)
+            ::CloseHandle(mapping); //the view keeps the mapping alive
+        if (!data)
+            throw std::runtime_error("Cannot map " + path);
+        bytes = static_cast<const char*>(data);
+        mapped = true;
+    } else {
+        ::CloseHandle(file);
+    }
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Cannot open " + path);
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    bytes = contents.data();
+    len = contents.size();
+#endif
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file() {
+#ifdef SNAPSHOT_HAVE_MMAP
+    if (mapped)
+        ::munmap(const_cast<char*>(bytes), len);
+#elif defined(SNAPSHOT_HAVE_WIN32)
+    if (mapped)
+        ::UnmapViewOfFile(bytes);
+#endif
+    }
+
+    //tells the kernel the contents will be read front to back, a no-op on Windows and when
+    //read in
+    void advise_sequential() const {
+#ifdef SNAPSHOT_HAVE_MMAP
+    if (mapped)
+        ::madvise(const_cast<char*>(bytes), len, MADV_SEQUENTIAL);
+#endif
+    }
+
+    const char* data() const { return bytes; }
+    std::size_t size() const { return len; }
+
+private:
+    const char* bytes;
+    std::size_t len;
+    bool mapped;
+    std::vector<char> contents;
+};
+
+//validated entries of a snapshot held in memory (usually a mapped_file)
+template <typename Key, typename Info>
+class snapshot_reader {
+public:
+    typedef snapshot_codec<Key> key_codec;
+    typedef snapshot_codec<Info> info_codec;
+    typedef typename key_codec::view_type key_view;
+    typedef typename info_codec::view_type info_view;
+
+    //forward iterator over the entries in key order, yields (key view, info view) pairs;
+    //valid while the underlying memory is
+    class const_iterator {
+        friend class snapshot_reader;
+        private:
+            const snapshot_reader* reader;
+            std::size_t i;
+            const_iterator(const snapshot_reader* r, std::size_t pos) : reader(r), i(pos) {}
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef std::pair<key_view, info_view> value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const value_type* pointer;
+            typedef value_type reference;
+
+            const_iterator() : reader(nullptr), i(0) {}
+            value_type operator*() const { return reader->entry(i); }
+            const_iterator& operator++() { ++i; return *this; }
+            const_iterator operator++(int) { const_iterator temp = *this; ++i; return temp; }
+            bool operator==(const const_iterator& other) const { return i == other.i; }
+            bool operator!=(const const_iterator& other) const { return i != other.i; }
+    };
+
+    snapshot_reader(const char* data, std::size_t len) {
+    snapshot_header header;
+    if (len < sizeof(header))
+        throw std::runtime_error("Snapshot too short");
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, "AVLSNAP", 8) != 0)
+        throw std::runtime_error("Not a snapshot");
+    if (header.version != snapshot_version)
+        throw std::runtime_error("Unsupported snapshot version");
+    if (header.byte_order != 0x01020304)
+        throw std::runtime_error("Snapshot written with another byte order");
+    if (header.key_tag != key_codec::tag || header.info_tag != info_codec::tag)
+        throw std::runtime_error("Snapshot holds other key or info types");
+    std::size_t rest = len - sizeof(header);
+    if (header.count >= rest / sizeof(std::uint64_t) ||
+        header.payload_size != rest - (header.count + 1) * sizeof(std::uint64_t))
+        throw std::runtime_error("Snapshot size mismatch");
+    if (snapshot_checksum(data + sizeof(header), rest) != header.checksum)
+        throw std::runtime_error("Snapshot checksum mismatch");
+    n = static_cast<std::size_t>(header.count);
+    table = data + sizeof(header);
+    payload = table + (n + 1) * sizeof(std::uint64_t);
+    payload_end = payload + header.payload_size;
+    if (offset(0) != 0 || offset(n) != header.payload_size)
+        throw std::runtime_error("Snapshot offsets corrupted");
+    key_view prev = key_view();
+    for (std::size_t i = 0; i < n; ++i) {
+        const char* p = payload + offset(i);
+        const char* end = payload + offset(i + 1);
+        key_view key = key_view();
+        info_view info = info_view();
+        if (offset(i + 1) < offset(i) || end > payload_end ||
+            (p = key_codec::read(p, end, key)) == nullptr || (p = info_codec::read(p, end, info)) != end)
+            throw std::runtime_error("Snapshot entry corrupted");
+        if (i > 0 && !(prev < key))
+            throw std::runtime_error("Snapshot keys out of order");
+        prev = key;
+    }
+    }
+
+    std::size_t size() const { return n; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, n); }
+
+    //position of the first key not less than key, size() when there is none
+    std::size_t lower(const key_view& key) const {
+    std::size_t lo = 0, hi = n;
+    while (lo < hi) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (key_at(mid) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+    }
+
+    key_view key_at(std::size_t i) const {
+    key_view key = key_view();
+    key_codec::read(payload + offset(i), payload_end, key);
+    return key;
+    }
+
+    std::pair<key_view, info_view> entry(std::size_t i) const {
+    std::pair<key_view, info_view> e;
+    const char* p = key_codec::read(payload + offset(i), payload_end, e.first);
+    info_codec::read(p, payload_end, e.second);
+    return e;
+    }
+
+private:
+    std::size_t n;
+    const char* table;
+    const char* payload;
+    const char* payload_end;
+
+    std::uint64_t offset(std::size_t i) const {
+    std::uint64_t off;
+    std::memcpy(&off, table + i * sizeof(off), sizeof(off));
+    return off;
+    }
+};
+
+//read-only map answered straight from a snapshot file: opening it maps and validates the
+//file, lookups bisect the offset table and decode only the keys they compare against
+template <typename Key, typename Info>
+class snapshot_view {
+public:
+    typedef Key key_type;
+    typedef Info mapped_type;
+
+    explicit snapshot_view(const std::string& path) : file(path), reader(file.data(), file.size()) {}
+
+    bool search(const Key& key, Info& info) const {
+    typename reader_type::key_view k = snapshot_codec<Key>::view(key);
+    std::size_t i = reader.lower(k);
+    if (i == reader.size() || k < reader.key_at(i))
+        return false;
+    info = Info(reader.entry(i).second);
+    return true;
+    }
+
+    bool contains(const Key& key) const {
+    typename reader_type::key_view k = snapshot_codec<Key>::view(key);
+    std::size_t i = reader.lower(k);
+    return i != reader.size() && !(k < reader.key_at(i));
+    }
+
+    int size() const {
+    return static_cast<int>(reader.size());
+    }
+
+    bool empty() const {
+    return reader.size() == 0;
+    }
+
+private:
+    typedef snapshot_reader<Key, Info> reader_type;
+    mapped_file file;
+    reader_type reader;
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <initializer_list>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @file container_stats.hpp
+ * @brief Optional hot-path counters for Sequence, bi_ring and avl_tree.
+ *
+ * The containers take a stats policy as their last template parameter and report events
+ * to it: node allocations and frees, avl_tree rotations and search path lengths, bi_ring
+ * version bumps and Sequence node hops. stats() returns a container_stats snapshot.
+ *
+ *     avl_tree<int, int, std::allocator<std::pair<const int, int>>, atomic_stats> tree;
+ *     ...
+ *     container_stats s = tree.stats();
+ *
+ * Policies:
+ *   - no_stats (default): empty inline hooks, so the calls compile away and stats() is
+ *     all zeros.
+ *   - atomic_stats: std::atomic counters updated with memory_order_relaxed. stats() may
+ *     be called from another thread (for scraping) while the owner keeps working; the
+ *     fields are read one by one, so the snapshot is not an atomic cut across them.
+ *
+ * Copies and moves of a container start with zeroed counters of their own.
+ */
+
+/**
+ * @struct container_stats
+ * @brief Plain snapshot of the counters. Fields a container does not report stay 0.
+ */
+struct container_stats {
+    std::uint64_t allocations = 0;   // nodes allocated
+    std::uint64_t frees = 0;         // nodes freed (bulk pool releases included)
+    std::uint64_t rotations = 0;     // avl_tree single rotations
+    std::uint64_t searches = 0;      // avl_tree lookups
+    std::uint64_t search_steps = 0;  // nodes visited by those lookups
+    std::uint64_t max_search_steps = 0;
+    std::uint64_t version_bumps = 0; // bi_ring iterator invalidations
+    std::uint64_t node_hops = 0;     // Sequence next-pointer steps during traversals
+};
+
+// counters off: every hook is an empty inline function
+struct no_stats {
+    static const bool enabled = false;
+    void allocation() {}
+    void frees(std::uint64_t) {}
+    void rotation() {}
+    void search(std::uint64_t) {}
+    void version_bump() {}
+    void hops(std::uint64_t) {}
+    container_stats snapshot() const { return container_stats(); }
+    void reset() {}
+};
+
+// counters on: relaxed atomics, cheap enough to leave in a load test
+struct atomic_stats {
+    static const bool enabled = true;
+
+    atomic_stats() {}
+    atomic_stats(const atomic_stats&) {}
+    atomic_stats& operator=(const atomic_stats&) { return *this; }
+
+    void allocation() { add(allocations, 1); }
+    void frees(std::uint64_t n) { add(freed, n); }
+    void rotation() { add(rotations, 1); }
+    void search(std::uint64_t steps) {
+        add(searches, 1);
+        add(search_steps, steps);
+        std::uint64_t longest = max_search_steps.load(std::memory_order_relaxed);
+        while (steps > longest && !max_search_steps.compare_exchange_weak(longest, steps, std::memory_order_relaxed)) {}
+    }
+    void version_bump() { add(version_bumps, 1); }
+    void hops(std::uint64_t n) { add(node_hops, n); }
+
+    container_stats snapshot() const {
+        container_stats s;
+        s.allocations = allocations.load(std::memory_order_relaxed);
+        s.frees = freed.load(std::memory_order_relaxed);
+        s.rotations = rotations.load(std::memory_order_relaxed);
+        s.searches = searches.load(std::memory_order_relaxed);
+        s.search_steps = search_steps.load(std::memory_order_relaxed);
+        s.max_search_steps = max_search_steps.load(std::memory_order_relaxed);
+        s.version_bumps = version_bumps.load(std::memory_order_relaxed);
+        s.node_hops = node_hops.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset() {
+        for (std::atomic<std::uint64_t>* c : {&allocations, &freed, &rotations, &searches, &search_steps,
+                                              &max_search_steps, &version_bumps, &node_hops})
+            c->store(0, std::memory_order_relaxed);
+    }
+
+private:
+    // const lookups may run on several threads at once, so these are real increments
+    static void add(std::atomic<std::uint64_t>& c, std::uint64_t n) {
+        c.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::uint64_t> freed{0};
+    std::atomic<std::uint64_t> rotations{0};
+    std::atomic<std::uint64_t> searches{0};
+    std::atomic<std::uint64_t> search_steps{0};
+    std::atomic<std::uint64_t> max_search_steps{0};
+    std::atomic<std::uint64_t> version_bumps{0};
+    std::atomic<std::uint64_t> node_hops{0};
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/**
+ * @file cow.hpp
+ * @brief Copy-on-write handle for Sequence, bi_ring or any other copyable container.
+ *
+ * Copies of a cow share one container, so handing a read-only copy to another stage is
+ * O(1) instead of a deep copy of every node. The first mutate() on a handle whose
+ * container is shared deep-copies it once; later mutations through that handle work on
+ * its own copy directly.
+ *
+ *     cow<Sequence<int, std::string>> a;
+ *     a.mutate().push_back(1, "one");
+ *     cow<Sequence<int, std::string>> b = a;   // shares the nodes of a
+ *     b.mutate().push_back(2, "two");          // b copies once, a is unchanged
+ *
+ * Notes:
+ *   - References and cursors obtained from mutate() are valid until the handle is copied
+ *     (the container is shared again afterwards and the next mutate() copies it).
+ *   - Handles may be copied and destroyed on different threads. All handles of one
+ *     container read the same object, so giving copies to several threads is only safe
+ *     when the container's const members are; Sequence's positional accessors update
+ *     its position cache and are not (its cursors are).
+ */
+template <typename Container>
+class cow {
+public:
+    typedef Container container_type;
+
+    cow() : data(std::make_shared<Container>()) {}
+
+    explicit cow(Container c) : data(std::make_shared<Container>(std::move(c))) {}
+
+    // copying is O(1); moves copy as well, so no handle is ever left without a container
+    cow(const cow&) = default;
+    cow& operator=(const cow&) = default;
+
+    const Container& get() const { return *data; }
+    const Container& operator*() const { return *data; }
+    const Container* operator->() const { return data.get(); }
+
+    /**
+     * @brief Writable access, copying the container first when other handles share it.
+     *
+     * Complexity: O(1) when not shared, one copy of the container otherwise
+     */
+    Container& mutate() {
+        if (shared()) data = std::make_shared<Container>(*data);
+        return *data;
+    }
+
+    // true while other handles refer to the same container. use_count() is a relaxed load,
+    // so seeing 1 is followed by an acquire fence: the reads other threads made through the
+    // handles they have since dropped happen before whatever the caller writes next
+    bool shared() const {
+        if (data.use_count() != 1) return true;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return false;
+    }
+
+private:
+    std::shared_ptr<Container> data;
+};
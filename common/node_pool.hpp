@@ -0,0 +1,226 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+/**
+ * @file node_pool.hpp
+ * @brief Slab/free-list node pool shared by Sequence, bi_ring and avl_tree.
+ *
+ * The containers allocate exactly one node per element, which makes them spend most of
+ * their time in malloc/free under churn. node_arena hands out fixed-size slots carved
+ * from cache-line-aligned chunks, keeps freed slots on per-size free lists for reuse and
+ * returns all chunks to the system in one go.
+ *
+ * pool_allocator<T> is a standard allocator front-end for node_arena. It is passed as the
+ * optional last template parameter of the containers, e.g.
+ *
+ *     Sequence<int, std::string, pool_allocator<std::pair<const int, std::string>>> seq;
+ *
+ * Copies and rebinds of a pool_allocator share one arena (they compare equal), so nodes
+ * may be relinked between containers built from the same allocator. A container copied
+ * with the copy constructor gets a fresh arena of its own.
+ *
+ * Notes:
+ *   - An arena is not thread safe; use one arena per thread.
+ *   - Requests larger than max_slot bytes, for more than one object or with an alignment
+ *     above slot_align go straight to operator new.
+ */
+
+class node_arena {
+public:
+    static const std::size_t cache_line = 64;
+    static const std::size_t slot_align = 16;
+    static const std::size_t max_slot = 512;
+
+    node_arena() : chunks(nullptr) {
+        for (std::size_t c = 0; c < size_classes; ++c) {
+            free_lists[c] = nullptr;
+            chunk_slots[c] = first_chunk_slots;
+        }
+    }
+
+    node_arena(const node_arena&) = delete;
+    node_arena& operator=(const node_arena&) = delete;
+
+    ~node_arena() {
+        release();
+    }
+
+    /**
+     * @brief Allocate `size` bytes aligned to `align`.
+     *
+     * Pops a slot from the free list of the matching size class, carving a new chunk
+     * when the list is empty.
+     *
+     * Complexity: O(1) amortized
+     */
+    void* allocate(std::size_t size, std::size_t align) {
+        if (size > max_slot || align > slot_align) {
+            return ::operator new(size, std::align_val_t(align < slot_align ? slot_align : align));
+        }
+        std::size_t c = size_class(size);
+        if (!free_lists[c]) refill(c);
+        free_slot* slot = free_lists[c];
+        free_lists[c] = slot->next;
+        return slot;
+    }
+
+    /**
+     * @brief Return a block obtained from allocate() with the same size and alignment.
+     *
+     * Complexity: O(1)
+     */
+    void deallocate(void* p, std::size_t size, std::size_t align) {
+        if (size > max_slot || align > slot_align) {
+            ::operator delete(p, std::align_val_t(align < slot_align ? slot_align : align));
+            return;
+        }
+        std::size_t c = size_class(size);
+        free_slot* slot = static_cast<free_slot*>(p);
+        slot->next = free_lists[c];
+        free_lists[c] = slot;
+    }
+
+    /**
+     * @brief Give every chunk back to the system at once.
+     *
+     * All slots handed out by this arena become invalid; objects living in them must
+     * already be destroyed.
+     *
+     * Complexity: O(number of chunks)
+     */
+    void release() {
+        while (chunks) {
+            chunk* next = chunks->next;
+            ::operator delete(static_cast<void*>(chunks), std::align_val_t(cache_line));
+            chunks = next;
+        }
+        for (std::size_t c = 0; c < size_classes; ++c) {
+            free_lists[c] = nullptr;
+            chunk_slots[c] = first_chunk_slots;
+        }
+    }
+
+private:
+    static const std::size_t size_classes = max_slot / slot_align;
+    static const std::size_t first_chunk_slots = 32;
+    static const std::size_t max_chunk_slots = 4096;
+
+    struct free_slot {
+        free_slot* next;
+    };
+    struct chunk {
+        chunk* next;
+    };
+
+    free_slot* free_lists[size_classes];
+    std::size_t chunk_slots[size_classes]; // slots in the next chunk of each class, doubles up to max_chunk_slots
+    chunk* chunks;
+
+    static std::size_t size_class(std::size_t size) {
+        return size == 0 ? 0 : (size - 1) / slot_align;
+    }
+
+    // carve a new chunk into slots of class c; the chunk header occupies the first cache line
+    void refill(std::size_t c) {
+        std::size_t slot_size = (c + 1) * slot_align;
+        std::size_t slots = chunk_slots[c];
+        char* raw = static_cast<char*>(::operator new(cache_line + slots * slot_size, std::align_val_t(cache_line)));
+        chunk* ch = reinterpret_cast<chunk*>(raw);
+        ch->next = chunks;
+        chunks = ch;
+        char* first = raw + cache_line;
+        for (std::size_t s = slots; s > 0; --s) {
+            free_slot* slot = reinterpret_cast<free_slot*>(first + (s - 1) * slot_size);
+            slot->next = free_lists[c];
+            free_lists[c] = slot;
+        }
+        if (slots < max_chunk_slots) chunk_slots[c] = slots * 2;
+    }
+};
+
+/**
+ * @class pool_allocator
+ * @brief Standard allocator drawing single objects from a shared node_arena.
+ */
+template <typename T>
+class pool_allocator {
+    template <typename U> friend class pool_allocator;
+    std::shared_ptr<node_arena> arena;
+
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::false_type is_always_equal;
+
+    pool_allocator() : arena(std::make_shared<node_arena>()) {}
+
+    template <typename U>
+    pool_allocator(const pool_allocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        arena->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    // a copied container does not share (and later bulk-release) the source's arena
+    pool_allocator select_on_container_copy_construction() const {
+        return pool_allocator();
+    }
+
+    // true when no other allocator (and so no other container) refers to the arena
+    bool owns_arena() const {
+        return arena.use_count() == 1;
+    }
+
+    void release_all() {
+        arena->release();
+    }
+
+    template <typename U>
+    bool operator==(const pool_allocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const pool_allocator<U>& other) const {
+        return arena != other.arena;
+    }
+};
+
+/**
+ * @brief Check whether a container may release all its nodes in bulk.
+ *
+ * Generic allocators never allow it; a pool_allocator allows it when the container is
+ * the only owner of the arena.
+ */
+template <typename A>
+bool pool_can_release(const A&) {
+    return false;
+}
+
+template <typename T>
+bool pool_can_release(const pool_allocator<T>& a) {
+    return a.owns_arena();
+}
+
+/**
+ * @brief Release every node of an exclusively owned pool at once.
+ *
+ * Must only be called after pool_can_release() returned true and all node objects
+ * were destroyed (or are trivially destructible).
+ */
+template <typename A>
+void pool_release(A&) {}
+
+template <typename T>
+void pool_release(pool_allocator<T>& a) {
+    a.release_all();
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @file string_arena.hpp
+ * @brief Append-only character storage handing out std::string_view copies.
+ *
+ * A container of std::string holds one heap block per string that does not fit the small
+ * string buffer, plus 32 bytes of std::string per element. string_arena copies strings
+ * back to back into large chunks instead, so a container can keep 16-byte views into it:
+ * n words cost their characters plus one allocation per chunk.
+ *
+ *     string_arena arena;
+ *     std::string_view kept = arena.intern(word);   // stays valid after word changes
+ *
+ * Notes:
+ *   - Chunks never move or shrink, so a view stays valid until clear() or the arena's
+ *     destruction. Moving an arena moves its chunks along, so the views stay valid then
+ *     too; copying is disabled, since copies of the views would point into the source.
+ *   - Nothing is deduplicated: interning the same text twice stores it twice. Callers
+ *     such as interned_avl_tree only intern keys they do not hold yet.
+ *   - A string longer than the chunk size gets a chunk of its own; the partly used
+ *     current chunk keeps taking the strings that follow.
+ *   - Not thread safe; use one arena per thread.
+ */
+class string_arena {
+public:
+    explicit string_arena(std::size_t chunk = 1 << 16)
+        : chunk_size(chunk ? chunk : 1), cur(nullptr), left(0), used(0), reserved(0) {}
+
+    string_arena(const string_arena&) = delete;
+    string_arena& operator=(const string_arena&) = delete;
+
+    string_arena(string_arena&& other) noexcept
+        : chunks(std::move(other.chunks)), chunk_size(other.chunk_size), cur(other.cur), left(other.left), used(other.used),
+          reserved(other.reserved) {
+        other.chunks.clear();
+        other.cur = nullptr;
+        other.left = other.used = other.reserved = 0;
+    }
+
+    string_arena& operator=(string_arena&& other) noexcept {
+        if (this != &other) {
+            chunks = std::move(other.chunks);
+            chunk_size = other.chunk_size;
+            cur = other.cur;
+            left = other.left;
+            used = other.used;
+            reserved = other.reserved;
+            other.chunks.clear();
+            other.cur = nullptr;
+            other.left = other.used = other.reserved = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Copies s into the arena.
+     * @return A view of the copy, valid until clear()
+     *
+     * Complexity: O(s.size()), plus one allocation when the current chunk is full
+     */
+    std::string_view intern(std::string_view s) {
+        if (s.empty()) return std::string_view();
+        char* dst;
+        if (s.size() > chunk_size) {
+            // the current chunk stays current for the strings that follow
+            dst = add_chunk(s.size());
+        } else {
+            if (s.size() > left) {
+                cur = add_chunk(chunk_size);
+                left = chunk_size;
+            }
+            dst = cur;
+            cur += s.size();
+            left -= s.size();
+        }
+        std::memcpy(dst, s.data(), s.size());
+        used += s.size();
+        return std::string_view(dst, s.size());
+    }
+
+    // frees every chunk; all views handed out are invalid afterwards
+    void clear() {
+        chunks.clear();
+        cur = nullptr;
+        left = used = reserved = 0;
+    }
+
+    // characters stored so far
+    std::size_t size() const { return used; }
+
+    // bytes allocated for chunks
+    std::size_t capacity() const { return reserved; }
+
+private:
+    char* add_chunk(std::size_t bytes) {
+        std::unique_ptr<char[]> chunk(new char[bytes]);
+        chunks.push_back(std::move(chunk));
+        reserved += bytes;
+        return chunks.back().get();
+    }
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::size_t chunk_size;
+    char* cur;       // next free byte of the current chunk
+    std::size_t left; // bytes left in the current chunk
+    std::size_t used;
+    std::size_t reserved;
+};